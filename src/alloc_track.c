@@ -0,0 +1,280 @@
+//
+// Suivi des allocations de main.c (voir alloc_track.h).
+//
+// Les blocs sont dans une table à adressage ouvert indexée par adresse ;
+// un bloc libéré y reste, marqué, tant que malloc ne rend pas de nouveau son
+// adresse, ce qui permet de reconnaître une double libération. Les sites
+// sont dans un tableau à part ; chacun compte ses blocs et octets vivants.
+// Pensé pour TP0, qui n'a qu'un fil d'exécution : rien n'est verrouillé.
+//
+#include <stdint.h>
+#include <string.h>
+#include "alloc_track.h"
+
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+#define MIN_SLOTS 1024
+
+typedef struct {
+    const char *file;
+    int line;
+    size_t allocations;
+    size_t live_blocks;
+    size_t live_bytes;
+    size_t peak_bytes;
+} alloc_site;
+
+/* États d'une case de la table des blocs */
+#define SLOT_EMPTY 0
+#define SLOT_LIVE 1
+#define SLOT_FREED 2
+
+typedef struct {
+    uintptr_t address;
+    size_t size;
+    int state;
+    int site;       /* site d'allocation */
+    int freed_at;   /* site de libération, pour SLOT_FREED */
+} alloc_slot;
+
+static alloc_slot *slots;
+static size_t nslots;
+static size_t used_slots;
+static alloc_site *sites;
+static int nsites;
+static int sites_cap;
+static size_t live_bytes;
+static size_t peak_bytes;
+static size_t errors;
+static int registered;
+
+static void report_at_exit(void) {
+    alloc_track_report(stderr);
+}
+
+/**
+ * @return le nom du fichier sans son dossier (__FILE__ peut être absolu)
+ */
+static const char *base_name(const char *file) {
+    const char *slash = strrchr(file, '/');
+    return slash ? slash + 1 : file;
+}
+
+/**
+ * @return l'indice du site (file, line), créé au besoin, ou -1
+ */
+static int site_of(const char *file, int line) {
+    file = base_name(file);
+    for (int i = 0; i < nsites; i++) {
+        if (sites[i].line == line && (sites[i].file == file || strcmp(sites[i].file, file) == 0)) {
+            return i;
+        }
+    }
+    if (nsites == sites_cap) {
+        int cap = sites_cap ? 2 * sites_cap : 64;
+        alloc_site *grown = realloc(sites, sizeof(alloc_site) * cap);
+        if (!grown) {
+            return -1;
+        }
+        sites = grown;
+        sites_cap = cap;
+    }
+    memset(&sites[nsites], 0, sizeof(alloc_site));
+    sites[nsites].file = file;
+    sites[nsites].line = line;
+    return nsites++;
+}
+
+static size_t slot_hash(uintptr_t address) {
+    uint64_t x = (uint64_t) address;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return (size_t) x;
+}
+
+/**
+ * @return la case de address, ou la case vide où l'insérer
+ */
+static alloc_slot *find_slot(alloc_slot *table, size_t n, uintptr_t address) {
+    size_t i = slot_hash(address) & (n - 1);
+    while (table[i].state != SLOT_EMPTY && table[i].address != address) {
+        i = (i + 1) & (n - 1);
+    }
+    return &table[i];
+}
+
+static int grow_slots(void) {
+    size_t n = nslots ? 2 * nslots : MIN_SLOTS;
+    alloc_slot *table = calloc(n, sizeof(alloc_slot));
+    if (!table) {
+        return -1;
+    }
+    for (size_t i = 0; i < nslots; i++) {
+        if (slots[i].state != SLOT_EMPTY) {
+            *find_slot(table, n, slots[i].address) = slots[i];
+        }
+    }
+    free(slots);
+    slots = table;
+    nslots = n;
+    return 0;
+}
+
+static void note_alloc(void *ptr, size_t size, const char *file, int line) {
+    if (!registered) {
+        atexit(report_at_exit);
+        registered = 1;
+    }
+    if (2 * (used_slots + 1) > nslots && grow_slots() < 0) {
+        return;
+    }
+    int site = site_of(file, line);
+    if (site < 0) {
+        return;
+    }
+    alloc_slot *slot = find_slot(slots, nslots, (uintptr_t) ptr);
+    if (slot->state == SLOT_EMPTY) {
+        used_slots++;
+    } else if (slot->state == SLOT_LIVE) {
+        // Libéré hors du suivi (par un fichier qui n'inclut pas l'en-tête)
+        sites[slot->site].live_blocks--;
+        sites[slot->site].live_bytes -= slot->size;
+        live_bytes -= slot->size;
+    }
+    slot->address = (uintptr_t) ptr;
+    slot->size = size;
+    slot->state = SLOT_LIVE;
+    slot->site = site;
+    alloc_site *s = &sites[site];
+    s->allocations++;
+    s->live_blocks++;
+    s->live_bytes += size;
+    if (s->live_bytes > s->peak_bytes) {
+        s->peak_bytes = s->live_bytes;
+    }
+    live_bytes += size;
+    if (live_bytes > peak_bytes) {
+        peak_bytes = live_bytes;
+    }
+}
+
+/**
+ * Retire un bloc vivant de la table. Un pointeur inconnu ou déjà libéré
+ * est signalé.
+ * @return 0, ou -1 si le bloc ne doit pas être passé à l'allocateur
+ */
+static int note_free(void *ptr, const char *what, const char *file, int line) {
+    alloc_slot *slot = nslots ? find_slot(slots, nslots, (uintptr_t) ptr) : NULL;
+    if (!slot || slot->state == SLOT_EMPTY) {
+        errors++;
+        fprintf(stderr, "alloc_track: invalid %s of %p at %s:%d (not allocated by malloc)\n",
+                what, ptr, base_name(file), line);
+        return -1;
+    }
+    if (slot->state == SLOT_FREED) {
+        errors++;
+        fprintf(stderr, "alloc_track: double %s of %p at %s:%d (allocated at %s:%d, freed at %s:%d)\n",
+                what, ptr, base_name(file), line, sites[slot->site].file, sites[slot->site].line,
+                sites[slot->freed_at].file, sites[slot->freed_at].line);
+        return -1;
+    }
+    int site = site_of(file, line);
+    alloc_site *s = &sites[slot->site];
+    s->live_blocks--;
+    s->live_bytes -= slot->size;
+    live_bytes -= slot->size;
+    slot->state = SLOT_FREED;
+    slot->freed_at = site < 0 ? slot->site : site;
+    return 0;
+}
+
+void *alloc_track_malloc(size_t size, const char *file, int line) {
+    void *ptr = malloc(size);
+    if (ptr) {
+        note_alloc(ptr, size, file, line);
+    }
+    return ptr;
+}
+
+void *alloc_track_calloc(size_t n, size_t size, const char *file, int line) {
+    void *ptr = calloc(n, size);
+    if (ptr) {
+        note_alloc(ptr, n * size, file, line);
+    }
+    return ptr;
+}
+
+/**
+ * Comme realloc ; le nouveau bloc est attribué au site du realloc. Une
+ * taille nulle libère le bloc et rend NULL, comme la glibc.
+ */
+void *alloc_track_realloc(void *ptr, size_t size, const char *file, int line) {
+    if (!ptr) {
+        return alloc_track_malloc(size, file, line);
+    }
+    if (size == 0) {
+        alloc_track_free(ptr, file, line);
+        return NULL;
+    }
+    if (note_free(ptr, "realloc", file, line) < 0) {
+        return NULL;
+    }
+    void *grown = realloc(ptr, size);
+    if (grown) {
+        note_alloc(grown, size, file, line);
+    } else {
+        // L'ancien bloc reste valide
+        alloc_slot *slot = find_slot(slots, nslots, (uintptr_t) ptr);
+        slot->state = SLOT_LIVE;
+        sites[slot->site].live_blocks++;
+        sites[slot->site].live_bytes += slot->size;
+        live_bytes += slot->size;
+    }
+    return grown;
+}
+
+void alloc_track_free(void *ptr, const char *file, int line) {
+    if (ptr && note_free(ptr, "free", file, line) == 0) {
+        free(ptr);
+    }
+}
+
+/**
+ * Écrit le bilan : erreurs, pic de mémoire et blocs encore alloués, par
+ * site, du plus gros au plus petit.
+ * @return le nombre d'octets encore alloués
+ */
+size_t alloc_track_report(FILE *out) {
+    size_t allocations = 0, leaked_blocks = 0;
+    for (int i = 0; i < nsites; i++) {
+        allocations += sites[i].allocations;
+        leaked_blocks += sites[i].live_blocks;
+    }
+    fprintf(out, "alloc_track: %zu allocations, peak %zu bytes, %zu bytes leaked in %zu blocks, %zu errors\n",
+            allocations, peak_bytes, live_bytes, leaked_blocks, errors);
+    int *order = malloc(sizeof(int) * (nsites ? nsites : 1));
+    if (!order) {
+        return live_bytes;
+    }
+    int n = 0;
+    for (int i = 0; i < nsites; i++) {
+        if (sites[i].live_blocks) {
+            int j = n++;
+            for (; j > 0 && sites[order[j - 1]].live_bytes < sites[i].live_bytes; j--) {
+                order[j] = order[j - 1];
+            }
+            order[j] = i;
+        }
+    }
+    for (int i = 0; i < n; i++) {
+        const alloc_site *s = &sites[order[i]];
+        fprintf(out, "alloc_track: %zu bytes in %zu blocks leaked, allocated at %s:%d (%zu allocations)\n",
+                s->live_bytes, s->live_blocks, s->file, s->line, s->allocations);
+    }
+    free(order);
+    return live_bytes;
+}
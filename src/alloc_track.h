@@ -0,0 +1,37 @@
+//
+// Suivi des allocations de main.c, activé à la compilation.
+//
+// Avec TP0_TRACK_ALLOC (option CMake du même nom), malloc, calloc, realloc
+// et free passent, dans les fichiers qui incluent cet en-tête, par des
+// fonctions qui notent chaque bloc et le site (fichier:ligne) qui l'a alloué.
+// Une double libération ou la libération d'un pointeur qui ne vient pas de
+// malloc est signalée sur stderr au moment où elle arrive (et le free n'est
+// pas fait) ; à la fin du programme, les blocs encore alloués sont rapportés
+// par site. Sans TP0_TRACK_ALLOC, cet en-tête ne définit rien : c'est
+// l'allocateur habituel.
+//
+#ifndef TP0_ALLOC_TRACK_H
+#define TP0_ALLOC_TRACK_H
+
+#ifdef TP0_TRACK_ALLOC
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void *alloc_track_malloc(size_t size, const char *file, int line);
+
+void *alloc_track_calloc(size_t n, size_t size, const char *file, int line);
+
+void *alloc_track_realloc(void *ptr, size_t size, const char *file, int line);
+
+void alloc_track_free(void *ptr, const char *file, int line);
+
+size_t alloc_track_report(FILE *out);
+
+#define malloc(size) alloc_track_malloc((size), __FILE__, __LINE__)
+#define calloc(n, size) alloc_track_calloc((n), (size), __FILE__, __LINE__)
+#define realloc(ptr, size) alloc_track_realloc((ptr), (size), __FILE__, __LINE__)
+#define free(ptr) alloc_track_free((ptr), __FILE__, __LINE__)
+#endif // TP0_TRACK_ALLOC
+
+#endif //TP0_ALLOC_TRACK_H
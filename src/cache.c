@@ -0,0 +1,414 @@
+//
+// Cache de résultats indexé par (empreinte de la machine, mot d'entrée).
+//
+// Premier niveau : LRU en mémoire, découpé en SHARDS fragments qui ont
+// chacun leur verrou. Deuxième niveau (optionnel) : un fichier projeté en
+// mémoire qui survit au processus, organisé en paquets de FILE_WAYS cases.
+//
+// La clé est l'empreinte de la machine plus deux empreintes 64 bits
+// indépendantes du mot et sa longueur ; le mot lui-même n'est pas stocké.
+// Seuls les résultats d'arrêt (accepte, rejette, pas de transition) sont
+// gardés : ils restent valides pour toute limite qui les laisse atteindre.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+
+#define SHARDS 64
+#define FILE_WAYS 4
+#define FILE_MAGIC 0x31434d54u /* "TMC1" */
+
+typedef struct {
+    uint64_t machine;
+    uint64_t h1;
+    uint64_t h2;
+    uint64_t len;
+} cache_key;
+
+typedef struct {
+    int32_t verdict;
+    uint32_t used;
+    uint64_t steps;
+    int64_t head;
+    uint64_t tape_hwm;
+    uint64_t tape_low;
+} cache_value;
+
+typedef struct lru_node {
+    cache_key key;
+    cache_value value;
+    struct lru_node *next_in_bucket;
+    struct lru_node *prev;
+    struct lru_node *next;
+} lru_node;
+
+typedef struct {
+    pthread_mutex_t lock;
+    lru_node **buckets;
+    size_t nbuckets;
+    lru_node *newest;
+    lru_node *oldest;
+    size_t count;
+    size_t capacity;
+    tm_cache_stats stats;
+} shard;
+
+typedef struct {
+    cache_key key;
+    cache_value value;
+} file_slot;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t slot_size;
+    uint64_t nbuckets;
+} file_header;
+
+struct tm_cache {
+    shard shards[SHARDS];
+    file_header *file;
+    size_t file_size;
+    file_slot *slots;
+    pthread_mutex_t file_locks[SHARDS];
+};
+
+static uint64_t hash_bytes(const char *s, size_t len, uint64_t seed) {
+    uint64_t h = 1469598103934665603ull ^ seed;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) s[i];
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 32;
+    return h;
+}
+
+static int key_eq(const cache_key *a, const cache_key *b) {
+    return a->machine == b->machine && a->h1 == b->h1 && a->h2 == b->h2 && a->len == b->len;
+}
+
+static uint64_t key_hash(const cache_key *k) {
+    return k->h1 ^ (k->machine * 0x9e3779b97f4a7c15ull);
+}
+
+/**
+ * Ouvre (ou crée) le fichier du deuxième niveau et le projette en mémoire.
+ * Un fichier existant garde sa taille ; file_slots ne sert qu'à la création.
+ */
+static int open_file_tier(tm_cache *c, const char *path, size_t file_slots) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return ERROR;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return ERROR;
+    }
+    size_t nbuckets = (file_slots + FILE_WAYS - 1) / FILE_WAYS;
+    if (nbuckets == 0) {
+        nbuckets = 1;
+    }
+    size_t size = sizeof(file_header) + nbuckets * FILE_WAYS * sizeof(file_slot);
+    int fresh = st.st_size == 0;
+    if (!fresh) {
+        size = (size_t) st.st_size;
+    } else if (ftruncate(fd, (off_t) size) < 0) {
+        close(fd);
+        return ERROR;
+    }
+    void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return ERROR;
+    }
+    file_header *h = map;
+    if (fresh) {
+        h->magic = FILE_MAGIC;
+        h->slot_size = sizeof(file_slot);
+        h->nbuckets = nbuckets;
+    } else if (size < sizeof(file_header) || h->magic != FILE_MAGIC || h->slot_size != sizeof(file_slot)
+               || h->nbuckets == 0
+               || sizeof(file_header) + h->nbuckets * FILE_WAYS * sizeof(file_slot) > size) {
+        munmap(map, size);
+        return ERROR;
+    }
+    c->file = h;
+    c->file_size = size;
+    c->slots = (file_slot *) (h + 1);
+    return 0;
+}
+
+/**
+ * Crée un cache.
+ * @param capacity le nombre de résultats gardés en mémoire
+ * @param file le fichier du deuxième niveau, ou NULL pour s'en passer
+ * @param file_slots le nombre de cases du fichier s'il faut le créer
+ * @return le cache ou NULL en cas d'erreur
+ */
+tm_cache *tm_cache_create(size_t capacity, const char *file, size_t file_slots) {
+    tm_cache *c = calloc(1, sizeof(tm_cache));
+    if (!c) {
+        return NULL;
+    }
+    size_t per_shard = capacity / SHARDS + 1;
+    for (int i = 0; i < SHARDS; i++) {
+        shard *s = &c->shards[i];
+        pthread_mutex_init(&s->lock, NULL);
+        pthread_mutex_init(&c->file_locks[i], NULL);
+        s->capacity = per_shard;
+        s->nbuckets = 16;
+        while (s->nbuckets < per_shard) {
+            s->nbuckets *= 2;
+        }
+        s->buckets = calloc(s->nbuckets, sizeof(lru_node *));
+        if (!s->buckets) {
+            c->shards[i].nbuckets = 0;
+            tm_cache_destroy(c);
+            return NULL;
+        }
+    }
+    if (file && HAS_ERROR(open_file_tier(c, file, file_slots))) {
+        tm_cache_destroy(c);
+        return NULL;
+    }
+    return c;
+}
+
+void tm_cache_destroy(tm_cache *c) {
+    if (!c) {
+        return;
+    }
+    for (int i = 0; i < SHARDS; i++) {
+        shard *s = &c->shards[i];
+        lru_node *n = s->newest;
+        while (n) {
+            lru_node *next = n->next;
+            free(n);
+            n = next;
+        }
+        free(s->buckets);
+        pthread_mutex_destroy(&s->lock);
+        pthread_mutex_destroy(&c->file_locks[i]);
+    }
+    if (c->file) {
+        msync(c->file, c->file_size, MS_ASYNC);
+        munmap(c->file, c->file_size);
+    }
+    free(c);
+}
+
+static void lru_unlink(shard *s, lru_node *n) {
+    if (n->prev) {
+        n->prev->next = n->next;
+    } else {
+        s->newest = n->next;
+    }
+    if (n->next) {
+        n->next->prev = n->prev;
+    } else {
+        s->oldest = n->prev;
+    }
+}
+
+static void lru_push_front(shard *s, lru_node *n) {
+    n->prev = NULL;
+    n->next = s->newest;
+    if (s->newest) {
+        s->newest->prev = n;
+    }
+    s->newest = n;
+    if (!s->oldest) {
+        s->oldest = n;
+    }
+}
+
+static lru_node **bucket_of(shard *s, const cache_key *k) {
+    return &s->buckets[(key_hash(k) >> 6) & (s->nbuckets - 1)];
+}
+
+static int shard_get(shard *s, const cache_key *k, cache_value *out) {
+    for (lru_node *n = *bucket_of(s, k); n; n = n->next_in_bucket) {
+        if (key_eq(&n->key, k)) {
+            lru_unlink(s, n);
+            lru_push_front(s, n);
+            *out = n->value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void shard_put(shard *s, const cache_key *k, const cache_value *v) {
+    lru_node **b = bucket_of(s, k);
+    for (lru_node *n = *b; n; n = n->next_in_bucket) {
+        if (key_eq(&n->key, k)) {
+            n->value = *v;
+            return;
+        }
+    }
+    lru_node *n;
+    if (s->count >= s->capacity) {
+        // On recycle le nœud le plus ancien
+        n = s->oldest;
+        lru_unlink(s, n);
+        lru_node **p = bucket_of(s, &n->key);
+        while (*p != n) {
+            p = &(*p)->next_in_bucket;
+        }
+        *p = n->next_in_bucket;
+        s->stats.evictions++;
+    } else if ((n = malloc(sizeof(lru_node)))) {
+        s->count++;
+    } else {
+        return;
+    }
+    n->key = *k;
+    n->value = *v;
+    n->next_in_bucket = *b;
+    *b = n;
+    lru_push_front(s, n);
+}
+
+static int file_get(tm_cache *c, const cache_key *k, cache_value *out) {
+    uint64_t bucket = key_hash(k) % c->file->nbuckets;
+    file_slot *slots = &c->slots[bucket * FILE_WAYS];
+    int found = 0;
+    pthread_mutex_lock(&c->file_locks[bucket % SHARDS]);
+    for (int i = 0; i < FILE_WAYS; i++) {
+        if (slots[i].value.used && key_eq(&slots[i].key, k)) {
+            *out = slots[i].value;
+            found = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&c->file_locks[bucket % SHARDS]);
+    return found;
+}
+
+static void file_put(tm_cache *c, const cache_key *k, const cache_value *v) {
+    uint64_t bucket = key_hash(k) % c->file->nbuckets;
+    file_slot *slots = &c->slots[bucket * FILE_WAYS];
+    pthread_mutex_lock(&c->file_locks[bucket % SHARDS]);
+    // Case libre, sinon on décale le paquet et on écrase la plus ancienne
+    int i = 0;
+    while (i < FILE_WAYS - 1 && slots[i].value.used && !key_eq(&slots[i].key, k)) {
+        i++;
+    }
+    if (slots[i].value.used && !key_eq(&slots[i].key, k)) {
+        memmove(&slots[0], &slots[1], sizeof(file_slot) * (FILE_WAYS - 1));
+    }
+    slots[i].key = *k;
+    slots[i].value = *v;
+    pthread_mutex_unlock(&c->file_locks[bucket % SHARDS]);
+}
+
+/**
+ * Un résultat en cache vaut pour ces limites s'il a pu être atteint sans
+ * les dépasser. L'état d'acceptation ou de rejet est reconnu avant la
+ * limite de pas, une transition manquante après : un arrêt sans transition
+ * au pas max_steps est un TM_STEP_LIMIT sous ces limites.
+ */
+static int fits_limits(const cache_value *v, const tm_limits *limits) {
+    if (!limits) {
+        return 1;
+    }
+    int halted = v->verdict == TM_ACCEPT || v->verdict == TM_REJECT;
+    return (!limits->max_steps || v->steps < limits->max_steps || (halted && v->steps == limits->max_steps))
+           && (!limits->max_tape || v->tape_hwm + v->tape_low < limits->max_tape);
+}
+
+/**
+ * Comme tm_run(), mais consulte le cache avant d'exécuter la machine et y
+ * range le résultat ensuite.
+ * @param cache le cache, ou NULL pour toujours exécuter
+ * @param flags TM_CACHE_BYPASS pour ignorer le cache pour cet appel
+ */
+int tm_cache_run(tm_cache *cache, const tm_machine *m, const char *input, size_t len,
+                 const tm_limits *limits, tm_result *result, int flags) {
+    if (!cache || (flags & TM_CACHE_BYPASS)) {
+        if (cache) {
+            shard *s = &cache->shards[0];
+            pthread_mutex_lock(&s->lock);
+            s->stats.bypassed++;
+            pthread_mutex_unlock(&s->lock);
+        }
+        return tm_run(m, input, len, limits, result);
+    }
+
+    // Le mode de ruban change le résultat sans changer la description
+    cache_key k = {m->hash ^ ((uint64_t) m->tape_mode * 0x9e3779b97f4a7c15ull), hash_bytes(input, len, 0), hash_bytes(input, len, 0x5bd1e995u), len};
+    shard *s = &cache->shards[key_hash(&k) % SHARDS];
+    cache_value v;
+
+    pthread_mutex_lock(&s->lock);
+    int hit = shard_get(s, &k, &v) && fits_limits(&v, limits);
+    if (hit) {
+        s->stats.memory_hits++;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    if (!hit && cache->file && file_get(cache, &k, &v) && fits_limits(&v, limits)) {
+        hit = 1;
+        pthread_mutex_lock(&s->lock);
+        s->stats.file_hits++;
+        shard_put(s, &k, &v);
+        pthread_mutex_unlock(&s->lock);
+    }
+
+    if (hit) {
+        if (result) {
+            result->verdict = v.verdict;
+            result->steps = v.steps;
+            result->head = v.head;
+            result->tape_hwm = (size_t) v.tape_hwm;
+            result->tape_low = (size_t) v.tape_low;
+        }
+        return v.verdict;
+    }
+
+    tm_result r;
+    int verdict = tm_run(m, input, len, limits, &r);
+    if (result) {
+        *result = r;
+    }
+    int cacheable = verdict == TM_ACCEPT || verdict == TM_REJECT || verdict == TM_NO_TRANSITION;
+    v.verdict = verdict;
+    v.used = 1;
+    v.steps = r.steps;
+    v.head = r.head;
+    v.tape_hwm = r.tape_hwm;
+    v.tape_low = r.tape_low;
+
+    pthread_mutex_lock(&s->lock);
+    s->stats.misses++;
+    if (cacheable) {
+        shard_put(s, &k, &v);
+    }
+    pthread_mutex_unlock(&s->lock);
+    if (cacheable && cache->file) {
+        file_put(cache, &k, &v);
+    }
+    return verdict;
+}
+
+void tm_cache_get_stats(tm_cache *cache, tm_cache_stats *stats) {
+    memset(stats, 0, sizeof(tm_cache_stats));
+    for (int i = 0; i < SHARDS; i++) {
+        shard *s = &cache->shards[i];
+        pthread_mutex_lock(&s->lock);
+        stats->memory_hits += s->stats.memory_hits;
+        stats->file_hits += s->stats.file_hits;
+        stats->misses += s->stats.misses;
+        stats->bypassed += s->stats.bypassed;
+        stats->evictions += s->stats.evictions;
+        pthread_mutex_unlock(&s->lock);
+    }
+}
@@ -0,0 +1,34 @@
+//
+// Cache de résultats indexé par (empreinte de la machine, mot d'entrée).
+//
+#ifndef TP0_CACHE_H
+#define TP0_CACHE_H
+
+#include "machine.h"
+
+/* Drapeaux de tm_cache_run() */
+#define TM_CACHE_BYPASS 1
+
+typedef struct tm_cache tm_cache;
+
+/**
+ * Compteurs cumulés du cache.
+ */
+typedef struct {
+    uint64_t memory_hits;
+    uint64_t file_hits;
+    uint64_t misses;
+    uint64_t bypassed;
+    uint64_t evictions;
+} tm_cache_stats;
+
+tm_cache *tm_cache_create(size_t capacity, const char *file, size_t file_slots);
+
+void tm_cache_destroy(tm_cache *cache);
+
+int tm_cache_run(tm_cache *cache, const tm_machine *m, const char *input, size_t len,
+                 const tm_limits *limits, tm_result *result, int flags);
+
+void tm_cache_get_stats(tm_cache *cache, tm_cache_stats *stats);
+
+#endif //TP0_CACHE_H
@@ -0,0 +1,241 @@
+//
+// Automate fini pour les machines qui ne reviennent jamais en arrière.
+//
+// Une machine dont aucune transition ne va à gauche ne relit jamais une
+// case après l'avoir quittée : sur le mot, elle ne lit que ses symboles,
+// éventuellement réécrits sur place par des transitions qui restent (R).
+// Ces chaînes sur place sont repliées à la compilation, si bien qu'une
+// transition de l'automate consomme exactement un octet du mot : l'état
+// suivant et le nombre de pas, ou un arrêt sur la case. L'exécution est
+// alors un parcours du mot, sans ruban.
+//
+// Au-delà du mot, toutes les cases sont blanches : la fin de l'exécution
+// suit la table de la machine avec une seule case courante.
+//
+#include <stdlib.h>
+#include "dfa.h"
+
+/* Arrêts sur la case (dfa_entry.next < 0) */
+#define STOP_ACCEPT (-1)
+#define STOP_REJECT (-2)
+#define STOP_NO_TRANSITION (-3)
+#define STOP_LOOP (-4)
+
+/**
+ * Transition de l'automate : next est la ligne (état * nsyms) de l'état
+ * atteint en passant à la case suivante, ou un arrêt STOP_* ; steps est
+ * le nombre de pas de la machine, arrêt compris.
+ */
+typedef struct {
+    int32_t next;
+    uint32_t steps;
+} dfa_entry;
+
+/* Au-delà, pas de table par paires d'octets */
+#define PAIR_MAX_ENTRIES (1 << 16)
+
+/**
+ * table : une transition par (état, symbole). pairs, quand la machine est
+ * assez petite : une transition par (état, symbole, symbole suivant), avec
+ * next = état * nsyms * nsyms, ou -1 si la machine s'arrête sur l'une des
+ * deux cases ; le parcours y avance de deux octets par accès.
+ */
+struct tm_dfa {
+    dfa_entry *table;
+    dfa_entry *pairs;
+};
+
+/**
+ * Replie les transitions sur place à partir de (state, col).
+ */
+static dfa_entry fold(const tm_machine *m, int state, int col) {
+    const uint64_t bound = (uint64_t) m->nstates * m->nsyms;
+    dfa_entry out = {STOP_LOOP, 0};
+    for (uint64_t k = 0; k <= bound; k++) {
+        out.steps = (uint32_t) k;
+        if (state == m->accept) {
+            out.next = STOP_ACCEPT;
+            return out;
+        }
+        if (state == m->reject) {
+            out.next = STOP_REJECT;
+            return out;
+        }
+        const tm_entry *e = &m->table[(size_t) state * m->nsyms + col];
+        if (e->next == TM_NO_STATE) {
+            out.next = STOP_NO_TRANSITION;
+            return out;
+        }
+        state = e->next;
+        if (e->movement > 0) {
+            out.next = state * m->nsyms;
+            out.steps = (uint32_t) k + 1;
+            return out;
+        }
+        col = m->sym[(unsigned char) e->write];
+    }
+    // Plus de pas que de couples (état, symbole) : la machine boucle sur place
+    out.next = STOP_LOOP;
+    return out;
+}
+
+/**
+ * Compile la machine en automate si aucune de ses transitions ne va à
+ * gauche.
+ * @return l'automate, ou NULL si la machine n'est pas de cette classe ou
+ * si la mémoire manque
+ */
+tm_dfa *tm_dfa_compile(const tm_machine *m) {
+    size_t n = (size_t) m->nstates * m->nsyms;
+    if ((uint64_t) n > INT32_MAX) {
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (m->table[i].next != TM_NO_STATE && m->table[i].movement < 0) {
+            return NULL;
+        }
+    }
+    tm_dfa *dfa = calloc(1, sizeof(tm_dfa));
+    if (!dfa || !(dfa->table = malloc(sizeof(dfa_entry) * n))) {
+        free(dfa);
+        return NULL;
+    }
+    for (int s = 0; s < m->nstates; s++) {
+        for (int col = 0; col < m->nsyms; col++) {
+            dfa->table[(size_t) s * m->nsyms + col] = fold(m, s, col);
+        }
+    }
+    size_t nsq = (size_t) m->nsyms * m->nsyms;
+    if (n * m->nsyms <= PAIR_MAX_ENTRIES && (dfa->pairs = malloc(sizeof(dfa_entry) * n * m->nsyms))) {
+        for (size_t i = 0; i < n * m->nsyms; i++) {
+            const dfa_entry *first = &dfa->table[i / m->nsyms];
+            dfa_entry *pair = &dfa->pairs[i];
+            pair->next = -1;
+            pair->steps = 0;
+            if (first->next >= 0) {
+                const dfa_entry *second = &dfa->table[first->next + (int32_t) (i % m->nsyms)];
+                if (second->next >= 0) {
+                    pair->next = (int32_t) ((size_t) (second->next / m->nsyms) * nsq);
+                    pair->steps = first->steps + second->steps;
+                }
+            }
+        }
+    }
+    return dfa;
+}
+
+void tm_dfa_free(tm_dfa *dfa) {
+    if (!dfa) {
+        return;
+    }
+    free(dfa->table);
+    free(dfa->pairs);
+    free(dfa);
+}
+
+/**
+ * Exécute une machine compilée en automate (m->dfa), avec les mêmes
+ * résultats que tm_run() sur un ruban infini à droite.
+ * @return le verdict, un code d'erreur TM_*, ou TM_RUNNING si la machine
+ * boucle sur place sans limite de pas (l'appelant la confie alors au
+ * moteur, qui ne s'arrêtera pas non plus)
+ */
+int tm_dfa_run(const tm_machine *m, const char *input, size_t len,
+               const tm_limits *limits, tm_result *result) {
+    uint64_t max_steps = limits ? limits->max_steps : 0;
+    uint64_t limit = max_steps ? max_steps : UINT64_MAX;
+    size_t limit_cell = SIZE_MAX;
+    if (limits && limits->max_tape) {
+        limit_cell = limits->max_tape > len ? limits->max_tape : len + 1;
+    }
+    const dfa_entry *table = m->dfa->table;
+    const unsigned char *sym = m->sym;
+    const unsigned char *in = (const unsigned char *) input;
+    int32_t row = m->start * m->nsyms;
+    uint64_t steps = 0;
+    size_t head = 0;
+    int verdict = TM_RUNNING;
+
+    // Parcours du mot : seule la dépendance row -> table[row + ...] est
+    // sur le chemin critique, d'où les paires qui la raccourcissent de moitié.
+    // Une paire où la machine s'arrête est reprise octet par octet.
+    if (m->dfa->pairs) {
+        const dfa_entry *pairs = m->dfa->pairs;
+        const int nsyms = m->nsyms;
+        int32_t pair_row = m->start * nsyms * nsyms;
+        for (; head + 1 < len; head += 2) {
+            const dfa_entry *e = &pairs[pair_row + sym[in[head]] * nsyms + sym[in[head + 1]]];
+            if (e->next < 0 || e->steps > limit - steps) {
+                break;
+            }
+            pair_row = e->next;
+            steps += e->steps;
+        }
+        row = pair_row / nsyms;
+    }
+    for (; head < len; head++) {
+        const dfa_entry *e = &table[row + sym[in[head]]];
+        if (e->next < 0 || e->steps > limit - steps) {
+            if (e->steps > limit - steps || (e->next == STOP_NO_TRANSITION && steps + e->steps == limit)) {
+                verdict = TM_STEP_LIMIT;
+                steps = limit;
+            } else if (e->next == STOP_LOOP) {
+                if (!max_steps) {
+                    return TM_RUNNING;
+                }
+                verdict = TM_STEP_LIMIT;
+                steps = limit;
+            } else {
+                verdict = e->next == STOP_ACCEPT ? TM_ACCEPT
+                        : e->next == STOP_REJECT ? TM_REJECT : TM_NO_TRANSITION;
+                steps += e->steps;
+            }
+            break;
+        }
+        row = e->next;
+        steps += e->steps;
+    }
+
+    // Au-delà du mot, comme run_loop() dans machine.c avec une seule case
+    size_t reach = head;
+    int state = row / m->nsyms;
+    char cell = TM_BLANK;
+    while (verdict == TM_RUNNING) {
+        if (state == m->accept) {
+            verdict = TM_ACCEPT;
+            break;
+        }
+        if (state == m->reject) {
+            verdict = TM_REJECT;
+            break;
+        }
+        if (max_steps && steps == max_steps) {
+            verdict = TM_STEP_LIMIT;
+            break;
+        }
+        const tm_entry *e = &m->table[(size_t) state * m->nsyms + sym[(unsigned char) cell]];
+        if (e->next == TM_NO_STATE) {
+            verdict = TM_NO_TRANSITION;
+            break;
+        }
+        cell = e->write;
+        state = e->next;
+        steps++;
+        if (e->movement > 0 && ++head > reach) {
+            cell = TM_BLANK;
+            reach = head;
+            if (reach == limit_cell) {
+                verdict = TM_TAPE_LIMIT;
+            }
+        }
+    }
+
+    if (result) {
+        result->verdict = verdict;
+        result->steps = steps;
+        result->head = (int64_t) head;
+        result->tape_hwm = len > reach + 1 ? len - 1 : reach;
+        result->tape_low = 0;
+    }
+    return verdict;
+}
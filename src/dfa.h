@@ -0,0 +1,16 @@
+//
+// Automate fini pour les machines qui ne reviennent jamais en arrière.
+//
+#ifndef TP0_DFA_H
+#define TP0_DFA_H
+
+#include "machine.h"
+
+tm_dfa *tm_dfa_compile(const tm_machine *m);
+
+void tm_dfa_free(tm_dfa *dfa);
+
+int tm_dfa_run(const tm_machine *m, const char *input, size_t len,
+               const tm_limits *limits, tm_result *result);
+
+#endif //TP0_DFA_H
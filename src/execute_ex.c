@@ -0,0 +1,98 @@
+//
+// Variante de execute() qui décrit l'exécution (voir execute_ex.h).
+//
+// La machine est chargée et exécutée par la bibliothèque tm, sur un
+// tm_config que l'on garde jusqu'au bout : verdict, pas, tête et hwm en
+// viennent, et avec EXECUTE_KEEP_TAPE son ruban est rendu tel quel à
+// l'appelant.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "execute_ex.h"
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Octets occupés par une machine compilée : noms d'états et table.
+ */
+static size_t machine_bytes(const tm_machine *m) {
+    size_t bytes = sizeof(tm_machine) + sizeof(char *) * (size_t) m->nstates;
+    for (int i = 0; i < m->nstates; i++) {
+        bytes += strlen(m->names[i]) + 1;
+    }
+    return bytes + sizeof(tm_entry) * (size_t) m->nstates * (size_t) m->nsyms;
+}
+
+/**
+ * Exécute la machine de Turing dont la description est fournie, comme
+ * execute(), et décrit l'exécution dans result. Avec EXECUTE_KEEP_TAPE, le
+ * ruban final n'est pas libéré : result->tape pointe sur la case 0,
+ * result->tape_len cases sont significatives et sont suivies d'un '\0'.
+ * Le ruban ne fait que grandir, d'où peak_memory = machine + capacité
+ * finale du ruban.
+ * @param machine_file le fichier de la description
+ * @param input la chaîne d'entrée de la machine de turing
+ * @param flags 0 ou EXECUTE_KEEP_TAPE
+ * @param result reçoit la description, peut être NULL
+ * @return 1 si la machine accepte, 0 si elle rejette, ERROR sinon
+ */
+error_code execute_ex(char *machine_file, char *input, int flags, execute_result *result) {
+    uint64_t start = now_ns();
+    execute_result r;
+    memset(&r, 0, sizeof(r));
+    r.verdict = TM_LOAD_ERROR;
+
+    tm_machine *m = tm_machine_load(machine_file);
+    if (m) {
+        tm_config c;
+        r.verdict = tm_config_init(&c, m, input, strlen(input));
+        if (HAS_NO_ERROR(r.verdict)) {
+            tm_result run;
+            r.verdict = tm_config_run(m, &c, NULL, SIZE_MAX);
+            tm_config_result(&c, r.verdict, &run);
+            r.steps = run.steps;
+            r.head = run.head;
+            r.tape_hwm = run.tape_hwm;
+            if (flags & EXECUTE_KEEP_TAPE) {
+                // hwm peut être la dernière case du ruban : place pour le '\0'
+                size_t tape_len = run.tape_hwm + 1;
+                if (tape_len >= c.cap) {
+                    char *grown = realloc(c.tape, tape_len + 1);
+                    if (grown) {
+                        c.tape = grown;
+                        c.cap = tape_len + 1;
+                    } else {
+                        tm_config_release(&c);
+                        r.verdict = TM_NO_MEMORY;
+                    }
+                }
+                if (c.tape) {
+                    r.tape = c.tape;
+                    r.tape_len = tape_len;
+                    r.tape[r.tape_len] = '\0';
+                }
+            }
+            r.peak_memory = machine_bytes(m) + c.cap;
+            if (!(flags & EXECUTE_KEEP_TAPE)) {
+                tm_config_release(&c);
+            }
+        }
+        tm_machine_free(m);
+    }
+    r.elapsed_ns = now_ns() - start;
+    if (result) {
+        *result = r;
+    } else {
+        free(r.tape);
+    }
+    if (r.verdict == TM_ACCEPT) {
+        return 1;
+    }
+    return r.verdict == TM_REJECT ? 0 : ERROR;
+}
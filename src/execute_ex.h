@@ -0,0 +1,29 @@
+//
+// Variante de execute() qui décrit l'exécution.
+//
+#ifndef TP0_EXECUTE_EX_H
+#define TP0_EXECUTE_EX_H
+
+#include "machine.h"
+#include "main.h"
+
+/* Bits de execute_ex(flags) */
+#define EXECUTE_KEEP_TAPE 1
+
+/**
+ * Description d'une exécution par execute_ex().
+ */
+typedef struct {
+    int verdict;            /* TM_ACCEPT, TM_REJECT ou un code TM_* */
+    uint64_t steps;
+    int64_t head;           /* position finale de la tête */
+    size_t tape_hwm;        /* case la plus à droite atteinte ou occupée */
+    size_t peak_memory;     /* octets : machine compilée et ruban */
+    uint64_t elapsed_ns;    /* chargement compris */
+    char *tape;             /* avec EXECUTE_KEEP_TAPE, à libérer par free() */
+    size_t tape_len;
+} execute_result;
+
+error_code execute_ex(char *machine_file, char *input, int flags, execute_result *result);
+
+#endif //TP0_EXECUTE_EX_H
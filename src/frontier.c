@@ -0,0 +1,279 @@
+//
+// Mémo des excursions sur la frontière blanche (voir frontier.h).
+//
+// Le mémo se remplit pendant les exécutions : à la première arrivée d'un
+// état sur la frontière, une excursion est ouverte (case, pas) ; elle se
+// ferme quand la tête repasse à gauche de sa case ou quand la machine
+// s'arrête, et l'issue est alors recopiée depuis le ruban. Les excursions
+// ouvertes sont imbriquées : chaque nouvelle frontière est à droite des
+// précédentes, la plus récente est au sommet de la pile. Une exécution qui
+// s'interrompt pour une autre raison (limite, stop_at) les abandonne.
+//
+// Un tm_frontier est gardé dans un tm_context, donc propre à un fil
+// d'exécution. Il tient les mémos des FRONTIER_MEMOS dernières machines
+// servies, pour qu'un contexte qui alterne entre quelques machines ne
+// reparte pas de zéro à chaque changement ; au-delà, le mémo le moins
+// récemment lié est repris. Lier un mémo ne coûte rien : ses entrées ne
+// sont dimensionnées et remises à zéro qu'à la première arrivée sur la
+// frontière, que beaucoup d'exécutions n'atteignent jamais.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "frontier.h"
+
+/* États d'une entrée du mémo */
+#define ENTRY_UNKNOWN 0
+#define ENTRY_PENDING 1     /* excursion ouverte */
+#define ENTRY_KNOWN 2
+#define ENTRY_NONE 3        /* excursion trop courte ou trop longue */
+
+/* Au-delà, les issues suivantes ne sont plus retenues */
+#define MAX_POOL (1u << 22)
+
+/* Machines dont un même contexte garde les mémos */
+#define FRONTIER_MEMOS 4
+
+typedef struct {
+    int kind;
+    tm_frontier_outcome outcome;
+    size_t pattern_at;
+} frontier_entry;
+
+typedef struct {
+    int state;
+    size_t cell;
+    uint64_t steps;
+} frontier_record;
+
+/**
+ * Mémo d'une machine, reconnue par son adresse, son empreinte et la
+ * numérotation de ses états. ready est faux tant que entries n'a pas été
+ * dimensionné et remis à zéro pour elle.
+ */
+typedef struct {
+    const tm_machine *m;
+    uint64_t hash;
+    uint64_t layout;
+    int nstates;
+    int ready;
+    frontier_entry *entries;
+    frontier_record *records;
+    int rows_cap;
+    int nrecords;
+    char *pool;
+    size_t pool_len;
+    size_t pool_cap;
+    tm_frontier_stats stats;
+    uint64_t used;
+} frontier_memo;
+
+struct tm_frontier {
+    frontier_memo memos[FRONTIER_MEMOS];
+    frontier_memo *cur;
+    uint64_t clock;
+};
+
+tm_frontier *tm_frontier_create(void) {
+    tm_frontier *f = calloc(1, sizeof(tm_frontier));
+    if (f) {
+        f->cur = &f->memos[0];
+    }
+    return f;
+}
+
+void tm_frontier_free(tm_frontier *f) {
+    if (!f) {
+        return;
+    }
+    for (int i = 0; i < FRONTIER_MEMOS; i++) {
+        free(f->memos[i].entries);
+        free(f->memos[i].records);
+        free(f->memos[i].pool);
+    }
+    free(f);
+}
+
+/**
+ * @return vrai si les issues du mémo valent pour m, telle que ses états
+ * sont numérotés maintenant
+ */
+static int same_machine(const frontier_memo *memo, const tm_machine *m) {
+    return memo->m == m && memo->hash == m->hash && memo->layout == m->layout && memo->nstates == m->nstates;
+}
+
+/**
+ * Prépare le mémo de la machine m : le sien s'il est encore là, avec ses
+ * issues, sinon le moins récemment lié, vidé.
+ * @return 0
+ */
+int tm_frontier_bind(tm_frontier *f, const tm_machine *m) {
+    frontier_memo *memo = f->cur;
+    if (!same_machine(memo, m)) {
+        memo = &f->memos[0];
+        for (int i = 0; i < FRONTIER_MEMOS && !same_machine(memo, m); i++) {
+            if (same_machine(&f->memos[i], m) || f->memos[i].used < memo->used) {
+                memo = &f->memos[i];
+            }
+        }
+        if (!same_machine(memo, m)) {
+            memo->m = m;
+            memo->hash = m->hash;
+            memo->layout = m->layout;
+            memo->nstates = m->nstates;
+            memo->ready = 0;
+            memo->nrecords = 0;
+            memo->pool_len = 0;
+            memset(&memo->stats, 0, sizeof(memo->stats));
+        }
+        f->cur = memo;
+    }
+    memo->used = ++f->clock;
+    return 0;
+}
+
+/**
+ * @return vrai si le mémo courant est celui de la machine m
+ */
+int tm_frontier_is_bound(const tm_frontier *f, const tm_machine *m) {
+    return same_machine(f->cur, m);
+}
+
+/**
+ * Dimensionne et vide les entrées du mémo à la première arrivée sur la
+ * frontière depuis qu'il a été lié.
+ * @return 0 ou TM_NO_MEMORY (le mémo reste alors inutilisé)
+ */
+static int prepare(frontier_memo *memo) {
+    if (memo->rows_cap < memo->nstates) {
+        frontier_entry *entries = realloc(memo->entries, sizeof(frontier_entry) * memo->nstates);
+        if (entries) {
+            memo->entries = entries;
+        }
+        frontier_record *records = realloc(memo->records, sizeof(frontier_record) * memo->nstates);
+        if (records) {
+            memo->records = records;
+        }
+        if (!entries || !records) {
+            return TM_NO_MEMORY;
+        }
+        memo->rows_cap = memo->nstates;
+    }
+    memset(memo->entries, 0, sizeof(frontier_entry) * memo->nstates);
+    memo->ready = 1;
+    return 0;
+}
+
+/**
+ * La tête arrive sur la case frontière cell dans l'état state, après steps
+ * pas. Sans issue connue, une excursion est ouverte pour cet état.
+ * @return l'issue connue, ou NULL
+ */
+const tm_frontier_outcome *tm_frontier_arrive(tm_frontier *f, int state, size_t cell, uint64_t steps) {
+    frontier_memo *memo = f->cur;
+    if (!memo->ready && HAS_ERROR(prepare(memo))) {
+        return NULL;
+    }
+    frontier_entry *e = &memo->entries[state];
+    if (e->kind == ENTRY_KNOWN) {
+        e->outcome.pattern = memo->pool + e->pattern_at;
+        return &e->outcome;
+    }
+    if (e->kind == ENTRY_UNKNOWN) {
+        e->kind = ENTRY_PENDING;
+        frontier_record *r = &memo->records[memo->nrecords++];
+        r->state = state;
+        r->cell = cell;
+        r->steps = steps;
+    }
+    return NULL;
+}
+
+/**
+ * Compte une issue appliquée par l'appelant.
+ */
+void tm_frontier_applied(tm_frontier *f, const tm_frontier_outcome *o) {
+    frontier_memo *memo = f->cur;
+    memo->stats.hits++;
+    memo->stats.skipped_steps += o->steps;
+}
+
+/**
+ * @return la case de l'excursion ouverte la plus récente (la tête qui passe
+ * à sa gauche la ferme), ou 0 s'il n'y en a pas
+ */
+size_t tm_frontier_floor(const tm_frontier *f) {
+    const frontier_memo *memo = f->cur;
+    return memo->nrecords ? memo->records[memo->nrecords - 1].cell : 0;
+}
+
+/**
+ * Ferme l'excursion r : ses cases vont de r->cell à reach.
+ */
+static void close_record(frontier_memo *memo, const frontier_record *r, int state, uint64_t steps,
+                         size_t head, const char *tape, size_t reach) {
+    frontier_entry *e = &memo->entries[r->state];
+    size_t extent = reach + 1 - r->cell;
+    uint64_t k = steps - r->steps;
+    e->kind = ENTRY_NONE;
+    if (k < TM_FRONTIER_MIN_STEPS || extent > TM_FRONTIER_MAX_EXTENT || memo->pool_len + extent > MAX_POOL) {
+        return;
+    }
+    if (memo->pool_len + extent > memo->pool_cap) {
+        size_t cap = memo->pool_cap ? memo->pool_cap : 4096;
+        while (cap < memo->pool_len + extent) {
+            cap *= 2;
+        }
+        char *grown = realloc(memo->pool, cap);
+        if (!grown) {
+            return;
+        }
+        memo->pool = grown;
+        memo->pool_cap = cap;
+    }
+    memcpy(memo->pool + memo->pool_len, tape + r->cell, extent);
+    e->pattern_at = memo->pool_len;
+    memo->pool_len += extent;
+    e->outcome.state = state;
+    e->outcome.steps = k;
+    e->outcome.extent = extent;
+    e->outcome.head = (int64_t) head - (int64_t) r->cell;
+    e->kind = ENTRY_KNOWN;
+    memo->stats.outcomes++;
+}
+
+/**
+ * La tête vient de passer à gauche de tm_frontier_floor() : ferme
+ * l'excursion la plus récente sur un retour dans l'état state.
+ */
+void tm_frontier_return(tm_frontier *f, int state, uint64_t steps, const char *tape, size_t reach) {
+    frontier_memo *memo = f->cur;
+    const frontier_record *r = &memo->records[--memo->nrecords];
+    close_record(memo, r, state, steps, r->cell - 1, tape, reach);
+}
+
+/**
+ * La machine s'arrête (acceptation, rejet ou transition manquante) dans
+ * l'état state : ferme toutes les excursions ouvertes.
+ */
+void tm_frontier_halt(tm_frontier *f, int state, uint64_t steps, size_t head, const char *tape, size_t reach) {
+    frontier_memo *memo = f->cur;
+    while (memo->nrecords > 0) {
+        const frontier_record *r = &memo->records[--memo->nrecords];
+        close_record(memo, r, state, steps, head, tape, reach);
+    }
+}
+
+/**
+ * L'exécution s'interrompt sans que l'issue des excursions ouvertes soit
+ * connue : elles sont oubliées.
+ */
+void tm_frontier_abandon(tm_frontier *f) {
+    frontier_memo *memo = f->cur;
+    while (memo->nrecords > 0) {
+        memo->entries[memo->records[--memo->nrecords].state].kind = ENTRY_UNKNOWN;
+    }
+}
+
+void tm_frontier_get_stats(const tm_frontier *f, tm_frontier_stats *stats) {
+    *stats = f->cur->stats;
+}
@@ -0,0 +1,65 @@
+//
+// Mémo des excursions sur la frontière blanche.
+//
+// Quand la tête arrive pour la première fois sur une case au-delà du mot et
+// de tout ce qui a été écrit, toutes les cases à partir de la tête sont
+// blanches : la suite de l'exécution, tant que la tête ne revient pas à
+// gauche de cette case, ne dépend que de l'état. Le mémo garde, pour chaque
+// état, l'issue de la première telle excursion : arrêt après k pas, ou
+// retour à gauche dans un état donné après k pas, avec les cases écrites.
+// Les arrivées suivantes dans le même état appliquent l'issue d'un coup.
+//
+#ifndef TP0_FRONTIER_H
+#define TP0_FRONTIER_H
+
+#include "machine.h"
+
+/* Excursions retenues : assez longues pour valoir un mémo, assez courtes
+ * pour que la copie des cases reste petite */
+#define TM_FRONTIER_MIN_STEPS 16
+#define TM_FRONTIER_MAX_EXTENT 4096
+
+/**
+ * Issue d'une excursion commencée sur la case frontière F dans un état
+ * donné : après steps pas, la machine est dans l'état state, les cases
+ * [F, F + extent) contiennent pattern et la tête est sur F + head (F - 1
+ * pour un retour à gauche ; sur un arrêt, state est l'état d'arrêt ou celui
+ * sans transition).
+ */
+typedef struct {
+    int state;
+    uint64_t steps;
+    size_t extent;
+    int64_t head;
+    const char *pattern;
+} tm_frontier_outcome;
+
+typedef struct {
+    size_t outcomes;        /* états dont l'issue est connue */
+    uint64_t hits;          /* issues appliquées */
+    uint64_t skipped_steps; /* pas franchis par ces issues */
+} tm_frontier_stats;
+
+tm_frontier *tm_frontier_create(void);
+
+void tm_frontier_free(tm_frontier *f);
+
+int tm_frontier_bind(tm_frontier *f, const tm_machine *m);
+
+int tm_frontier_is_bound(const tm_frontier *f, const tm_machine *m);
+
+const tm_frontier_outcome *tm_frontier_arrive(tm_frontier *f, int state, size_t cell, uint64_t steps);
+
+void tm_frontier_applied(tm_frontier *f, const tm_frontier_outcome *o);
+
+size_t tm_frontier_floor(const tm_frontier *f);
+
+void tm_frontier_return(tm_frontier *f, int state, uint64_t steps, const char *tape, size_t reach);
+
+void tm_frontier_halt(tm_frontier *f, int state, uint64_t steps, size_t head, const char *tape, size_t reach);
+
+void tm_frontier_abandon(tm_frontier *f);
+
+void tm_frontier_get_stats(const tm_frontier *f, tm_frontier_stats *stats);
+
+#endif //TP0_FRONTIER_H
@@ -0,0 +1,542 @@
+//
+// Exécution d'un lot de mots courts dans des voies SIMD.
+//
+// TM_LANES mots de la même machine avancent ensemble, un pas à la fois.
+// Chaque voie a son état, sa tête et sa portée ; les rubans sont
+// entrelacés (case i de la voie l en tape[i * TM_LANES + l]) si bien que
+// la lecture des cases courantes, de leurs colonnes et des transitions se
+// fait par des gathers vectoriels sur une table où chaque transition tient
+// dans 32 bits. Les écritures restent scalaires : AVX2 n'a pas de scatter.
+//
+// Une voie dont la machine s'arrête est vidée puis reprend le mot suivant
+// du lot. Une voie dont la tête atteint le bord de son ruban (W cases) est
+// évincée : sa configuration est recopiée dans un tm_config et l'exécution
+// se termine sur le chemin scalaire, avec le même résultat que tm_run.
+// Les voies sans mot exécutent un état fictif qui boucle sur place.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "lanes.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define TM_LANES_X86 1
+#include <immintrin.h>
+#endif
+
+/* Transition compactée : (ligne suivante + 1) << 10 | (mouvement + 1) << 8
+ * | colonne écrite ; 0 si la transition n'existe pas. La ligne d'un état
+ * est état * nsyms, si bien que la clé d'une voie est ligne + colonne. */
+#define PACK(row, column, move) (((uint32_t) (row) + 1) << 10 | (uint32_t) ((move) + 1) << 8 \
+                                 | (uint32_t) (column))
+#define MAX_PACKED_ROWS ((1u << 22) - 1)
+#define BUDGET_MAX INT32_MAX
+#define PARKED SIZE_MAX
+
+typedef struct {
+    int32_t row[TM_LANES];
+    int32_t head[TM_LANES];
+    int32_t reach[TM_LANES];
+    int32_t edge[TM_LANES];
+    int32_t budget[TM_LANES];
+    uint32_t entry[TM_LANES];
+    int32_t budget_start[TM_LANES];
+    uint64_t steps_done[TM_LANES];
+    size_t word[TM_LANES];
+
+    const tm_machine *m;
+    const tm_limits *limits;
+    const char *const *words;
+    const size_t *lens;
+    size_t n;
+    size_t next_word;
+    tm_result *results;
+    tm_lane_stats *stats;
+
+    int32_t *tape;
+    int32_t width;
+    const uint32_t *table;
+    int32_t nsyms;
+    int32_t accept_row;
+    int32_t reject_row;
+    int32_t parked_row;
+    int32_t blank;
+    char byte_of[256];
+} lane_set;
+
+static uint64_t lane_steps(const lane_set *L, int l) {
+    return L->steps_done[l] + (uint64_t) (L->budget_start[l] - L->budget[l]);
+}
+
+/**
+ * Donne à la voie l un nouveau budget de pas, borné par la limite du lot.
+ */
+static void refresh_budget(lane_set *L, int l) {
+    uint64_t max_steps = L->limits ? L->limits->max_steps : 0;
+    L->steps_done[l] = lane_steps(L, l);
+    uint64_t left = max_steps ? max_steps - L->steps_done[l] : BUDGET_MAX;
+    L->budget[l] = L->budget_start[l] = left > BUDGET_MAX ? BUDGET_MAX : (int32_t) left;
+}
+
+static void finish(lane_set *L, int l, int verdict) {
+    size_t len = L->lens[L->word[l]];
+    size_t reach = (size_t) L->reach[l];
+    tm_result *r = &L->results[L->word[l]];
+    r->verdict = verdict;
+    r->steps = lane_steps(L, l);
+    r->head = L->head[l];
+    r->tape_hwm = len > reach + 1 ? len - 1 : reach;
+    r->tape_low = 0;
+}
+
+/**
+ * Termine sur le chemin scalaire l'exécution d'une voie arrivée au bord de
+ * son ruban. Le ruban de la voie ne garde que des colonnes : chacune est
+ * remplacée par un octet de cette colonne, ce qui ne change pas la suite
+ * de l'exécution.
+ */
+static void evict(lane_set *L, int l) {
+    tm_config c;
+    size_t width = (size_t) L->width;
+    tm_result *r = &L->results[L->word[l]];
+    c.tape = malloc(2 * width);
+    if (!c.tape) {
+        finish(L, l, TM_NO_MEMORY);
+        return;
+    }
+    for (size_t i = 0; i < width; i++) {
+        c.tape[i] = L->byte_of[L->tape[i * TM_LANES + l]];
+    }
+    memset(c.tape + width, TM_BLANK, width);
+    c.cap = 2 * width;
+    c.len = L->lens[L->word[l]];
+    c.origin = 0;
+    c.two_way = 0;
+    c.state = L->row[l] / L->nsyms;
+    c.head = (size_t) L->head[l];
+    c.reach = (size_t) L->reach[l];
+    c.low = 0;
+    c.steps = lane_steps(L, l);
+    c.frontier = NULL;
+    c.profile = NULL;
+    int verdict = tm_config_run(L->m, &c, L->limits, SIZE_MAX);
+    tm_config_result(&c, verdict, r);
+    tm_config_release(&c);
+    if (L->stats) {
+        L->stats->evicted++;
+    }
+}
+
+/**
+ * Vide la voie l et y place le prochain mot court du lot ; les mots longs
+ * rencontrés en chemin passent par tm_run. Sans mot restant, la voie est
+ * garée sur l'état fictif.
+ * @return 1 si la voie a reçu un mot, 0 si elle est garée
+ */
+static int refill(lane_set *L, int l) {
+    size_t used = (size_t) L->reach[l] + 1;
+    if (L->word[l] != PARKED && L->lens[L->word[l]] > used) {
+        used = L->lens[L->word[l]];
+    }
+    if (used > (size_t) L->width) {
+        used = (size_t) L->width;
+    }
+    for (size_t i = 0; i < used; i++) {
+        L->tape[i * TM_LANES + l] = L->blank;
+    }
+    L->head[l] = 0;
+    L->reach[l] = 0;
+    L->steps_done[l] = 0;
+    L->budget[l] = L->budget_start[l] = 0;
+
+    while (L->next_word < L->n) {
+        size_t i = L->next_word++;
+        size_t len = L->lens[i];
+        if (len > TM_LANE_MAX_INPUT) {
+            tm_run(L->m, L->words[i], len, L->limits, &L->results[i]);
+            if (L->stats) {
+                L->stats->scalar++;
+            }
+            continue;
+        }
+        for (size_t c = 0; c < len; c++) {
+            L->tape[c * TM_LANES + l] = L->m->sym[(unsigned char) L->words[i][c]];
+        }
+        size_t limit_cell = SIZE_MAX;
+        if (L->limits && L->limits->max_tape) {
+            limit_cell = L->limits->max_tape > len ? L->limits->max_tape : len + 1;
+        }
+        L->word[l] = i;
+        L->row[l] = L->m->start * L->nsyms;
+        L->edge[l] = limit_cell < (size_t) L->width ? (int32_t) limit_cell : L->width;
+        refresh_budget(L, l);
+        return 1;
+    }
+    L->word[l] = PARKED;
+    L->row[l] = L->parked_row;
+    L->edge[l] = L->width;
+    L->budget[l] = L->budget_start[l] = BUDGET_MAX;
+    return 0;
+}
+
+/**
+ * Traite une voie signalée après un pas : limite de ruban, bord du ruban
+ * de la voie, état final ou budget épuisé, dans l'ordre où tm_run les voit.
+ * @return 1 si la voie a reçu un nouveau mot ou continue, 0 si elle est garée
+ */
+static int settle(lane_set *L, int l) {
+    if (L->word[l] == PARKED) {
+        L->budget[l] = L->budget_start[l] = BUDGET_MAX;
+        return 0;
+    }
+    uint64_t max_steps = L->limits ? L->limits->max_steps : 0;
+    size_t reach = (size_t) L->reach[l];
+    if (reach == (size_t) L->edge[l] && L->edge[l] < L->width) {
+        finish(L, l, TM_TAPE_LIMIT);
+    } else if (reach == (size_t) L->width) {
+        size_t len = L->lens[L->word[l]];
+        if (L->limits && L->limits->max_tape
+            && reach == (L->limits->max_tape > len ? L->limits->max_tape : len + 1)) {
+            finish(L, l, TM_TAPE_LIMIT);
+        } else {
+            evict(L, l);
+        }
+    } else if (L->row[l] == L->accept_row) {
+        finish(L, l, TM_ACCEPT);
+    } else if (L->row[l] == L->reject_row) {
+        finish(L, l, TM_REJECT);
+    } else if (L->budget[l] == 0) {
+        if (max_steps && lane_steps(L, l) == max_steps) {
+            finish(L, l, TM_STEP_LIMIT);
+        } else {
+            refresh_budget(L, l);
+            return 1;
+        }
+    } else {
+        return 1;
+    }
+    return refill(L, l);
+}
+
+/**
+ * Applique à la voie l la transition lue dans entry[l].
+ * @return 1 si la voie doit passer par settle()
+ */
+static unsigned apply_lane(lane_set *L, int l) {
+    uint32_t e = L->entry[l];
+    int32_t head = L->head[l];
+    L->tape[head * TM_LANES + l] = (int32_t) (e & 0xff);
+    L->row[l] = (int32_t) (e >> 10) - 1;
+    head += (int32_t) ((e >> 8) & 3) - 1;
+    if (head < 0) {
+        head = 0;
+    }
+    L->head[l] = head;
+    if (head > L->reach[l]) {
+        L->reach[l] = head;
+    }
+    L->budget[l]--;
+    return L->row[l] == L->accept_row || L->row[l] == L->reject_row
+           || L->budget[l] == 0 || L->reach[l] == L->edge[l];
+}
+
+/**
+ * Un pas de toutes les voies, version portable.
+ * @param nt reçoit le masque des voies sans transition ; si non nul, aucune
+ * voie n'a avancé
+ * @return le masque des voies à passer par settle()
+ */
+static unsigned step_portable(lane_set *L, unsigned *nt) {
+    unsigned none = 0;
+    for (int l = 0; l < TM_LANES; l++) {
+        uint32_t e = L->table[L->row[l] + L->tape[L->head[l] * TM_LANES + l]];
+        L->entry[l] = e;
+        none |= (unsigned) (e == 0) << l;
+    }
+    *nt = none;
+    if (none) {
+        return 0;
+    }
+    unsigned flagged = 0;
+    for (int l = 0; l < TM_LANES; l++) {
+        flagged |= apply_lane(L, l) << l;
+    }
+    return flagged;
+}
+
+#ifdef TM_LANES_X86
+/**
+ * Un pas de toutes les voies avec AVX2, par moitiés de 8 voies : gather de
+ * la colonne courante puis de la transition.
+ */
+__attribute__((target("avx2")))
+static unsigned step_avx2(lane_set *L, unsigned *nt) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i entries[2];
+    unsigned none = 0;
+    for (int h = 0; h < 2; h++) {
+        __m256i head = _mm256_loadu_si256((const __m256i *) (L->head + 8 * h));
+        __m256i row = _mm256_loadu_si256((const __m256i *) (L->row + 8 * h));
+        __m256i lane = _mm256_setr_epi32(8 * h, 8 * h + 1, 8 * h + 2, 8 * h + 3,
+                                         8 * h + 4, 8 * h + 5, 8 * h + 6, 8 * h + 7);
+        __m256i index = _mm256_add_epi32(_mm256_slli_epi32(head, 4), lane);
+        __m256i column = _mm256_i32gather_epi32((const int *) L->tape, index, 4);
+        entries[h] = _mm256_i32gather_epi32((const int *) L->table, _mm256_add_epi32(row, column), 4);
+        __m256i missing = _mm256_cmpeq_epi32(_mm256_srli_epi32(entries[h], 10), zero);
+        none |= (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(missing)) << (8 * h);
+        _mm256_storeu_si256((__m256i *) (L->entry + 8 * h), entries[h]);
+    }
+    *nt = none;
+    if (none) {
+        return 0;
+    }
+    for (int l = 0; l < TM_LANES; l++) {
+        L->tape[L->head[l] * TM_LANES + l] = (int32_t) (L->entry[l] & 0xff);
+    }
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i three = _mm256_set1_epi32(3);
+    const __m256i accept = _mm256_set1_epi32(L->accept_row);
+    const __m256i reject = _mm256_set1_epi32(L->reject_row);
+    unsigned flagged = 0;
+    for (int h = 0; h < 2; h++) {
+        __m256i e = entries[h];
+        __m256i row = _mm256_sub_epi32(_mm256_srli_epi32(e, 10), one);
+        __m256i move = _mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(e, 8), three), one);
+        __m256i head = _mm256_loadu_si256((const __m256i *) (L->head + 8 * h));
+        head = _mm256_max_epi32(_mm256_add_epi32(head, move), zero);
+        __m256i reach = _mm256_max_epi32(_mm256_loadu_si256((const __m256i *) (L->reach + 8 * h)), head);
+        __m256i budget = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *) (L->budget + 8 * h)), one);
+        __m256i edge = _mm256_loadu_si256((const __m256i *) (L->edge + 8 * h));
+        __m256i flag = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi32(row, accept), _mm256_cmpeq_epi32(row, reject)),
+                _mm256_or_si256(_mm256_cmpeq_epi32(budget, zero), _mm256_cmpeq_epi32(reach, edge)));
+        flagged |= (unsigned) _mm256_movemask_ps(_mm256_castsi256_ps(flag)) << (8 * h);
+        _mm256_storeu_si256((__m256i *) (L->row + 8 * h), row);
+        _mm256_storeu_si256((__m256i *) (L->head + 8 * h), head);
+        _mm256_storeu_si256((__m256i *) (L->reach + 8 * h), reach);
+        _mm256_storeu_si256((__m256i *) (L->budget + 8 * h), budget);
+    }
+    return flagged;
+}
+
+/**
+ * Un pas de toutes les voies avec AVX-512 : les 16 voies tiennent dans un
+ * registre et les écritures sur les rubans sont un scatter.
+ */
+__attribute__((target("avx512f")))
+static unsigned step_avx512(lane_set *L, unsigned *nt) {
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    __m512i head = _mm512_loadu_si512(L->head);
+    __m512i index = _mm512_add_epi32(_mm512_slli_epi32(head, 4), lane);
+    __m512i column = _mm512_i32gather_epi32(index, L->tape, 4);
+    __m512i e = _mm512_i32gather_epi32(_mm512_add_epi32(_mm512_loadu_si512(L->row), column), L->table, 4);
+    _mm512_storeu_si512(L->entry, e);
+    unsigned none = _mm512_cmpeq_epi32_mask(_mm512_srli_epi32(e, 10), zero);
+    *nt = none;
+    if (none) {
+        return 0;
+    }
+    _mm512_i32scatter_epi32(L->tape, index, _mm512_and_si512(e, _mm512_set1_epi32(0xff)), 4);
+    __m512i row = _mm512_sub_epi32(_mm512_srli_epi32(e, 10), one);
+    __m512i move = _mm512_sub_epi32(_mm512_and_si512(_mm512_srli_epi32(e, 8), _mm512_set1_epi32(3)), one);
+    head = _mm512_max_epi32(_mm512_add_epi32(head, move), zero);
+    __m512i reach = _mm512_max_epi32(_mm512_loadu_si512(L->reach), head);
+    __m512i budget = _mm512_sub_epi32(_mm512_loadu_si512(L->budget), one);
+    unsigned flagged = _mm512_cmpeq_epi32_mask(row, _mm512_set1_epi32(L->accept_row))
+                       | _mm512_cmpeq_epi32_mask(row, _mm512_set1_epi32(L->reject_row))
+                       | _mm512_cmpeq_epi32_mask(budget, zero)
+                       | _mm512_cmpeq_epi32_mask(reach, _mm512_loadu_si512(L->edge));
+    _mm512_storeu_si512(L->row, row);
+    _mm512_storeu_si512(L->head, head);
+    _mm512_storeu_si512(L->reach, reach);
+    _mm512_storeu_si512(L->budget, budget);
+    return flagged;
+}
+#endif
+
+typedef unsigned (*step_fn)(lane_set *, unsigned *);
+
+/* Version imposée par tm_lanes_set_backend(), ou NULL */
+static step_fn forced_step;
+static const char *forced_name;
+
+/**
+ * Choisit la version du pas selon le processeur, sauf si une version a été
+ * imposée.
+ */
+static step_fn pick_step(const char **name) {
+    if (forced_step) {
+        *name = forced_name;
+        return forced_step;
+    }
+#ifdef TM_LANES_X86
+    if (__builtin_cpu_supports("avx512f")) {
+        *name = "avx512";
+        return step_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return step_avx2;
+    }
+#endif
+    *name = "portable";
+    return step_portable;
+}
+
+const char *tm_lanes_backend(void) {
+    const char *name;
+    pick_step(&name);
+    return name;
+}
+
+/**
+ * Impose une version du pas à toutes les exécutions en voies qui suivent,
+ * pour comparer les versions entre elles. À appeler avant de lancer des
+ * fils qui exécutent des lots.
+ * @param name "avx512", "avx2", "portable", ou NULL pour revenir au choix
+ * selon le processeur
+ * @return 0, ou ERROR si ce processeur n'a pas cette version
+ */
+int tm_lanes_set_backend(const char *name) {
+    if (!name) {
+        forced_step = NULL;
+        return 0;
+    }
+    if (!strcmp(name, "portable")) {
+        forced_step = step_portable;
+        forced_name = "portable";
+        return 0;
+    }
+#ifdef TM_LANES_X86
+    if (!strcmp(name, "avx512") && __builtin_cpu_supports("avx512f")) {
+        forced_step = step_avx512;
+        forced_name = "avx512";
+        return 0;
+    }
+    if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) {
+        forced_step = step_avx2;
+        forced_name = "avx2";
+        return 0;
+    }
+#endif
+    return ERROR;
+}
+
+/**
+ * Exécute un lot de mots ; results[i] reçoit le même résultat que
+ * tm_run(m, words[i], lens[i], limits, ...). Les machines à ruban
+ * bi-infini et celles dont l'état initial est final passent par tm_run.
+ * @return 0 ou TM_NO_MEMORY
+ */
+int tm_run_lanes(const tm_machine *m, const char *const *words, const size_t *lens, size_t n,
+                 const tm_limits *limits, tm_result *results, tm_lane_stats *stats) {
+    size_t max_len = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (lens[i] <= TM_LANE_MAX_INPUT && lens[i] > max_len) {
+            max_len = lens[i];
+        }
+    }
+    if (m->tape_mode != TM_TAPE_RIGHT || m->start == m->accept || m->start == m->reject
+        || ((size_t) m->nstates + 1) * (size_t) m->nsyms > MAX_PACKED_ROWS || n < TM_LANES) {
+        for (size_t i = 0; i < n; i++) {
+            tm_run(m, words[i], lens[i], limits, &results[i]);
+        }
+        if (stats) {
+            stats->scalar += n;
+        }
+        return 0;
+    }
+
+    // Le mot et la case qui le suit tiennent toujours dans le ruban d'une voie
+    int32_t width = 32;
+    while ((size_t) width < 2 * (max_len + 1)) {
+        width *= 2;
+    }
+    size_t rows = (size_t) m->nstates + 1;
+    size_t table_size = sizeof(uint32_t) * rows * (size_t) m->nsyms;
+    size_t tape_size = sizeof(int32_t) * (size_t) width * TM_LANES;
+    tm_context *ctx = tm_context_acquire();
+    char *scratch = ctx ? tm_context_scratch(ctx, table_size + tape_size) : NULL;
+    if (!scratch) {
+        tm_context_release(ctx);
+        return TM_NO_MEMORY;
+    }
+
+    lane_set L;
+    L.m = m;
+    L.limits = limits;
+    L.words = words;
+    L.lens = lens;
+    L.n = n;
+    L.next_word = 0;
+    L.results = results;
+    L.stats = stats;
+    L.tape = (int32_t *) (scratch + table_size);
+    L.width = width;
+    L.nsyms = m->nsyms;
+    L.accept_row = m->accept * m->nsyms;
+    L.reject_row = m->reject * m->nsyms;
+    L.parked_row = m->nstates * m->nsyms;
+    L.blank = m->sym[(unsigned char) TM_BLANK];
+    for (int c = 255; c >= 0; c--) {
+        L.byte_of[m->sym[c]] = (char) c;
+    }
+    L.byte_of[L.blank] = TM_BLANK;
+
+    // Les rubans des voies portent des colonnes, les transitions des lignes
+    uint32_t *table = (uint32_t *) scratch;
+    for (size_t i = 0; i < (size_t) m->nstates * (size_t) m->nsyms; i++) {
+        const tm_entry *e = &m->table[i];
+        table[i] = e->next == TM_NO_STATE ? 0
+                   : PACK(e->next * m->nsyms, m->sym[(unsigned char) e->write], e->movement);
+    }
+    for (int s = 0; s < m->nsyms; s++) {
+        table[(size_t) L.parked_row + (size_t) s] = PACK(L.parked_row, L.blank, 0);
+    }
+    L.table = table;
+    for (size_t i = 0; i < (size_t) width * TM_LANES; i++) {
+        L.tape[i] = L.blank;
+    }
+
+    const char *backend;
+    step_fn step = pick_step(&backend);
+
+    int active = 0;
+    for (int l = 0; l < TM_LANES; l++) {
+        L.word[l] = PARKED;
+        L.reach[l] = 0;
+        active += refill(&L, l);
+    }
+    uint64_t vector_steps = 0;
+    while (active > 0) {
+        unsigned nt;
+        unsigned flagged = step(&L, &nt);
+        vector_steps++;
+        if (nt) {
+            // Rare : une ou plusieurs voies n'ont pas de transition
+            for (int l = 0; l < TM_LANES; l++) {
+                if (nt & (1u << l)) {
+                    finish(&L, l, TM_NO_TRANSITION);
+                    active += refill(&L, l) - 1;
+                } else {
+                    flagged |= apply_lane(&L, l) << l;
+                }
+            }
+        }
+        for (int l = 0; flagged; l++, flagged >>= 1) {
+            if (flagged & 1) {
+                int was_active = L.word[l] != PARKED;
+                active += settle(&L, l) - was_active;
+            }
+        }
+    }
+    if (stats) {
+        stats->vector_steps += vector_steps;
+        for (size_t i = 0; i < n; i++) {
+            stats->steps += results[i].steps;
+        }
+    }
+    tm_context_release(ctx);
+    return 0;
+}
@@ -0,0 +1,35 @@
+//
+// Exécution d'un lot de mots courts dans des voies SIMD.
+//
+#ifndef TP0_LANES_H
+#define TP0_LANES_H
+
+#include "machine.h"
+
+#define TM_LANES 16
+
+/* Les mots plus longs sont exécutés par tm_run */
+#define TM_LANE_MAX_INPUT 128
+
+/**
+ * Compteurs d'une exécution en voies.
+ */
+typedef struct {
+    uint64_t vector_steps;  /* pas de l'ensemble des voies */
+    uint64_t steps;         /* pas de machine, sur tous les mots du lot */
+    uint64_t evicted;       /* mots finis sur le chemin scalaire */
+    uint64_t scalar;        /* mots exécutés directement par tm_run */
+} tm_lane_stats;
+
+int tm_run_lanes(const tm_machine *m, const char *const *words, const size_t *lens, size_t n,
+                 const tm_limits *limits, tm_result *results, tm_lane_stats *stats);
+
+/**
+ * @return la version du pas choisie pour ce processeur : "avx512", "avx2"
+ * ou "portable"
+ */
+const char *tm_lanes_backend(void);
+
+int tm_lanes_set_backend(const char *name);
+
+#endif //TP0_LANES_H
@@ -0,0 +1,658 @@
+//
+// Chargement paresseux d'une machine (voir lazy_load.h).
+//
+// Une passe sur le fichier, sans allocation par ligne, construit l'index :
+// pour chaque état qui a des transitions, le décalage de ses lignes dans
+// le fichier (dans l'ordre du fichier), et l'alphabet lu par la machine.
+// Un état reçoit un identifiant quand une transition chargée y mène ; sa
+// ligne de table n'est remplie, depuis ses lignes du fichier, que la
+// première fois que l'exécution y entre. Le fichier est projeté en
+// mémoire et les pages lues par la passe d'index sont rendues au système :
+// seules celles des états visités reviennent.
+//
+// L'index peut être gardé dans machine_file.idx ; il reste valide tant que
+// la taille et la date de modification du fichier ne changent pas. Il est
+// alors projeté en mémoire et la passe d'index n'a pas lieu. Un fichier
+// modifié sans que ni l'une ni l'autre ne change passe inaperçu : ses
+// lignes sont revérifiées au chargement de chaque état, et une transition
+// qui lit un symbole absent de l'alphabet de l'index fait échouer
+// l'exécution (TM_LOAD_ERROR).
+//
+// Une machine paresseuse ne sert qu'un fil d'exécution à la fois.
+//
+#define _DEFAULT_SOURCE
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "lazy_load.h"
+#include "state_table.h"
+
+#define INDEX_MAGIC 0x31494d54u /* "TMI1" */
+
+/* next d'une ligne de table dont l'état n'est pas encore chargé */
+#define UNLOADED (-2)
+
+/* Au-delà, une ligne de transition est tronquée : parse_line() n'en lit
+ * que le début */
+#define LINE_BUF 64
+
+/**
+ * En-tête de l'index, suivi de nbuckets index_bucket puis de nlines
+ * décalages de lignes. Même disposition en mémoire et dans le fichier.
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t bucket_size;
+    uint64_t file_size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint64_t nbuckets;
+    uint64_t nlines;
+    uint64_t nnames;
+    uint64_t header_at[3];
+    uint32_t header_len[3];
+    int32_t nsyms;
+    unsigned char sym[256];
+} index_header;
+
+/**
+ * Case de la table de hachage des noms : les lignes de l'état sont
+ * lines[first .. first + count). count vaut 0 pour une case vide.
+ */
+typedef struct {
+    uint32_t hash;
+    uint32_t count;
+    uint64_t first;
+} index_bucket;
+
+struct tm_lazy_machine {
+    const char *text;
+    size_t size;
+    index_header *index;
+    size_t index_size;
+    int index_mapped;
+    const index_bucket *buckets;
+    const uint64_t *lines;
+    state_table st;
+    tm_entry *table;
+    int rows_cap;
+    int start;
+    int accept;
+    int reject;
+    tm_lazy_stats stats;
+};
+
+static uint32_t name_hash(const char *name, size_t len) {
+    char buf[MAX_STATE_LEN + 1];
+    memcpy(buf, name, len);
+    buf[len] = '\0';
+    return state_name_hash(buf);
+}
+
+/**
+ * @return vrai si la ligne qui commence au décalage at est une transition
+ * de l'état name
+ */
+static int line_of_state(const char *text, size_t size, uint64_t at, const char *name, size_t len) {
+    return at + len + 2 < size && text[at] == '(' && !memcmp(text + at + 1, name, len)
+           && text[at + 1 + len] == ',';
+}
+
+/**
+ * Passe d'index sur le texte d'une machine.
+ * @param index_size reçoit la taille de l'index
+ * @return l'index (à libérer) ou NULL si la description est invalide ou
+ * qu'une allocation a échoué
+ */
+static index_header *build_index(const char *text, size_t size, size_t *index_size) {
+    index_header h = {0};
+    uint64_t *line_at = NULL;
+    uint32_t *line_name = NULL;
+    size_t nlines = 0, lines_cap = 0;
+    uint32_t *name_hashes = NULL, *name_counts = NULL;
+    uint64_t *name_at = NULL, *cursor = NULL;
+    unsigned char *name_lens = NULL;
+    size_t nnames = 0, names_cap = 0;
+    uint32_t *slots = NULL;
+    size_t nslots = 0;
+    index_header *index = NULL;
+    int nheader = 0;
+    int ok = 0;
+
+    h.nsyms = 1;
+    size_t pos = 0;
+    while (pos < size) {
+        const char *line = text + pos;
+        const char *nl = memchr(line, '\n', size - pos);
+        size_t line_len = nl ? (size_t) (nl - line) : size - pos;
+        pos += line_len + 1;
+        if (line_len > 0 && line[line_len - 1] == '\r') {
+            line_len--;
+        }
+        if (nheader < 3) {
+            if (line_len == 0 || line_len > MAX_STATE_LEN) {
+                goto build_cleanup;
+            }
+            h.header_at[nheader] = (uint64_t) (line - text);
+            h.header_len[nheader++] = (uint32_t) line_len;
+            continue;
+        }
+        if (line_len == 0) {
+            continue;
+        }
+        if (!valid_transition_line(line, line_len)) {
+            goto build_cleanup;
+        }
+        size_t c1 = 1;
+        while (line[c1] != ',') {
+            c1++;
+        }
+        unsigned char read = (unsigned char) line[c1 + 1];
+        if (!h.sym[read]) {
+            h.sym[read] = (unsigned char) h.nsyms++;
+        }
+
+        if (2 * (nnames + 1) > nslots) {
+            size_t cap = nslots ? nslots * 2 : 1024;
+            uint32_t *grown = calloc(cap, sizeof(uint32_t));
+            if (!grown) {
+                goto build_cleanup;
+            }
+            for (size_t id = 0; id < nnames; id++) {
+                size_t j = name_hashes[id] & (cap - 1);
+                while (grown[j]) {
+                    j = (j + 1) & (cap - 1);
+                }
+                grown[j] = (uint32_t) id + 1;
+            }
+            free(slots);
+            slots = grown;
+            nslots = cap;
+        }
+        uint32_t hash = name_hash(line + 1, c1 - 1);
+        size_t j = hash & (nslots - 1);
+        while (slots[j] && (name_hashes[slots[j] - 1] != hash || name_lens[slots[j] - 1] != c1 - 1
+                            || !line_of_state(text, size, name_at[slots[j] - 1], line + 1, c1 - 1))) {
+            j = (j + 1) & (nslots - 1);
+        }
+        if (!slots[j]) {
+            if (nnames == names_cap) {
+                names_cap = names_cap ? names_cap * 2 : 256;
+                uint32_t *hashes = realloc(name_hashes, sizeof(uint32_t) * names_cap);
+                name_hashes = hashes ? hashes : name_hashes;
+                uint32_t *counts = realloc(name_counts, sizeof(uint32_t) * names_cap);
+                name_counts = counts ? counts : name_counts;
+                uint64_t *ats = realloc(name_at, sizeof(uint64_t) * names_cap);
+                name_at = ats ? ats : name_at;
+                unsigned char *lens = realloc(name_lens, names_cap);
+                name_lens = lens ? lens : name_lens;
+                if (!hashes || !counts || !ats || !lens) {
+                    goto build_cleanup;
+                }
+            }
+            name_hashes[nnames] = hash;
+            name_counts[nnames] = 0;
+            name_at[nnames] = (uint64_t) (line - text);
+            name_lens[nnames] = (unsigned char) (c1 - 1);
+            slots[j] = (uint32_t) ++nnames;
+        }
+        if (nlines == lines_cap) {
+            lines_cap = lines_cap ? lines_cap * 2 : 1024;
+            uint64_t *ats = realloc(line_at, sizeof(uint64_t) * lines_cap);
+            line_at = ats ? ats : line_at;
+            uint32_t *names = realloc(line_name, sizeof(uint32_t) * lines_cap);
+            line_name = names ? names : line_name;
+            if (!ats || !names) {
+                goto build_cleanup;
+            }
+        }
+        line_at[nlines] = (uint64_t) (line - text);
+        line_name[nlines++] = slots[j] - 1;
+        name_counts[slots[j] - 1]++;
+    }
+    if (nheader < 3) {
+        goto build_cleanup;
+    }
+
+    h.magic = INDEX_MAGIC;
+    h.bucket_size = sizeof(index_bucket);
+    h.nbuckets = 16;
+    while (h.nbuckets < 2 * nnames) {
+        h.nbuckets *= 2;
+    }
+    h.nlines = nlines;
+    h.nnames = nnames;
+    *index_size = sizeof(index_header) + sizeof(index_bucket) * h.nbuckets + sizeof(uint64_t) * nlines;
+    index = calloc(1, *index_size);
+    cursor = malloc(sizeof(uint64_t) * (nnames + 1));
+    if (!index || !cursor) {
+        goto build_cleanup;
+    }
+    *index = h;
+    index_bucket *buckets = (index_bucket *) (index + 1);
+    uint64_t *lines = (uint64_t *) (buckets + h.nbuckets);
+    uint64_t first = 0;
+    for (size_t id = 0; id < nnames; id++) {
+        size_t b = name_hashes[id] & (h.nbuckets - 1);
+        while (buckets[b].count) {
+            b = (b + 1) & (h.nbuckets - 1);
+        }
+        buckets[b].hash = name_hashes[id];
+        buckets[b].count = name_counts[id];
+        buckets[b].first = first;
+        cursor[id] = first;
+        first += name_counts[id];
+    }
+    // Lignes regroupées par état, dans l'ordre du fichier : la première
+    // transition gagne, comme dans tm_machine_parse()
+    for (size_t i = 0; i < nlines; i++) {
+        lines[cursor[line_name[i]]++] = line_at[i];
+    }
+    ok = 1;
+
+    build_cleanup:
+    free(line_at);
+    free(line_name);
+    free(name_hashes);
+    free(name_counts);
+    free(name_at);
+    free(name_lens);
+    free(cursor);
+    free(slots);
+    if (!ok) {
+        free(index);
+        index = NULL;
+    }
+    return index;
+}
+
+/**
+ * Projette l'index idx_path s'il correspond au fichier décrit par st.
+ * @return 0 ou ERROR (index absent, périmé ou invalide)
+ */
+static int map_index(tm_lazy_machine *lm, const char *idx_path, const struct stat *st) {
+    int fd = open(idx_path, O_RDONLY);
+    if (fd < 0) {
+        return ERROR;
+    }
+    struct stat ist;
+    if (fstat(fd, &ist) < 0 || (size_t) ist.st_size < sizeof(index_header)) {
+        close(fd);
+        return ERROR;
+    }
+    size_t size = (size_t) ist.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return ERROR;
+    }
+    const index_header *h = map;
+    int valid = h->magic == INDEX_MAGIC && h->bucket_size == sizeof(index_bucket)
+                && h->file_size == (uint64_t) st->st_size && h->mtime_sec == (int64_t) st->st_mtim.tv_sec
+                && h->mtime_nsec == (int64_t) st->st_mtim.tv_nsec
+                && h->nbuckets > 0 && !(h->nbuckets & (h->nbuckets - 1)) && h->nbuckets <= size
+                && h->nlines <= size && h->nsyms >= 1 && h->nsyms <= 256
+                && sizeof(index_header) + sizeof(index_bucket) * h->nbuckets + sizeof(uint64_t) * h->nlines == size;
+    for (int b = 0; valid && b < 256; b++) {
+        valid = h->sym[b] < h->nsyms;
+    }
+    for (int i = 0; valid && i < 3; i++) {
+        valid = h->header_len[i] > 0 && h->header_len[i] <= MAX_STATE_LEN
+                && h->header_at[i] + h->header_len[i] <= h->file_size;
+    }
+    if (!valid) {
+        munmap(map, size);
+        return ERROR;
+    }
+    lm->index = map;
+    lm->index_size = size;
+    lm->index_mapped = 1;
+    return 0;
+}
+
+/**
+ * Écrit l'index à côté du fichier, par un fichier temporaire renommé pour
+ * qu'un lecteur ne voie jamais un index à moitié écrit. Un échec n'est pas
+ * une erreur : l'index sera reconstruit au prochain chargement.
+ */
+static void save_index(const tm_lazy_machine *lm, const char *idx_path) {
+    size_t len = strlen(idx_path) + 24;
+    char *tmp = malloc(len);
+    if (!tmp) {
+        return;
+    }
+    snprintf(tmp, len, "%s.%ld", idx_path, (long) getpid());
+    FILE *fp = fopen(tmp, "wb");
+    int ok = fp && fwrite(lm->index, 1, lm->index_size, fp) == lm->index_size;
+    if (fp && fclose(fp) != 0) {
+        ok = 0;
+    }
+    if (!ok || rename(tmp, idx_path) != 0) {
+        remove(tmp);
+    }
+    free(tmp);
+}
+
+/**
+ * Agrandit la table pour qu'elle ait une ligne par état interné ; les
+ * nouvelles lignes sont marquées non chargées.
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int ensure_rows(tm_lazy_machine *lm) {
+    if (lm->st.count <= lm->rows_cap) {
+        return 0;
+    }
+    int nsyms = lm->index->nsyms;
+    int cap = lm->rows_cap ? lm->rows_cap * 2 : 64;
+    while (cap < lm->st.count) {
+        cap *= 2;
+    }
+    tm_entry *grown = realloc(lm->table, sizeof(tm_entry) * (size_t) cap * nsyms);
+    if (!grown) {
+        return TM_NO_MEMORY;
+    }
+    for (size_t i = (size_t) lm->rows_cap * nsyms; i < (size_t) cap * nsyms; i++) {
+        grown[i].next = UNLOADED;
+        grown[i].write = TM_BLANK;
+        grown[i].movement = 0;
+    }
+    lm->table = grown;
+    lm->rows_cap = cap;
+    lm->stats.table_bytes = sizeof(tm_entry) * (size_t) cap * nsyms;
+    return 0;
+}
+
+static void mark_row(tm_lazy_machine *lm, int id, int32_t next) {
+    tm_entry *row = &lm->table[(size_t) id * lm->index->nsyms];
+    for (int c = 0; c < lm->index->nsyms; c++) {
+        row[c].next = next;
+        row[c].write = TM_BLANK;
+        row[c].movement = 0;
+    }
+}
+
+/**
+ * Compile la ligne de table de l'état id depuis ses lignes du fichier.
+ * @return 0, TM_NO_MEMORY ou TM_LOAD_ERROR (index qui ne correspond pas
+ * au fichier)
+ */
+static int load_state(tm_lazy_machine *lm, int id) {
+    const index_header *ix = lm->index;
+    const char *name = lm->st.names[id];
+    size_t name_len = strlen(name);
+    uint32_t hash = state_name_hash(name);
+    size_t mask = ix->nbuckets - 1;
+    const index_bucket *b = NULL;
+    int status = 0;
+    for (size_t j = hash & mask; lm->buckets[j].count; j = (j + 1) & mask) {
+        const index_bucket *cand = &lm->buckets[j];
+        if (cand->hash != hash) {
+            continue;
+        }
+        if (cand->first >= ix->nlines || cand->count > ix->nlines - cand->first
+            || lm->lines[cand->first] >= lm->size) {
+            return TM_LOAD_ERROR;
+        }
+        if (line_of_state(lm->text, lm->size, lm->lines[cand->first], name, name_len)) {
+            b = cand;
+            break;
+        }
+    }
+    mark_row(lm, id, TM_NO_STATE);
+    for (uint32_t i = 0; b && HAS_NO_ERROR(status) && i < b->count; i++) {
+        uint64_t at = lm->lines[b->first + i];
+        if (at >= lm->size) {
+            status = TM_LOAD_ERROR;
+            break;
+        }
+        const char *line = lm->text + at;
+        const char *nl = memchr(line, '\n', lm->size - at);
+        size_t line_len = nl ? (size_t) (nl - line) : lm->size - at;
+        if (line_len > 0 && line[line_len - 1] == '\r') {
+            line_len--;
+        }
+        char buf[LINE_BUF];
+        if (line_len >= LINE_BUF) {
+            line_len = LINE_BUF - 1;
+        }
+        memcpy(buf, line, line_len);
+        buf[line_len] = '\0';
+        if (!valid_transition_line(buf, line_len) || !line_of_state(buf, line_len, 0, name, name_len)) {
+            status = TM_LOAD_ERROR;
+            break;
+        }
+        transition *t = parse_line(buf, line_len);
+        if (!t) {
+            status = TM_NO_MEMORY;
+            break;
+        }
+        // La colonne 0 est celle des octets qu'aucune transition ne lit
+        int column = ix->sym[(unsigned char) t->read];
+        int next = column ? state_table_intern(&lm->st, t->next_state, strlen(t->next_state)) : 0;
+        if (!column) {
+            status = TM_LOAD_ERROR;
+        } else if (HAS_ERROR(next) || HAS_ERROR(ensure_rows(lm))) {
+            status = TM_NO_MEMORY;
+        } else {
+            tm_entry *e = &lm->table[(size_t) id * ix->nsyms + column];
+            if (e->next == TM_NO_STATE) {
+                e->next = next;
+                e->write = t->write;
+                e->movement = t->movement;
+            }
+            lm->stats.parsed_lines++;
+        }
+        free(t->current_state);
+        free(t->next_state);
+        free(t);
+    }
+    if (HAS_ERROR(status)) {
+        mark_row(lm, id, UNLOADED);
+        return status;
+    }
+    lm->stats.loaded_states++;
+    return 0;
+}
+
+/**
+ * Ouvre une machine sans la compiler : seul l'index est construit (ou lu).
+ * @param machine_file le fichier de la description
+ * @param flags 0 ou TM_LAZY_INDEX_FILE
+ * @return la machine ou NULL si le fichier est illisible ou invalide
+ */
+tm_lazy_machine *tm_lazy_open(const char *machine_file, int flags) {
+    tm_lazy_machine *lm = calloc(1, sizeof(tm_lazy_machine));
+    char *idx_path = NULL;
+    int ok = 0;
+    if (!lm) {
+        return NULL;
+    }
+    int fd = open(machine_file, O_RDONLY);
+    if (fd < 0) {
+        goto open_cleanup;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        goto open_cleanup;
+    }
+    void *map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        goto open_cleanup;
+    }
+    lm->text = map;
+    lm->size = (size_t) st.st_size;
+
+    if (flags & TM_LAZY_INDEX_FILE) {
+        size_t len = strlen(machine_file) + 5;
+        if ((idx_path = malloc(len))) {
+            snprintf(idx_path, len, "%s.idx", machine_file);
+            lm->stats.index_reused = HAS_NO_ERROR(map_index(lm, idx_path, &st));
+        }
+    }
+    if (!lm->index) {
+        if (!(lm->index = build_index(lm->text, lm->size, &lm->index_size))) {
+            goto open_cleanup;
+        }
+        lm->index->file_size = (uint64_t) st.st_size;
+        lm->index->mtime_sec = (int64_t) st.st_mtim.tv_sec;
+        lm->index->mtime_nsec = (int64_t) st.st_mtim.tv_nsec;
+        madvise((void *) lm->text, lm->size, MADV_DONTNEED);
+        if (idx_path) {
+            save_index(lm, idx_path);
+        }
+    }
+    // Les états visités sont dispersés dans le fichier et dans l'index : pas
+    // de lecture anticipée autour des pages lues
+    madvise((void *) lm->text, lm->size, MADV_RANDOM);
+    if (lm->index_mapped) {
+        madvise(lm->index, lm->index_size, MADV_RANDOM);
+    }
+    lm->buckets = (const index_bucket *) (lm->index + 1);
+    lm->lines = (const uint64_t *) (lm->buckets + lm->index->nbuckets);
+    lm->stats.indexed_states = lm->index->nnames;
+    lm->stats.index_bytes = lm->index_size;
+
+    int header[3];
+    for (int i = 0; i < 3; i++) {
+        header[i] = state_table_intern(&lm->st, lm->text + lm->index->header_at[i], lm->index->header_len[i]);
+        if (HAS_ERROR(header[i])) {
+            goto open_cleanup;
+        }
+    }
+    lm->start = header[0];
+    lm->accept = header[1];
+    lm->reject = header[2];
+    ok = HAS_NO_ERROR(ensure_rows(lm));
+
+    open_cleanup:
+    free(idx_path);
+    if (!ok) {
+        tm_lazy_free(lm);
+        lm = NULL;
+    }
+    return lm;
+}
+
+void tm_lazy_free(tm_lazy_machine *lm) {
+    if (!lm) {
+        return;
+    }
+    if (lm->index_mapped) {
+        munmap(lm->index, lm->index_size);
+    } else {
+        free(lm->index);
+    }
+    if (lm->text) {
+        munmap((void *) lm->text, lm->size);
+    }
+    state_table_free(&lm->st);
+    free(lm->table);
+    free(lm);
+}
+
+/**
+ * Comme tm_run(), en chargeant les états au fil de l'exécution. Le ruban
+ * est infini vers la droite.
+ * @return le verdict ou un code d'erreur TM_*, TM_LOAD_ERROR si l'index ne
+ * correspond plus au fichier
+ */
+int tm_lazy_run(tm_lazy_machine *lm, const char *input, size_t len,
+                const tm_limits *limits, tm_result *result) {
+    uint64_t max_steps = limits ? limits->max_steps : 0;
+    // Même règle que run_loop() : le ruban peut toujours contenir le mot et
+    // la case qui le suit
+    size_t limit_cell = SIZE_MAX;
+    if (limits && limits->max_tape) {
+        limit_cell = limits->max_tape > len ? limits->max_tape : len + 1;
+    }
+    size_t cap = len < 8 ? 16 : 2 * len;
+    char *tape = malloc(cap);
+    if (!tape) {
+        if (result) {
+            memset(result, 0, sizeof(tm_result));
+            result->verdict = TM_NO_MEMORY;
+        }
+        return TM_NO_MEMORY;
+    }
+    memset(tape, TM_BLANK, cap);
+    memcpy(tape, input, len);
+    const unsigned char *sym = lm->index->sym;
+    const int nsyms = lm->index->nsyms;
+    int state = lm->start;
+    size_t head = 0, reach = 0;
+    uint64_t steps = 0;
+    int verdict;
+
+    for (;;) {
+        if (state == lm->accept) {
+            verdict = TM_ACCEPT;
+            break;
+        }
+        if (state == lm->reject) {
+            verdict = TM_REJECT;
+            break;
+        }
+        if (max_steps && steps == max_steps) {
+            verdict = TM_STEP_LIMIT;
+            break;
+        }
+        const tm_entry *e = &lm->table[(size_t) state * nsyms + sym[(unsigned char) tape[head]]];
+        if (e->next < 0) {
+            if (e->next == TM_NO_STATE) {
+                verdict = TM_NO_TRANSITION;
+                break;
+            }
+            int status = load_state(lm, state);
+            if (HAS_ERROR(status)) {
+                verdict = status;
+                break;
+            }
+            continue;
+        }
+        tape[head] = e->write;
+        state = e->next;
+        steps++;
+        if (e->movement < 0) {
+            if (head > 0) {
+                head--;
+            }
+        } else if (e->movement > 0 && ++head > reach) {
+            reach = head;
+            if (reach == limit_cell) {
+                verdict = TM_TAPE_LIMIT;
+                break;
+            }
+            if (head == cap) {
+                char *grown = realloc(tape, cap * 2);
+                if (!grown) {
+                    reach = --head;
+                    verdict = TM_NO_MEMORY;
+                    break;
+                }
+                memset(grown + cap, TM_BLANK, cap);
+                tape = grown;
+                cap *= 2;
+            }
+        }
+    }
+
+    if (result) {
+        result->verdict = verdict;
+        result->steps = steps;
+        result->head = (int64_t) head;
+        result->tape_hwm = len > reach + 1 ? len - 1 : reach;
+        result->tape_low = 0;
+    }
+    free(tape);
+    return verdict;
+}
+
+void tm_lazy_get_stats(const tm_lazy_machine *lm, tm_lazy_stats *stats) {
+    *stats = lm->stats;
+}
@@ -0,0 +1,37 @@
+//
+// Chargement paresseux d'une machine : un index des lignes de chaque état,
+// et la compilation d'un état à la première entrée de l'exécution.
+//
+#ifndef TP0_LAZY_LOAD_H
+#define TP0_LAZY_LOAD_H
+
+#include "machine.h"
+
+/* Options de tm_lazy_open() */
+#define TM_LAZY_INDEX_FILE 1    /* lit ou écrit l'index dans machine_file.idx */
+
+typedef struct tm_lazy_machine tm_lazy_machine;
+
+/**
+ * Compteurs d'une machine paresseuse. index_bytes et table_bytes sont à
+ * comparer à la table d'une machine compilée au complet.
+ */
+typedef struct {
+    size_t indexed_states;  /* états qui ont au moins une transition */
+    size_t loaded_states;
+    size_t parsed_lines;
+    size_t index_bytes;
+    size_t table_bytes;
+    int index_reused;       /* index lu dans le fichier .idx */
+} tm_lazy_stats;
+
+tm_lazy_machine *tm_lazy_open(const char *machine_file, int flags);
+
+void tm_lazy_free(tm_lazy_machine *lm);
+
+int tm_lazy_run(tm_lazy_machine *lm, const char *input, size_t len,
+                const tm_limits *limits, tm_result *result);
+
+void tm_lazy_get_stats(const tm_lazy_machine *lm, tm_lazy_stats *stats);
+
+#endif //TP0_LAZY_LOAD_H
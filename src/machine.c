@@ -0,0 +1,870 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "dfa.h"
+#include "frontier.h"
+#include "machine.h"
+#include "state_table.h"
+
+/**
+ * Vérifie qu'une ligne a la forme (état,s)->(état,s,M) avec des états d'au
+ * plus MAX_STATE_LEN caractères, seule forme que parse_line() sait lire.
+ */
+int valid_transition_line(const char *line, size_t len) {
+    size_t c1 = 1;
+    while (c1 < len && line[c1] != ',') {
+        c1++;
+    }
+    if (line[0] != '(' || c1 < 2 || c1 > MAX_STATE_LEN + 1 || c1 + 6 >= len) {
+        return 0;
+    }
+    if (line[c1 + 2] != ')' || line[c1 + 3] != '-' || line[c1 + 4] != '>' || line[c1 + 5] != '(') {
+        return 0;
+    }
+    size_t head = c1 + 6;
+    size_t c2 = head;
+    while (c2 < len && line[c2] != ',') {
+        c2++;
+    }
+    if (c2 == head || c2 - head > MAX_STATE_LEN || c2 + 4 >= len) {
+        return 0;
+    }
+    char move = line[c2 + 3];
+    return line[c2 + 2] == ',' && line[c2 + 4] == ')' && (move == 'G' || move == 'D' || move == 'R');
+}
+
+typedef struct {
+    int current;
+    int next;
+    unsigned char read;
+    char write;
+    signed char movement;
+} raw_transition;
+
+/**
+ * Compile la description d'une machine (même format que execute()).
+ * @param text le contenu du fichier de description
+ * @param len la longueur du contenu
+ * @return la machine compilée ou NULL si la description est invalide
+ */
+tm_machine *tm_machine_parse(const char *text, size_t len) {
+    tm_machine *m = NULL;
+    state_table st = {0};
+    raw_transition *raw = NULL;
+    size_t nraw = 0, raw_cap = 0;
+    int header[3];
+    int nheader = 0;
+    int ok = 0;
+
+    char *buf = malloc(len + 1);
+    if (!buf) {
+        return NULL;
+    }
+    memcpy(buf, text, len);
+    buf[len] = '\0';
+
+    size_t pos = 0;
+    while (pos < len) {
+        char *line = buf + pos;
+        size_t line_len = 0;
+        while (pos + line_len < len && line[line_len] != '\n') {
+            line_len++;
+        }
+        pos += line_len + 1;
+        line[line_len] = '\0';
+        if (line_len > 0 && line[line_len - 1] == '\r') {
+            line[--line_len] = '\0';
+        }
+
+        if (nheader < 3) {
+            if (line_len == 0 || line_len > MAX_STATE_LEN) {
+                goto parse_cleanup;
+            }
+            header[nheader] = state_table_intern(&st, line, line_len);
+            if (HAS_ERROR(header[nheader++])) {
+                goto parse_cleanup;
+            }
+            continue;
+        }
+        if (line_len == 0) {
+            continue;
+        }
+        if (!valid_transition_line(line, line_len)) {
+            goto parse_cleanup;
+        }
+
+        transition *t = parse_line(line, line_len);
+        if (!t) {
+            goto parse_cleanup;
+        }
+        if (nraw == raw_cap) {
+            raw_cap = raw_cap ? raw_cap * 2 : 32;
+            raw_transition *grown = realloc(raw, sizeof(raw_transition) * raw_cap);
+            if (!grown) {
+                free(t->current_state);
+                free(t->next_state);
+                free(t);
+                goto parse_cleanup;
+            }
+            raw = grown;
+        }
+        raw_transition *r = &raw[nraw++];
+        r->current = state_table_intern(&st, t->current_state, strlen(t->current_state));
+        r->next = state_table_intern(&st, t->next_state, strlen(t->next_state));
+        r->read = (unsigned char) t->read;
+        r->write = t->write;
+        r->movement = t->movement;
+        free(t->current_state);
+        free(t->next_state);
+        free(t);
+        if (HAS_ERROR(r->current) || HAS_ERROR(r->next)) {
+            goto parse_cleanup;
+        }
+    }
+    if (nheader < 3) {
+        goto parse_cleanup;
+    }
+
+    m = calloc(1, sizeof(tm_machine));
+    if (!m) {
+        goto parse_cleanup;
+    }
+    m->start = header[0];
+    m->accept = header[1];
+    m->reject = header[2];
+    m->tape_mode = TM_TAPE_RIGHT;
+    m->layout = tm_machine_new_layout();
+
+    m->nsyms = 1;
+    for (size_t i = 0; i < nraw; i++) {
+        if (!m->sym[raw[i].read]) {
+            m->sym[raw[i].read] = (unsigned char) m->nsyms++;
+        }
+    }
+    m->nstates = st.count;
+    m->table = malloc(sizeof(tm_entry) * (size_t) m->nstates * m->nsyms);
+    if (!m->table) {
+        goto parse_cleanup;
+    }
+    for (size_t i = 0; i < (size_t) m->nstates * m->nsyms; i++) {
+        m->table[i].next = TM_NO_STATE;
+        m->table[i].write = TM_BLANK;
+        m->table[i].movement = 0;
+    }
+    // Comme la recherche linéaire de execute(), la première transition gagne
+    for (size_t i = 0; i < nraw; i++) {
+        tm_entry *e = &m->table[(size_t) raw[i].current * m->nsyms + m->sym[raw[i].read]];
+        if (e->next == TM_NO_STATE) {
+            e->next = raw[i].next;
+            e->write = raw[i].write;
+            e->movement = raw[i].movement;
+        }
+    }
+    m->names = st.names;
+    st.names = NULL;
+    m->hash = tm_machine_hash(m);
+    m->dfa = tm_dfa_compile(m);
+    ok = 1;
+
+    parse_cleanup:
+    state_table_free(&st);
+    free(raw);
+    free(buf);
+    if (!ok && m) {
+        free(m->table);
+        free(m);
+        m = NULL;
+    }
+    return m;
+}
+
+/**
+ * Lit un fichier au complet.
+ * @param path le chemin du fichier
+ * @param len reçoit la longueur du contenu
+ * @return le contenu (terminé par '\0', à libérer) ou NULL en cas d'erreur
+ */
+char *tm_read_file(const char *path, size_t *len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        return NULL;
+    }
+    char *text = NULL;
+    long size = -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        size = ftell(fp);
+    }
+    if (size < 0 || fseek(fp, 0, SEEK_SET) != 0 || !(text = malloc((size_t) size + 1))
+        || fread(text, 1, (size_t) size, fp) != (size_t) size) {
+        free(text);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    text[size] = '\0';
+    *len = (size_t) size;
+    return text;
+}
+
+/**
+ * Lit et compile le fichier de description d'une machine.
+ * @param machine_file le fichier de la description
+ * @return la machine compilée ou NULL en cas d'erreur
+ */
+tm_machine *tm_machine_load(const char *machine_file) {
+    size_t len;
+    char *text = tm_read_file(machine_file, &len);
+    if (!text) {
+        return NULL;
+    }
+    tm_machine *m = tm_machine_parse(text, len);
+    free(text);
+    return m;
+}
+
+void tm_machine_free(tm_machine *m) {
+    if (!m) {
+        return;
+    }
+    for (int i = 0; i < m->nstates; i++) {
+        free(m->names[i]);
+    }
+    free(m->names);
+    free(m->table);
+    tm_dfa_free(m->dfa);
+    free(m);
+}
+
+/**
+ * Donne accès à une machine intégrée, sans analyse ni allocation : m
+ * pointe sur les tableaux constants de s. m ne doit être ni modifiée ni
+ * passée à tm_machine_free().
+ */
+void tm_machine_from_static(const tm_static_machine *s, tm_machine *m) {
+    m->names = (char **) s->names;
+    m->nstates = s->nstates;
+    m->start = s->start;
+    m->accept = s->accept;
+    m->reject = s->reject;
+    memcpy(m->sym, s->sym, sizeof(m->sym));
+    m->nsyms = s->nsyms;
+    m->table = (tm_entry *) s->table;
+    m->hash = s->hash;
+    m->tape_mode = s->tape_mode;
+    m->dfa = NULL;
+    m->layout = tm_machine_new_layout();
+}
+
+/* Dernier layout donné, commun à toutes les machines : une machine libérée
+ * puis remplacée à la même adresse, par une autre description ou par une
+ * renumérotation, n'en retrouve jamais un ancien */
+static uint64_t last_layout;
+static pthread_mutex_t layout_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @return un layout jamais donné jusqu'ici (voir tm_machine)
+ */
+uint64_t tm_machine_new_layout(void) {
+    pthread_mutex_lock(&layout_lock);
+    uint64_t layout = ++last_layout;
+    pthread_mutex_unlock(&layout_lock);
+    return layout;
+}
+
+static uint64_t mix64(uint64_t x) {
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+static uint64_t hash_state(const tm_machine *m, int id) {
+    return mix64(state_name_hash(m->names[id]) ^ ((uint64_t) strlen(m->names[id]) << 32));
+}
+
+/**
+ * Empreinte du contenu canonique de la machine : états initial, acceptant
+ * et rejetant puis l'ensemble des transitions effectives. Elle ne dépend ni
+ * de l'ordre des lignes ni des transitions masquées par une précédente.
+ */
+uint64_t tm_machine_hash(const tm_machine *m) {
+    uint64_t h = mix64(hash_state(m, m->start) + 1)
+                 ^ mix64(hash_state(m, m->accept) + 2)
+                 ^ mix64(hash_state(m, m->reject) + 3);
+    uint64_t sum = 0;
+    for (int s = 0; s < m->nstates; s++) {
+        uint64_t hs = hash_state(m, s);
+        for (int b = 0; b < 256; b++) {
+            if (!m->sym[b]) {
+                continue;
+            }
+            const tm_entry *e = &m->table[(size_t) s * m->nsyms + m->sym[b]];
+            if (e->next == TM_NO_STATE) {
+                continue;
+            }
+            uint64_t t = hs * 31 + (uint64_t) b;
+            t = mix64(t) ^ hash_state(m, e->next);
+            t = mix64(t + ((uint64_t) (unsigned char) e->write << 8) + (uint64_t) (e->movement + 1));
+            sum += t;
+        }
+    }
+    return mix64(h ^ sum);
+}
+
+/**
+ * @return l'identifiant de l'état name ou TM_NO_STATE s'il n'existe pas
+ */
+int tm_state_id(const tm_machine *m, const char *name) {
+    for (int i = 0; i < m->nstates; i++) {
+        if (!strcmp(m->names[i], name)) {
+            return i;
+        }
+    }
+    return TM_NO_STATE;
+}
+
+/**
+ * Choisit la capacité initiale du ruban et la position de la case 0. Sur
+ * un ruban bi-infini, l'origine est au milieu de l'allocation pour laisser
+ * autant de place à gauche qu'à droite.
+ */
+static void tape_layout(const tm_machine *m, size_t len, size_t *cap, size_t *origin) {
+    if (m->tape_mode == TM_TAPE_TWO_WAY) {
+        *cap = len < 8 ? 32 : 4 * len;
+        *origin = (*cap - len) / 2;
+    } else {
+        *cap = len < 8 ? 16 : 2 * len;
+        *origin = 0;
+    }
+}
+
+static void config_start(tm_config *c, const tm_machine *m, size_t len, size_t origin) {
+    c->len = len;
+    c->origin = origin;
+    c->two_way = m->tape_mode == TM_TAPE_TWO_WAY;
+    c->state = m->start;
+    c->head = origin;
+    c->reach = origin;
+    c->low = origin;
+    c->steps = 0;
+    c->frontier = NULL;
+    c->profile = NULL;
+}
+
+/**
+ * Prépare la configuration initiale : le mot est copié à partir de la
+ * case 0 du ruban, la tête est sur cette case et la machine dans son état
+ * initial.
+ * @return 0 ou TM_NO_MEMORY
+ */
+int tm_config_init(tm_config *c, const tm_machine *m, const char *input, size_t len) {
+    size_t cap, origin;
+    tape_layout(m, len, &cap, &origin);
+    c->tape = malloc(cap);
+    if (!c->tape) {
+        return TM_NO_MEMORY;
+    }
+    memset(c->tape, TM_BLANK, cap);
+    memcpy(c->tape + origin, input, len);
+    c->cap = cap;
+    config_start(c, m, len, origin);
+    return 0;
+}
+
+void tm_config_release(tm_config *c) {
+    free(c->tape);
+    c->tape = NULL;
+}
+
+/**
+ * Double un ruban bi-infini en recentrant son contenu : la moitié de la
+ * nouvelle place va de chaque côté, d'où un coût amorti constant quel que
+ * soit le côté qui déborde.
+ * @param shift reçoit le décalage appliqué aux positions
+ * @return le nouveau ruban ou NULL
+ */
+static char *regrow_centered(char *tape, size_t *cap, size_t *shift) {
+    size_t new_cap = *cap * 2;
+    char *grown = malloc(new_cap);
+    if (!grown) {
+        return NULL;
+    }
+    *shift = (new_cap - *cap) / 2;
+    memset(grown, TM_BLANK, *shift);
+    memcpy(grown + *shift, tape, *cap);
+    memset(grown + *shift + *cap, TM_BLANK, new_cap - *shift - *cap);
+    free(tape);
+    *cap = new_cap;
+    return grown;
+}
+
+#if defined(__GNUC__)
+#define TM_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define TM_ALWAYS_INLINE inline
+#endif
+
+/**
+ * Applique l'issue o d'une excursion commencée sur la case frontière head,
+ * si elle tient dans les limites et ne passe pas par stop_cell.
+ * @return 1 si l'issue est appliquée, 0 sinon
+ */
+static int apply_frontier(tm_frontier *f, const tm_frontier_outcome *o, char **tape, size_t *cap,
+                          int *state, size_t *head, size_t *reach, size_t low, uint64_t *steps,
+                          uint64_t max_steps, size_t limit_cell, size_t stop_cell) {
+    size_t last = *head + o->extent - 1;
+    if ((max_steps && o->steps > max_steps - *steps) || last - low >= limit_cell
+        || (stop_cell > *head && stop_cell <= last)) {
+        return 0;
+    }
+    if (last >= *cap) {
+        size_t new_cap = *cap * 2;
+        while (new_cap <= last) {
+            new_cap *= 2;
+        }
+        char *grown = realloc(*tape, new_cap);
+        if (!grown) {
+            return 0;
+        }
+        memset(grown + *cap, TM_BLANK, new_cap - *cap);
+        *tape = grown;
+        *cap = new_cap;
+    }
+    memcpy(*tape + *head, o->pattern, o->extent);
+    *state = o->state;
+    *steps += o->steps;
+    *reach = last;
+    *head = (size_t) ((int64_t) *head + o->head);
+    tm_frontier_applied(f, o);
+    return 1;
+}
+
+/**
+ * Boucle d'exécution. two_way, memo et profile sont des constantes à
+ * chaque site d'appel : chaque mode de ruban, avec ou sans mémo de
+ * frontière ou profil, a sa propre copie de la boucle, sans test de mode à
+ * chaque pas. Le mémo ne sert que sur un ruban infini à droite ; il n'est
+ * pas utilisé pendant un profil, qui doit voir chaque pas.
+ */
+static TM_ALWAYS_INLINE int run_loop(const tm_machine *m, tm_config *c, const tm_limits *limits,
+                                     size_t stop_at, const int two_way, const int memo, const int profile) {
+    uint64_t max_steps = limits ? limits->max_steps : 0;
+    // Le ruban peut toujours contenir le mot et la case qui le suit
+    size_t limit_cell = SIZE_MAX;
+    if (limits && limits->max_tape) {
+        limit_cell = limits->max_tape > c->len ? limits->max_tape : c->len + 1;
+    }
+    const tm_entry *table = m->table;
+    const unsigned char *sym = m->sym;
+    const int nsyms = m->nsyms;
+    const int accept = m->accept, reject = m->reject;
+    char *tape = c->tape;
+    size_t cap = c->cap;
+    size_t origin = c->origin;
+    int state = c->state;
+    size_t head = c->head;
+    size_t reach = c->reach;
+    size_t low = c->low;
+    uint64_t steps = c->steps;
+    size_t stop_cell = stop_at == SIZE_MAX ? SIZE_MAX : origin + stop_at;
+    tm_frontier *frontier = memo ? c->frontier : NULL;
+    size_t floor = memo ? tm_frontier_floor(frontier) : 0;
+    uint64_t *hits = profile ? c->profile : NULL;
+    int verdict;
+
+    for (;;) {
+        if (state == accept) {
+            verdict = TM_ACCEPT;
+            break;
+        }
+        if (state == reject) {
+            verdict = TM_REJECT;
+            break;
+        }
+        if (max_steps && steps == max_steps) {
+            verdict = TM_STEP_LIMIT;
+            break;
+        }
+        const tm_entry *e = &table[(size_t) state * nsyms + sym[(unsigned char) tape[head]]];
+        if (e->next == TM_NO_STATE) {
+            verdict = TM_NO_TRANSITION;
+            break;
+        }
+        if (profile) {
+            hits[e - table]++;
+        }
+        tape[head] = e->write;
+        state = e->next;
+        steps++;
+        if (e->movement < 0) {
+            if (head > low) {
+                head--;
+                if (memo && head < floor) {
+                    tm_frontier_return(frontier, state, steps, tape, reach);
+                    floor = tm_frontier_floor(frontier);
+                }
+            } else if (two_way) {
+                // La case de gauche porterait l'étendue à limit_cell + 1
+                if (reach - low + 1 == limit_cell) {
+                    verdict = TM_TAPE_LIMIT;
+                    break;
+                }
+                if (head == 0) {
+                    size_t shift;
+                    char *grown = regrow_centered(tape, &cap, &shift);
+                    if (!grown) {
+                        verdict = TM_NO_MEMORY;
+                        break;
+                    }
+                    tape = grown;
+                    head += shift;
+                    reach += shift;
+                    origin += shift;
+                    if (stop_cell != SIZE_MAX) {
+                        stop_cell += shift;
+                    }
+                }
+                low = --head;
+            }
+        } else if (e->movement > 0 && ++head > reach) {
+            reach = head;
+            if (reach - low == limit_cell) {
+                verdict = TM_TAPE_LIMIT;
+                break;
+            }
+            if (head == cap) {
+                char *grown;
+                if (two_way) {
+                    size_t shift;
+                    if ((grown = regrow_centered(tape, &cap, &shift))) {
+                        head += shift;
+                        reach += shift;
+                        low += shift;
+                        origin += shift;
+                        if (stop_cell != SIZE_MAX) {
+                            stop_cell += shift;
+                        }
+                    }
+                } else if ((grown = realloc(tape, cap * 2))) {
+                    memset(grown + cap, TM_BLANK, cap);
+                    cap *= 2;
+                }
+                if (!grown) {
+                    // La case n'a jamais existé : ni la tête ni reach n'y restent
+                    reach = --head;
+                    verdict = TM_NO_MEMORY;
+                    break;
+                }
+                tape = grown;
+            }
+            if (head == stop_cell) {
+                verdict = TM_RUNNING;
+                break;
+            }
+            // Au-delà du mot et de tout ce qui a été écrit : frontière blanche
+            if (memo && head >= c->len) {
+                const tm_frontier_outcome *o = tm_frontier_arrive(frontier, state, head, steps);
+                if (o) {
+                    apply_frontier(frontier, o, &tape, &cap, &state, &head, &reach, low, &steps,
+                                   max_steps, limit_cell, stop_cell);
+                }
+                floor = tm_frontier_floor(frontier);
+            }
+        }
+    }
+
+    if (memo) {
+        if (verdict == TM_ACCEPT || verdict == TM_REJECT || verdict == TM_NO_TRANSITION) {
+            tm_frontier_halt(frontier, state, steps, head, tape, reach);
+        } else {
+            tm_frontier_abandon(frontier);
+        }
+    }
+
+    c->tape = tape;
+    c->cap = cap;
+    c->origin = origin;
+    c->state = state;
+    c->head = head;
+    c->reach = reach;
+    c->low = low;
+    c->steps = steps;
+    return verdict;
+}
+
+/**
+ * Fait avancer la machine jusqu'à l'arrêt, ou jusqu'à ce que la tête arrive
+ * pour la première fois sur la case stop_at (avant de la lire). Avec
+ * TM_TAPE_RIGHT, le ruban est infini vers la droite et un déplacement à
+ * gauche de la case 0 laisse la tête en place ; avec TM_TAPE_TWO_WAY, il
+ * est infini des deux côtés.
+ * @param stop_at la case où s'arrêter, SIZE_MAX pour aller jusqu'au bout
+ * @return le verdict, un code d'erreur TM_* ou TM_RUNNING si la tête a
+ * atteint stop_at
+ */
+int tm_config_run(const tm_machine *m, tm_config *c, const tm_limits *limits, size_t stop_at) {
+    if (c->profile) {
+        return c->two_way ? run_loop(m, c, limits, stop_at, 1, 0, 1) : run_loop(m, c, limits, stop_at, 0, 0, 1);
+    }
+    if (c->two_way) {
+        return run_loop(m, c, limits, stop_at, 1, 0, 0);
+    }
+    if (c->frontier && tm_frontier_is_bound(c->frontier, m)) {
+        return run_loop(m, c, limits, stop_at, 0, 1, 0);
+    }
+    return run_loop(m, c, limits, stop_at, 0, 0, 0);
+}
+
+void tm_config_result(const tm_config *c, int verdict, tm_result *result) {
+    size_t reach = c->reach - c->origin;
+    result->verdict = verdict;
+    result->steps = c->steps;
+    result->head = (int64_t) c->head - (int64_t) c->origin;
+    result->tape_hwm = c->len > reach + 1 ? c->len - 1 : reach;
+    result->tape_low = c->origin - c->low;
+}
+
+/**
+ * Crée un contexte d'exécution réutilisable.
+ * @return le contexte ou NULL si l'allocation a échoué
+ */
+tm_context *tm_context_create(void) {
+    return calloc(1, sizeof(tm_context));
+}
+
+void tm_context_free(tm_context *ctx) {
+    if (!ctx) {
+        return;
+    }
+    free(ctx->tape);
+    free(ctx->scratch);
+    tm_frontier_free(ctx->frontier);
+    free(ctx);
+}
+
+/**
+ * Retourne une zone de travail d'au moins size octets, valide jusqu'au
+ * prochain appel.
+ */
+void *tm_context_scratch(tm_context *ctx, size_t size) {
+    if (size > ctx->scratch_cap) {
+        void *grown = malloc(size);
+        if (!grown) {
+            return NULL;
+        }
+        free(ctx->scratch);
+        ctx->scratch = grown;
+        ctx->scratch_cap = size;
+    }
+    return ctx->scratch;
+}
+
+/**
+ * Comme tm_config_init(), mais sur le ruban du contexte. Seules les cases
+ * salies par l'exécution précédente sont remises à blanc. Sur un ruban
+ * infini à droite, la configuration utilise le mémo de frontière du
+ * contexte pour m ; le contexte garde ceux de ses dernières machines.
+ * @return 0 ou TM_NO_MEMORY
+ */
+int tm_context_begin(tm_context *ctx, tm_config *c, const tm_machine *m, const char *input, size_t len) {
+    size_t cap, origin;
+    tape_layout(m, len, &cap, &origin);
+    if (ctx->cap < cap) {
+        // Pas de realloc : l'ancien contenu n'a pas besoin d'être copié
+        char *tape = malloc(cap);
+        if (!tape) {
+            return TM_NO_MEMORY;
+        }
+        free(ctx->tape);
+        memset(tape, TM_BLANK, cap);
+        ctx->tape = tape;
+        ctx->cap = cap;
+        ctx->dirty_low = ctx->dirty = 0;
+    } else if (m->tape_mode == TM_TAPE_TWO_WAY) {
+        origin = (ctx->cap - len) / 2;
+    }
+    // Le mot écrase de toute façon [origin, origin + len)
+    size_t end = origin + len;
+    if (ctx->dirty_low < origin) {
+        memset(ctx->tape + ctx->dirty_low, TM_BLANK, (ctx->dirty < origin ? ctx->dirty : origin) - ctx->dirty_low);
+    }
+    if (ctx->dirty > end) {
+        size_t from = ctx->dirty_low > end ? ctx->dirty_low : end;
+        memset(ctx->tape + from, TM_BLANK, ctx->dirty - from);
+    }
+    memcpy(ctx->tape + origin, input, len);
+    c->tape = ctx->tape;
+    c->cap = ctx->cap;
+    config_start(c, m, len, origin);
+    // Sans mémoire pour le mémo, l'exécution se fait sans
+    if (m->tape_mode == TM_TAPE_RIGHT) {
+        if (!ctx->frontier) {
+            ctx->frontier = tm_frontier_create();
+        }
+        if (ctx->frontier && HAS_NO_ERROR(tm_frontier_bind(ctx->frontier, m))) {
+            c->frontier = ctx->frontier;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Rend au contexte le ruban d'une configuration commencée par
+ * tm_context_begin() et note la partie salie : le mot et les cases entre
+ * low et reach, hors desquelles rien n'a été écrit.
+ */
+void tm_context_end(tm_context *ctx, tm_config *c) {
+    ctx->tape = c->tape;
+    ctx->cap = c->cap;
+    size_t end = c->origin + c->len;
+    size_t dirty = c->reach + 1 > end ? c->reach + 1 : end;
+    ctx->dirty = dirty < c->cap ? dirty : c->cap;
+    ctx->dirty_low = c->low;
+    c->tape = NULL;
+}
+
+#define POOL_SIZE 4
+#define POOL_MAX_TAPE (16u << 20)
+
+typedef struct {
+    tm_context *free[POOL_SIZE];
+    int count;
+} context_pool;
+
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+static void pool_destroy(void *arg) {
+    context_pool *pool = arg;
+    for (int i = 0; i < pool->count; i++) {
+        tm_context_free(pool->free[i]);
+    }
+    free(pool);
+}
+
+static void pool_key_init(void) {
+    pthread_key_create(&pool_key, pool_destroy);
+}
+
+static context_pool *thread_pool(void) {
+    pthread_once(&pool_once, pool_key_init);
+    context_pool *pool = pthread_getspecific(pool_key);
+    if (!pool && (pool = calloc(1, sizeof(context_pool)))) {
+        pthread_setspecific(pool_key, pool);
+    }
+    return pool;
+}
+
+/**
+ * Prend un contexte dans la réserve du fil courant (ou en crée un).
+ * @return le contexte ou NULL si l'allocation a échoué
+ */
+tm_context *tm_context_acquire(void) {
+    context_pool *pool = thread_pool();
+    if (pool && pool->count > 0) {
+        return pool->free[--pool->count];
+    }
+    return tm_context_create();
+}
+
+/**
+ * Remet un contexte dans la réserve du fil courant. Un ruban devenu très
+ * grand est libéré plutôt que gardé.
+ */
+void tm_context_release(tm_context *ctx) {
+    if (!ctx) {
+        return;
+    }
+    context_pool *pool = thread_pool();
+    if (!pool || pool->count == POOL_SIZE) {
+        tm_context_free(ctx);
+        return;
+    }
+    if (ctx->cap > POOL_MAX_TAPE) {
+        free(ctx->tape);
+        ctx->tape = NULL;
+        ctx->cap = 0;
+        ctx->dirty_low = ctx->dirty = 0;
+    }
+    pool->free[pool->count++] = ctx;
+}
+
+/**
+ * Exécute une machine compilée sur le mot input, avec un contexte de la
+ * réserve du fil courant. Une machine qui a un automate (m->dfa) est
+ * exécutée par un parcours du mot, sans ruban ni contexte.
+ * @param m la machine
+ * @param input le mot d'entrée (pas forcément terminé par '\0')
+ * @param len la longueur du mot
+ * @param limits les limites de l'exécution, ou NULL
+ * @param result le résultat détaillé, ou NULL
+ * @return le verdict (TM_ACCEPT, TM_REJECT) ou un code d'erreur TM_*
+ */
+int tm_run(const tm_machine *m, const char *input, size_t len,
+           const tm_limits *limits, tm_result *result) {
+    if (m->dfa) {
+        int verdict = tm_dfa_run(m, input, len, limits, result);
+        if (verdict != TM_RUNNING) {
+            return verdict;
+        }
+    }
+    tm_context *ctx = tm_context_acquire();
+    int verdict = ctx ? tm_context_run(ctx, m, input, len, limits, result) : TM_NO_MEMORY;
+    if (!ctx && result) {
+        memset(result, 0, sizeof(tm_result));
+        result->verdict = TM_NO_MEMORY;
+    }
+    tm_context_release(ctx);
+    return verdict;
+}
+
+/**
+ * Comme tm_run(), avec un contexte fourni par l'appelant.
+ */
+int tm_context_run(tm_context *ctx, const tm_machine *m, const char *input, size_t len,
+                   const tm_limits *limits, tm_result *result) {
+    if (m->dfa) {
+        int verdict = tm_dfa_run(m, input, len, limits, result);
+        if (verdict != TM_RUNNING) {
+            return verdict;
+        }
+    }
+    tm_config c;
+    if (HAS_ERROR(tm_context_begin(ctx, &c, m, input, len))) {
+        if (result) {
+            memset(result, 0, sizeof(tm_result));
+            result->verdict = TM_NO_MEMORY;
+        }
+        return TM_NO_MEMORY;
+    }
+    int verdict = tm_config_run(m, &c, limits, SIZE_MAX);
+    if (result) {
+        tm_config_result(&c, verdict, result);
+    }
+    tm_context_end(ctx, &c);
+    return verdict;
+}
+
+const char *tm_verdict_name(int verdict) {
+    switch (verdict) {
+        case TM_ACCEPT:
+            return "accept";
+        case TM_REJECT:
+            return "reject";
+        case TM_NO_TRANSITION:
+            return "no_transition";
+        case TM_STEP_LIMIT:
+            return "step_limit";
+        case TM_TAPE_LIMIT:
+            return "tape_limit";
+        case TM_LOAD_ERROR:
+            return "load_error";
+        case TM_NO_MEMORY:
+            return "no_memory";
+        default:
+            return "error";
+    }
+}
@@ -0,0 +1,198 @@
+//
+// Machine de Turing compilée : états internés et table de transitions dense.
+//
+#ifndef TP0_MACHINE_H
+#define TP0_MACHINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "main.h"
+
+/* Mêmes définitions que main.c */
+#ifndef ERROR
+#define ERROR (-1)
+#define HAS_ERROR(code) ((code) < 0)
+#define HAS_NO_ERROR(code) ((code) >= 0)
+#endif
+
+#define TM_BLANK ' '
+#define TM_NO_STATE (-1)
+
+/* Verdicts et codes d'erreur (même convention que error_code : < 0 = erreur) */
+#define TM_ACCEPT 1
+#define TM_REJECT 0
+#define TM_NO_TRANSITION (-1)
+#define TM_STEP_LIMIT (-2)
+#define TM_TAPE_LIMIT (-3)
+#define TM_LOAD_ERROR (-4)
+#define TM_NO_MEMORY (-5)
+/* Retourné par tm_config_run() quand l'exécution est suspendue */
+#define TM_RUNNING 2
+
+/* Modes de ruban (tm_machine.tape_mode) */
+#define TM_TAPE_RIGHT 0
+#define TM_TAPE_TWO_WAY 1
+
+/**
+ * Une case de la table de transitions. next vaut TM_NO_STATE si la
+ * transition n'est pas définie.
+ */
+typedef struct {
+    int32_t next;
+    char write;
+    signed char movement;
+} tm_entry;
+
+typedef struct tm_dfa tm_dfa;
+
+typedef struct tm_frontier tm_frontier;
+
+/**
+ * Machine compilée. Les symboles sont internés : sym[octet] donne la colonne
+ * de la table, la colonne 0 étant réservée aux octets qu'aucune transition
+ * ne lit. La transition (état, octet) est table[état * nsyms + sym[octet]].
+ * dfa est l'automate équivalent quand aucune transition ne va à gauche
+ * (voir dfa.h), NULL sinon. layout identifie la numérotation des états :
+ * une valeur propre à chaque machine créée, renouvelée à chaque
+ * tm_machine_relayout(), pour qu'un mémo indexé par état ne serve ni une
+ * autre machine à la même adresse ni une machine renumérotée.
+ */
+typedef struct {
+    char **names;
+    int nstates;
+    int start;
+    int accept;
+    int reject;
+    unsigned char sym[256];
+    int nsyms;
+    tm_entry *table;
+    uint64_t hash;
+    int tape_mode;
+    tm_dfa *dfa;
+    uint64_t layout;
+} tm_machine;
+
+/**
+ * Machine intégrée à la compilation par tm_embed() (voir CMakeLists.txt) :
+ * les champs de tm_machine, dans des tableaux constants générés.
+ */
+typedef struct {
+    const char *const *names;
+    int nstates;
+    int start;
+    int accept;
+    int reject;
+    unsigned char sym[256];
+    int nsyms;
+    const tm_entry *table;
+    uint64_t hash;
+    int tape_mode;
+} tm_static_machine;
+
+/**
+ * Limites d'une exécution ; 0 veut dire « pas de limite ».
+ */
+typedef struct {
+    uint64_t max_steps;
+    size_t max_tape;
+} tm_limits;
+
+/**
+ * Résultat d'une exécution.
+ */
+typedef struct {
+    int verdict;
+    uint64_t steps;
+    int64_t head;
+    size_t tape_hwm;
+    size_t tape_low;
+} tm_result;
+
+/**
+ * Configuration d'une exécution en cours. Les positions sont des indices
+ * dans tape ; la case 0 du ruban est à l'indice origin (toujours 0 pour
+ * TM_TAPE_RIGHT). reach et low sont les cases la plus à droite et la plus
+ * à gauche que la tête a atteintes ; au-delà, le ruban contient encore le
+ * mot d'entrée (len octets) ou du blanc. frontier est le mémo des
+ * excursions sur la frontière blanche (voir frontier.h), ou NULL ; profile
+ * compte les passages par chaque case de la table (voir profile.h), ou
+ * NULL.
+ */
+typedef struct {
+    char *tape;
+    size_t cap;
+    size_t len;
+    size_t origin;
+    int two_way;
+    int state;
+    size_t head;
+    size_t reach;
+    size_t low;
+    uint64_t steps;
+    tm_frontier *frontier;
+    uint64_t *profile;
+} tm_config;
+
+/**
+ * Contexte d'exécution réutilisable : un ruban, une zone de travail et le
+ * mémo de frontière de la dernière machine, qui survivent d'une exécution
+ * à l'autre. Hors de [dirty_low, dirty), toutes les cases du ruban sont
+ * blanches.
+ */
+typedef struct {
+    char *tape;
+    size_t cap;
+    size_t dirty_low;
+    size_t dirty;
+    void *scratch;
+    size_t scratch_cap;
+    tm_frontier *frontier;
+} tm_context;
+
+char *tm_read_file(const char *path, size_t *len);
+
+tm_machine *tm_machine_load(const char *machine_file);
+
+tm_machine *tm_machine_parse(const char *text, size_t len);
+
+void tm_machine_free(tm_machine *m);
+
+void tm_machine_from_static(const tm_static_machine *s, tm_machine *m);
+
+uint64_t tm_machine_new_layout(void);
+
+uint64_t tm_machine_hash(const tm_machine *m);
+
+int tm_state_id(const tm_machine *m, const char *name);
+
+int tm_run(const tm_machine *m, const char *input, size_t len,
+           const tm_limits *limits, tm_result *result);
+
+int tm_config_init(tm_config *c, const tm_machine *m, const char *input, size_t len);
+
+int tm_config_run(const tm_machine *m, tm_config *c, const tm_limits *limits, size_t stop_at);
+
+void tm_config_result(const tm_config *c, int verdict, tm_result *result);
+
+void tm_config_release(tm_config *c);
+
+tm_context *tm_context_create(void);
+
+void tm_context_free(tm_context *ctx);
+
+void *tm_context_scratch(tm_context *ctx, size_t size);
+
+int tm_context_begin(tm_context *ctx, tm_config *c, const tm_machine *m, const char *input, size_t len);
+
+void tm_context_end(tm_context *ctx, tm_config *c);
+
+int tm_context_run(tm_context *ctx, const tm_machine *m, const char *input, size_t len,
+                   const tm_limits *limits, tm_result *result);
+
+tm_context *tm_context_acquire(void);
+
+void tm_context_release(tm_context *ctx);
+
+const char *tm_verdict_name(int verdict);
+
+#endif //TP0_MACHINE_H
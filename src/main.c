@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include "main.h"
+#include "alloc_track.h"
 
 
 typedef unsigned char byte;
@@ -369,6 +370,9 @@ error_code execute(char *machine_file, char *input) {
 
 // ༽つ۞﹏۞༼つ
 
+// TP0_LIBRARY est défini quand main.c est lié dans la bibliothèque libtm
+// (voir CMakeLists.txt) : les outils tm* fournissent alors leur propre main().
+#ifndef TP0_LIBRARY
 int main() {
 // ous pouvez ajouter des tests pour les fonctions ici
     char *temp = "22";
@@ -412,5 +416,6 @@ int main() {
     return 0;
 
 }
+#endif // TP0_LIBRARY
 
 // ༽つ۞﹏۞༼つ
\ No newline at end of file
@@ -6,7 +6,6 @@
 #ifndef TP0_MAIN_H
 #define TP0_MAIN_H
 
-#endif //TP0_MAIN_H
 typedef unsigned char byte;
 typedef int error_code;
 
@@ -31,4 +30,6 @@ error_code memcpy2(void *dest, void *src, size_t len);
 
 transition *parse_line(char *line, size_t len);
 
-error_code execute(char *machine_file, char *input);
\ No newline at end of file
+error_code execute(char *machine_file, char *input);
+
+#endif //TP0_MAIN_H
@@ -0,0 +1,312 @@
+//
+// Machines de Turing à plusieurs rubans (voir multitape.h).
+//
+// Le chargement suit celui d'une machine à un ruban : noms d'états
+// internés, puis une table dense indexée par (état, k-uplet lu). Chaque
+// ruban a ses cellules, sa capacité et sa tête, et ne grandit que vers la
+// droite.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "multitape.h"
+#include "state_table.h"
+
+#define MAX_TABLE_ENTRIES (1u << 26)
+
+typedef struct {
+    int current;
+    int next;
+    unsigned char read[TM_MAX_TAPES];
+    char write[TM_MAX_TAPES];
+    signed char movement[TM_MAX_TAPES];
+} mt_raw;
+
+static signed char parse_move(char c) {
+    return c == 'D' ? 1 : c == 'G' ? -1 : 0;
+}
+
+/**
+ * Analyse une transition à k rubans. Si *k vaut 0, il est déduit de la
+ * ligne.
+ * @return 0 ou ERROR si la ligne est mal formée
+ */
+static int parse_mt_line(state_table *st, const char *line, size_t len, int *k, mt_raw *r) {
+    if (len < 10 || line[0] != '(') {
+        return ERROR;
+    }
+    size_t c1 = 1;
+    while (c1 < len && line[c1] != ',') {
+        c1++;
+    }
+    if (c1 < 2 || c1 > MAX_STATE_LEN + 1) {
+        return ERROR;
+    }
+    if (*k == 0) {
+        const char *arrow = NULL;
+        for (size_t i = c1 + 2; i + 3 < len; i++) {
+            if (!memcmp(line + i, ")->(", 4)) {
+                arrow = line + i;
+                break;
+            }
+        }
+        if (!arrow || arrow - (line + c1 + 1) > TM_MAX_TAPES) {
+            return ERROR;
+        }
+        *k = (int) (arrow - (line + c1 + 1));
+    }
+    size_t p = c1 + 1 + (size_t) *k;
+    if (p + 4 > len || memcmp(line + p, ")->(", 4) != 0) {
+        return ERROR;
+    }
+    size_t head = p + 4;
+    size_t c2 = head;
+    while (c2 < len && line[c2] != ',') {
+        c2++;
+    }
+    if (c2 == head || c2 - head > MAX_STATE_LEN || c2 + 2 * (size_t) *k + 3 > len
+        || line[c2 + 1 + *k] != ',' || line[c2 + 2 + 2 * *k] != ')') {
+        return ERROR;
+    }
+    for (int t = 0; t < *k; t++) {
+        char move = line[c2 + 2 + *k + t];
+        if (move != 'G' && move != 'D' && move != 'R') {
+            return ERROR;
+        }
+        r->read[t] = (unsigned char) line[c1 + 1 + t];
+        r->write[t] = line[c2 + 1 + t];
+        r->movement[t] = parse_move(move);
+    }
+    r->current = state_table_intern(st, line + 1, c1 - 1);
+    r->next = state_table_intern(st, line + head, c2 - head);
+    return HAS_ERROR(r->current) || HAS_ERROR(r->next) ? ERROR : 0;
+}
+
+/**
+ * Compile la description d'une machine à k rubans.
+ * @return la machine ou NULL si la description est invalide
+ */
+tm_mt_machine *tm_mt_machine_parse(const char *text, size_t len) {
+    state_table st = {0};
+    mt_raw *raw = NULL;
+    size_t nraw = 0, raw_cap = 0;
+    int header[3];
+    int nheader = 0;
+    int k = 0;
+    tm_mt_machine *m = NULL;
+    int ok = 0;
+
+    size_t pos = 0;
+    while (pos < len) {
+        const char *line = text + pos;
+        size_t line_len = 0;
+        while (pos + line_len < len && line[line_len] != '\n') {
+            line_len++;
+        }
+        pos += line_len + 1;
+        if (line_len > 0 && line[line_len - 1] == '\r') {
+            line_len--;
+        }
+        if (nheader < 3) {
+            if (line_len == 0 || line_len > MAX_STATE_LEN
+                || HAS_ERROR(header[nheader++] = state_table_intern(&st, line, line_len))) {
+                goto mt_cleanup;
+            }
+            continue;
+        }
+        if (line_len == 0) {
+            continue;
+        }
+        if (nraw == raw_cap) {
+            raw_cap = raw_cap ? raw_cap * 2 : 32;
+            mt_raw *grown = realloc(raw, sizeof(mt_raw) * raw_cap);
+            if (!grown) {
+                goto mt_cleanup;
+            }
+            raw = grown;
+        }
+        if (HAS_ERROR(parse_mt_line(&st, line, line_len, &k, &raw[nraw++]))) {
+            goto mt_cleanup;
+        }
+    }
+    if (nheader < 3 || k == 0) {
+        goto mt_cleanup;
+    }
+
+    m = calloc(1, sizeof(tm_mt_machine));
+    if (!m) {
+        goto mt_cleanup;
+    }
+    m->start = header[0];
+    m->accept = header[1];
+    m->reject = header[2];
+    m->ntapes = k;
+    // Le blanc a toujours une colonne : les rubans 1..k-1 en sont pleins
+    m->sym[(unsigned char) TM_BLANK] = 1;
+    m->nsyms = 2;
+    for (size_t i = 0; i < nraw; i++) {
+        for (int t = 0; t < k; t++) {
+            if (!m->sym[raw[i].read[t]]) {
+                m->sym[raw[i].read[t]] = (unsigned char) m->nsyms++;
+            }
+        }
+    }
+    m->row = 1;
+    for (int t = 0; t < k; t++) {
+        m->row *= (size_t) m->nsyms;
+    }
+    m->nstates = st.count;
+    if ((size_t) m->nstates * m->row > MAX_TABLE_ENTRIES
+        || !(m->table = malloc(sizeof(tm_mt_entry) * m->nstates * m->row))) {
+        goto mt_cleanup;
+    }
+    for (size_t i = 0; i < (size_t) m->nstates * m->row; i++) {
+        m->table[i].next = TM_NO_STATE;
+    }
+    for (size_t i = 0; i < nraw; i++) {
+        size_t key = 0;
+        for (int t = k - 1; t >= 0; t--) {
+            key = key * (size_t) m->nsyms + m->sym[raw[i].read[t]];
+        }
+        tm_mt_entry *e = &m->table[(size_t) raw[i].current * m->row + key];
+        if (e->next == TM_NO_STATE) {
+            e->next = raw[i].next;
+            memcpy(e->write, raw[i].write, TM_MAX_TAPES);
+            memcpy(e->movement, raw[i].movement, TM_MAX_TAPES);
+        }
+    }
+    m->names = st.names;
+    st.names = NULL;
+    ok = 1;
+
+    mt_cleanup:
+    state_table_free(&st);
+    free(raw);
+    if (!ok && m) {
+        free(m->table);
+        free(m);
+        m = NULL;
+    }
+    return m;
+}
+
+tm_mt_machine *tm_mt_machine_load(const char *machine_file) {
+    size_t len;
+    char *text = tm_read_file(machine_file, &len);
+    if (!text) {
+        return NULL;
+    }
+    tm_mt_machine *m = tm_mt_machine_parse(text, len);
+    free(text);
+    return m;
+}
+
+void tm_mt_machine_free(tm_mt_machine *m) {
+    if (!m) {
+        return;
+    }
+    for (int i = 0; i < m->nstates; i++) {
+        free(m->names[i]);
+    }
+    free(m->names);
+    free(m->table);
+    free(m);
+}
+
+/**
+ * Exécute une machine à k rubans. Les rubans sont rangés en structure de
+ * tableaux (cellules, capacité et tête par ruban) ; chacun est infini vers
+ * la droite. Le résultat décrit le ruban 0.
+ * @return le verdict ou un code d'erreur TM_*
+ */
+int tm_mt_run(const tm_mt_machine *m, const char *input, size_t len,
+              const tm_limits *limits, tm_result *result) {
+    const int k = m->ntapes;
+    char *cells[TM_MAX_TAPES] = {0};
+    size_t cap[TM_MAX_TAPES], head[TM_MAX_TAPES], reach[TM_MAX_TAPES];
+    uint64_t max_steps = limits ? limits->max_steps : 0;
+    size_t limit_cell = SIZE_MAX;
+    if (limits && limits->max_tape) {
+        limit_cell = limits->max_tape > len ? limits->max_tape : len + 1;
+    }
+    int verdict = 0;
+
+    for (int t = 0; t < k; t++) {
+        cap[t] = t == 0 && len >= 8 ? 2 * len : 16;
+        head[t] = reach[t] = 0;
+        if (!(cells[t] = malloc(cap[t]))) {
+            verdict = TM_NO_MEMORY;
+        } else {
+            memset(cells[t], TM_BLANK, cap[t]);
+        }
+    }
+    if (cells[0]) {
+        memcpy(cells[0], input, len);
+    }
+
+    const tm_mt_entry *table = m->table;
+    const unsigned char *sym = m->sym;
+    const size_t nsyms = (size_t) m->nsyms;
+    int state = m->start;
+    uint64_t steps = 0;
+
+    while (verdict == 0) {
+        if (state == m->accept) {
+            verdict = TM_ACCEPT;
+            break;
+        }
+        if (state == m->reject) {
+            break;
+        }
+        if (max_steps && steps == max_steps) {
+            verdict = TM_STEP_LIMIT;
+            break;
+        }
+        size_t key = 0;
+        for (int t = k - 1; t >= 0; t--) {
+            key = key * nsyms + sym[(unsigned char) cells[t][head[t]]];
+        }
+        const tm_mt_entry *e = &table[(size_t) state * m->row + key];
+        if (e->next == TM_NO_STATE) {
+            verdict = TM_NO_TRANSITION;
+            break;
+        }
+        state = e->next;
+        steps++;
+        for (int t = 0; t < k; t++) {
+            cells[t][head[t]] = e->write[t];
+            if (e->movement[t] < 0) {
+                if (head[t] > 0) {
+                    head[t]--;
+                }
+            } else if (e->movement[t] > 0 && ++head[t] > reach[t]) {
+                reach[t] = head[t];
+                if (reach[t] == limit_cell) {
+                    verdict = TM_TAPE_LIMIT;
+                    head[t]--;
+                } else if (head[t] == cap[t]) {
+                    char *grown = realloc(cells[t], cap[t] * 2);
+                    if (!grown) {
+                        verdict = TM_NO_MEMORY;
+                        head[t]--;
+                        continue;
+                    }
+                    memset(grown + cap[t], TM_BLANK, cap[t]);
+                    cells[t] = grown;
+                    cap[t] *= 2;
+                }
+            }
+        }
+    }
+
+    for (int t = 0; t < k; t++) {
+        free(cells[t]);
+    }
+    if (result) {
+        result->verdict = verdict;
+        result->steps = steps;
+        result->head = (int64_t) head[0];
+        result->tape_hwm = len > reach[0] + 1 ? len - 1 : reach[0];
+        result->tape_low = 0;
+    }
+    return verdict;
+}
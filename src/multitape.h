@@ -0,0 +1,54 @@
+//
+// Machines de Turing à plusieurs rubans.
+//
+// Le format étend celui de execute() : une transition lit un k-uplet de
+// symboles et écrit un k-uplet suivi de k mouvements, par exemple pour
+// deux rubans
+//
+//     (q0,1 )->(q1,1a,DR)
+//
+// k est donné par la première transition et toutes doivent l'avoir ; avec
+// k = 1, c'est exactement le format à un ruban. Le mot d'entrée est placé
+// sur le ruban 0, les autres rubans sont blancs.
+//
+#ifndef TP0_MULTITAPE_H
+#define TP0_MULTITAPE_H
+
+#include "machine.h"
+
+#define TM_MAX_TAPES 4
+
+typedef struct {
+    int32_t next;
+    char write[TM_MAX_TAPES];
+    signed char movement[TM_MAX_TAPES];
+} tm_mt_entry;
+
+/**
+ * Machine à k rubans compilée. La clé d'un k-uplet lu est
+ * sum(sym[lu_t] * nsyms^t) ; la transition (état, k-uplet) est
+ * table[état * row + clé] avec row = nsyms^k.
+ */
+typedef struct {
+    char **names;
+    int nstates;
+    int start;
+    int accept;
+    int reject;
+    int ntapes;
+    unsigned char sym[256];
+    int nsyms;
+    size_t row;
+    tm_mt_entry *table;
+} tm_mt_machine;
+
+tm_mt_machine *tm_mt_machine_load(const char *machine_file);
+
+tm_mt_machine *tm_mt_machine_parse(const char *text, size_t len);
+
+void tm_mt_machine_free(tm_mt_machine *m);
+
+int tm_mt_run(const tm_mt_machine *m, const char *input, size_t len,
+              const tm_limits *limits, tm_result *result);
+
+#endif //TP0_MULTITAPE_H
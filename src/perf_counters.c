@@ -0,0 +1,125 @@
+//
+// Compteurs de performance autour d'une mesure (voir perf_counters.h).
+//
+// Chaque compteur est un descripteur perf_event_open indépendant, limité au
+// mode utilisateur du processus courant. Quand le noyau multiplexe les
+// compteurs, la valeur lue est extrapolée au temps d'activation total.
+//
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "machine.h"
+#include "perf_counters.h"
+
+#define CACHE_MISS(cache) ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+                           | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+typedef struct {
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} counter_spec;
+
+static const counter_spec hardware_specs[] = {
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        {"l1d_misses", PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+        {"llc_misses", PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+};
+
+static const counter_spec software_specs[] = {
+        {"task_clock_ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+        {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+
+static int open_counter(const counter_spec *spec) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec->type;
+    attr.config = spec->config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Ouvre les compteurs d'une liste ; ceux que le processeur n'a pas sont
+ * ignorés.
+ * @return le nombre de compteurs ouverts
+ */
+static int open_specs(perf_counters *pc, const counter_spec *specs, int n) {
+    pc->count = 0;
+    for (int i = 0; i < n; i++) {
+        int fd = open_counter(&specs[i]);
+        if (fd < 0) {
+            if (!pc->open_errno) {
+                pc->open_errno = errno;
+            }
+            continue;
+        }
+        pc->fds[pc->count] = fd;
+        pc->names[pc->count] = specs[i].name;
+        pc->values[pc->count] = 0;
+        pc->count++;
+    }
+    return pc->count;
+}
+
+int perf_counters_open(perf_counters *pc) {
+    memset(pc, 0, sizeof(perf_counters));
+    // Les cycles sont indispensables pour interpréter le reste
+    if (open_specs(pc, hardware_specs, 1) > 0) {
+        perf_counters_close(pc);
+        pc->hardware = 1;
+        open_specs(pc, hardware_specs, sizeof(hardware_specs) / sizeof(hardware_specs[0]));
+        return 0;
+    }
+    pc->hardware = 0;
+    if (open_specs(pc, software_specs, sizeof(software_specs) / sizeof(software_specs[0])) == 0) {
+        return ERROR;
+    }
+    return 0;
+}
+
+void perf_counters_close(perf_counters *pc) {
+    for (int i = 0; i < pc->count; i++) {
+        close(pc->fds[i]);
+    }
+    pc->count = 0;
+}
+
+void perf_counters_start(perf_counters *pc) {
+    for (int i = 0; i < pc->count; i++) {
+        ioctl(pc->fds[i], PERF_EVENT_IOC_RESET, 0);
+    }
+    for (int i = 0; i < pc->count; i++) {
+        ioctl(pc->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+void perf_counters_stop(perf_counters *pc) {
+    for (int i = 0; i < pc->count; i++) {
+        ioctl(pc->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int i = 0; i < pc->count; i++) {
+        uint64_t buf[3] = {0};
+        if (read(pc->fds[i], buf, sizeof(buf)) != sizeof(buf)) {
+            pc->values[i] = 0;
+            continue;
+        }
+        // buf = {valeur, temps activé, temps compté}
+        if (buf[2] > 0 && buf[2] < buf[1]) {
+            buf[0] = (uint64_t) ((double) buf[0] * buf[1] / buf[2]);
+        }
+        pc->values[i] = buf[0];
+    }
+}
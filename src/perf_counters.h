@@ -0,0 +1,45 @@
+//
+// Compteurs de performance autour d'une mesure (perf_event_open).
+//
+// perf_counters_open essaie d'abord les compteurs matériels (cycles,
+// instructions, branch-misses, défauts L1d et LLC). S'ils sont
+// indisponibles, par exemple dans un conteneur, il se rabat sur des
+// compteurs logiciels (task-clock, page-faults, context-switches) et
+// perf_counters.hardware vaut 0.
+//
+#ifndef TP0_PERF_COUNTERS_H
+#define TP0_PERF_COUNTERS_H
+
+#include <stdint.h>
+
+#define PERF_MAX_COUNTERS 5
+
+typedef struct {
+    int hardware;
+    int count;
+    int fds[PERF_MAX_COUNTERS];
+    const char *names[PERF_MAX_COUNTERS];
+    uint64_t values[PERF_MAX_COUNTERS];
+    int open_errno;
+} perf_counters;
+
+/**
+ * Ouvre les compteurs pour le fil courant.
+ * @return 0 ou ERROR si aucun compteur n'a pu être ouvert
+ */
+int perf_counters_open(perf_counters *pc);
+
+void perf_counters_close(perf_counters *pc);
+
+/**
+ * Remet les compteurs à zéro et les démarre.
+ */
+void perf_counters_start(perf_counters *pc);
+
+/**
+ * Arrête les compteurs et range leurs valeurs dans pc->values, corrigées
+ * pour le multiplexage.
+ */
+void perf_counters_stop(perf_counters *pc);
+
+#endif //TP0_PERF_COUNTERS_H
@@ -0,0 +1,155 @@
+//
+// Enchaînement de machines sur un même ruban.
+//
+// Chaque étage reprend la configuration où l'étage précédent l'a laissée :
+// même ruban (ni copie ni réallocation entre deux étages), même compteur de
+// pas et, selon tm_stage.handoff, même position de tête. Seul l'état change,
+// remis à l'état initial de la machine de l'étage.
+//
+// Avec TM_PIPE_SHARED_SYMBOLS, les tables des étages sont recopiées sur une
+// seule table de symboles, l'union de ce que lisent les étages : sym[] est
+// alors le même pour toutes les machines et une case se lit de la même façon
+// d'un étage à l'autre.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "pipeline.h"
+
+struct tm_pipeline {
+    tm_stage *stages;
+    int n;
+    tm_machine *shared;
+};
+
+/**
+ * Recopie la table de m sur les colonnes de sym, où chaque colonne non
+ * nulle correspond à un seul octet (byte_of).
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int remap(tm_machine *to, const tm_machine *m, const unsigned char *sym,
+                 const unsigned char *byte_of, int nsyms) {
+    *to = *m;
+    memcpy(to->sym, sym, sizeof(to->sym));
+    to->nsyms = nsyms;
+    to->dfa = NULL;
+    to->table = malloc(sizeof(tm_entry) * (size_t) m->nstates * nsyms);
+    if (!to->table) {
+        return TM_NO_MEMORY;
+    }
+    for (int s = 0; s < m->nstates; s++) {
+        for (int col = 0; col < nsyms; col++) {
+            int from = col ? m->sym[byte_of[col]] : 0;
+            to->table[(size_t) s * nsyms + col] = m->table[(size_t) s * m->nsyms + from];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Prépare un enchaînement des n étages donnés. Les machines doivent avoir
+ * le même mode de ruban et rester valides tant que l'enchaînement sert.
+ * @param flags 0 ou TM_PIPE_SHARED_SYMBOLS
+ * @return l'enchaînement, ou NULL si les étages sont incompatibles ou si
+ * la mémoire manque
+ */
+tm_pipeline *tm_pipeline_create(const tm_stage *stages, int n, int flags) {
+    if (n < 1) {
+        return NULL;
+    }
+    for (int i = 1; i < n; i++) {
+        if (stages[i].m->tape_mode != stages[0].m->tape_mode) {
+            return NULL;
+        }
+    }
+    tm_pipeline *p = calloc(1, sizeof(tm_pipeline));
+    if (!p || !(p->stages = malloc(sizeof(tm_stage) * n))) {
+        goto create_error;
+    }
+    memcpy(p->stages, stages, sizeof(tm_stage) * n);
+    p->n = n;
+    if (!(flags & TM_PIPE_SHARED_SYMBOLS)) {
+        return p;
+    }
+
+    unsigned char sym[256] = {0};
+    unsigned char byte_of[256] = {0};
+    int nsyms = 1;
+    for (int b = 0; b < 256; b++) {
+        for (int i = 0; i < n; i++) {
+            if (stages[i].m->sym[b]) {
+                sym[b] = (unsigned char) nsyms;
+                byte_of[nsyms++] = (unsigned char) b;
+                break;
+            }
+        }
+    }
+    if (!(p->shared = calloc(n, sizeof(tm_machine)))) {
+        goto create_error;
+    }
+    for (int i = 0; i < n; i++) {
+        if (HAS_ERROR(remap(&p->shared[i], stages[i].m, sym, byte_of, nsyms))) {
+            goto create_error;
+        }
+        p->stages[i].m = &p->shared[i];
+    }
+    return p;
+
+    create_error:
+    tm_pipeline_free(p);
+    return NULL;
+}
+
+void tm_pipeline_free(tm_pipeline *p) {
+    if (!p) {
+        return;
+    }
+    if (p->shared) {
+        for (int i = 0; i < p->n; i++) {
+            free(p->shared[i].table);
+        }
+        free(p->shared);
+    }
+    free(p->stages);
+    free(p);
+}
+
+/**
+ * Exécute les étages l'un après l'autre sur la configuration c, préparée
+ * par tm_config_init() ou tm_context_begin() avec la machine du premier
+ * étage. Les limites portent sur tout l'enchaînement : les pas et le ruban
+ * s'additionnent d'un étage à l'autre. L'enchaînement s'arrête sur un
+ * code d'erreur, ou au premier étage dont la condition TM_PIPE_IF_* n'est
+ * pas remplie.
+ * @param results reçoit le résultat de chaque étage exécuté (pas de l'étage
+ * seul), ou NULL
+ * @param ran reçoit le nombre d'étages exécutés, ou NULL
+ * @return le verdict du dernier étage exécuté ou un code d'erreur TM_*
+ */
+int tm_pipeline_run(const tm_pipeline *p, tm_config *c, const tm_limits *limits,
+                    tm_result *results, int *ran) {
+    int verdict = TM_REJECT;
+    int i;
+    for (i = 0; i < p->n; i++) {
+        const tm_stage *stage = &p->stages[i];
+        int gate = stage->handoff & (TM_PIPE_IF_ACCEPT | TM_PIPE_IF_REJECT);
+        if (i > 0 && (HAS_ERROR(verdict)
+                      || (gate == TM_PIPE_IF_ACCEPT && verdict != TM_ACCEPT)
+                      || (gate == TM_PIPE_IF_REJECT && verdict != TM_REJECT))) {
+            break;
+        }
+        if (stage->handoff & TM_PIPE_RESET_HEAD) {
+            c->head = c->origin;
+        }
+        c->state = stage->m->start;
+        uint64_t before = c->steps;
+        verdict = tm_config_run(stage->m, c, limits, SIZE_MAX);
+        if (results) {
+            tm_config_result(c, verdict, &results[i]);
+            results[i].steps = c->steps - before;
+        }
+    }
+    if (ran) {
+        *ran = i;
+    }
+    return verdict;
+}
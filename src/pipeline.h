@@ -0,0 +1,36 @@
+//
+// Enchaînement de machines sur un même ruban.
+//
+#ifndef TP0_PIPELINE_H
+#define TP0_PIPELINE_H
+
+#include "machine.h"
+
+/* Drapeaux de passage (tm_stage.handoff) */
+#define TM_PIPE_RESET_HEAD 1  /* l'étage commence sur la case 0 */
+#define TM_PIPE_IF_ACCEPT 2   /* seulement si l'étage précédent a accepté */
+#define TM_PIPE_IF_REJECT 4   /* seulement s'il a rejeté */
+
+/* Drapeaux de tm_pipeline_create() */
+#define TM_PIPE_SHARED_SYMBOLS 1
+
+/**
+ * Un étage : une machine et la façon dont elle reprend le ruban de l'étage
+ * précédent. Sans TM_PIPE_RESET_HEAD, la tête reste où l'étage précédent
+ * s'est arrêté ; sans TM_PIPE_IF_*, l'étage suit un accept comme un reject.
+ */
+typedef struct {
+    const tm_machine *m;
+    int handoff;
+} tm_stage;
+
+typedef struct tm_pipeline tm_pipeline;
+
+tm_pipeline *tm_pipeline_create(const tm_stage *stages, int n, int flags);
+
+void tm_pipeline_free(tm_pipeline *p);
+
+int tm_pipeline_run(const tm_pipeline *p, tm_config *c, const tm_limits *limits,
+                    tm_result *results, int *ran);
+
+#endif //TP0_PIPELINE_H
@@ -0,0 +1,192 @@
+//
+// Exécution d'un lot de mots qui partagent des préfixes.
+//
+// Tant que la tête n'a pas atteint la case k, la configuration ne dépend que
+// des k premiers symboles du mot : les cases k et suivantes n'ont jamais été
+// lues. Quand la tête arrive pour la première fois sur la case k (avant de
+// la lire), on peut donc copier (état, pas, ruban[0..k-1]) et reprendre de là
+// pour tout autre mot qui a les mêmes k premiers symboles.
+//
+// Les mots sont triés ; une pile de clichés de profondeurs croissantes suit
+// le chemin courant dans le trie implicite des mots triés. Un cliché de
+// profondeur k n'est pris que si k <= |mot|, et n'est réutilisé que par un
+// mot qui partage k symboles avec celui qui l'a pris.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "prefix.h"
+
+typedef struct {
+    const char *word;
+    size_t len;
+    size_t index;
+} sorted_word;
+
+/**
+ * Cliché d'une configuration au moment où la tête atteint la case depth.
+ * Si halted est vrai, la machine s'est arrêtée sans lire au-delà de la case
+ * depth - 1 : le résultat vaut pour tout mot ayant le même préfixe.
+ */
+typedef struct {
+    size_t depth;
+    char *tape;
+    int state;
+    uint64_t steps;
+    int halted;
+    tm_result result;
+} snapshot;
+
+static int compare_words(const void *a, const void *b) {
+    const sorted_word *x = a, *y = b;
+    size_t n = x->len < y->len ? x->len : y->len;
+    int c = memcmp(x->word, y->word, n);
+    if (c != 0) {
+        return c;
+    }
+    return (x->len > y->len) - (x->len < y->len);
+}
+
+static size_t common_prefix(const sorted_word *x, const sorted_word *y) {
+    size_t n = x->len < y->len ? x->len : y->len;
+    size_t i = 0;
+    while (i < n && x->word[i] == y->word[i]) {
+        i++;
+    }
+    return i;
+}
+
+static int push_snapshot(snapshot *stack, size_t *top, const tm_config *c, size_t depth) {
+    snapshot *s = &stack[*top];
+    s->tape = malloc(depth);
+    if (!s->tape) {
+        return TM_NO_MEMORY;
+    }
+    memcpy(s->tape, c->tape, depth);
+    s->depth = depth;
+    s->state = c->state;
+    s->steps = c->steps;
+    s->halted = 0;
+    (*top)++;
+    return 0;
+}
+
+/**
+ * Exécute la machine sur n mots en partageant le travail fait sur les
+ * préfixes communs. Les résultats sont identiques à ceux de tm_run().
+ * Le partage ne s'applique qu'au ruban TM_TAPE_RIGHT.
+ * @param results reçoit le résultat du mot i en results[i]
+ * @param stats les compteurs de partage, ou NULL
+ * @return 0 ou TM_NO_MEMORY
+ */
+int tm_run_shared(const tm_machine *m, const char *const *words, const size_t *lens, size_t n,
+                  const tm_limits *limits, tm_result *results, tm_share_stats *stats) {
+    if (m->tape_mode != TM_TAPE_RIGHT) {
+        // Les clichés ne gardent que la partie droite du ruban
+        for (size_t i = 0; i < n; i++) {
+            tm_run(m, words[i], lens[i], limits, &results[i]);
+        }
+        return 0;
+    }
+    size_t max_len = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (lens[i] > max_len) {
+            max_len = lens[i];
+        }
+    }
+    // Profondeurs strictement croissantes : au plus max_len + 1 clichés
+    tm_context *ctx = tm_context_acquire();
+    snapshot *stack = ctx ? tm_context_scratch(ctx, sizeof(snapshot) * (max_len + 1)
+                                                    + sizeof(sorted_word) * n) : NULL;
+    if (!stack) {
+        tm_context_release(ctx);
+        return TM_NO_MEMORY;
+    }
+    sorted_word *sorted = (sorted_word *) (stack + max_len + 1);
+    for (size_t i = 0; i < n; i++) {
+        sorted[i].word = words[i];
+        sorted[i].len = lens[i];
+        sorted[i].index = i;
+    }
+    qsort(sorted, n, sizeof(sorted_word), compare_words);
+
+    size_t top = 0;
+    int err = 0;
+    size_t shared = 0;
+
+    for (size_t i = 0; i < n && HAS_NO_ERROR(err); i++) {
+        const sorted_word *w = &sorted[i];
+        size_t next_shared = i + 1 < n ? common_prefix(w, &sorted[i + 1]) : 0;
+        tm_result *r = &results[w->index];
+
+        while (top > 0 && stack[top - 1].depth > shared) {
+            free(stack[--top].tape);
+        }
+        shared = next_shared;
+        snapshot *base = top > 0 ? &stack[top - 1] : NULL;
+
+        if (base && base->halted) {
+            *r = base->result;
+            r->tape_hwm = w->len > base->depth ? w->len - 1 : base->depth - 1;
+            if (stats) {
+                stats->reused++;
+                stats->steps_saved += r->steps;
+            }
+            continue;
+        }
+
+        tm_config c;
+        if (HAS_ERROR(tm_context_begin(ctx, &c, m, w->word, w->len))) {
+            err = TM_NO_MEMORY;
+            break;
+        }
+        size_t depth = 0;
+        if (base) {
+            memcpy(c.tape, base->tape, base->depth);
+            c.state = base->state;
+            c.steps = base->steps;
+            c.head = c.reach = depth = base->depth;
+            if (stats) {
+                stats->resumed++;
+                stats->steps_saved += base->steps;
+            }
+        }
+
+        // Clichés aux puissances de deux puis au préfixe partagé avec le
+        // mot suivant, seules profondeurs utiles aux mots qui restent
+        int verdict = TM_RUNNING;
+        size_t target = 1;
+        while (verdict == TM_RUNNING && HAS_NO_ERROR(err) && depth < next_shared) {
+            while (target <= depth) {
+                target *= 2;
+            }
+            size_t stop = target < next_shared ? target : next_shared;
+            verdict = tm_config_run(m, &c, limits, stop);
+            if (verdict == TM_RUNNING) {
+                err = push_snapshot(stack, &top, &c, stop);
+                depth = stop;
+            }
+        }
+        if (verdict == TM_RUNNING) {
+            verdict = tm_config_run(m, &c, limits, SIZE_MAX);
+        }
+        tm_config_result(&c, verdict, r);
+
+        // Arrêt sans avoir lu au-delà du mot : résultat réutilisable tel quel.
+        // La limite de ruban dépend de la longueur du mot, on l'exclut.
+        if (HAS_NO_ERROR(err) && verdict != TM_TAPE_LIMIT && verdict != TM_NO_MEMORY
+            && c.reach < w->len && c.reach + 1 <= next_shared) {
+            snapshot *s = &stack[top++];
+            s->depth = c.reach + 1;
+            s->tape = NULL;
+            s->halted = 1;
+            s->result = *r;
+        }
+        tm_context_end(ctx, &c);
+    }
+
+    while (top > 0) {
+        free(stack[--top].tape);
+    }
+    tm_context_release(ctx);
+    return err;
+}
@@ -0,0 +1,21 @@
+//
+// Exécution d'un lot de mots qui partagent des préfixes.
+//
+#ifndef TP0_PREFIX_H
+#define TP0_PREFIX_H
+
+#include "machine.h"
+
+/**
+ * Compteurs d'une exécution partagée.
+ */
+typedef struct {
+    uint64_t resumed;
+    uint64_t reused;
+    uint64_t steps_saved;
+} tm_share_stats;
+
+int tm_run_shared(const tm_machine *m, const char *const *words, const size_t *lens, size_t n,
+                  const tm_limits *limits, tm_result *results, tm_share_stats *stats);
+
+#endif //TP0_PREFIX_H
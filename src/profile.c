@@ -0,0 +1,400 @@
+//
+// Profil d'exécution et renumérotation des états (voir profile.h).
+//
+// Un profil compte les passages par chaque case de la table pendant des
+// exécutions représentatives. Il est enregistré par noms d'états, avec
+// l'empreinte de la machine :
+//
+//     # tm_profile
+//     hash	<empreinte en hexadécimal>
+//     <état>	<état suivant>	<passages>
+//
+// Au chargement suivant, tm_machine_relayout() renumérote les états pour
+// que les paires (état, suivant) les plus fréquentes aient des lignes de
+// table voisines, donc souvent dans la même ligne de cache : les arcs sont
+// pris du plus fréquent au moins fréquent et chacun soude la chaîne qui
+// finit par son état à celle qui commence par son suivant (placement de
+// Pettis et Hansen). Les chaînes sont rangées de la plus chaude à la plus
+// froide et les états jamais vus gardent leur ordre, à la fin.
+//
+// L'empreinte ne dépend pas des numéros d'états : une machine renumérotée
+// garde son empreinte, ses résultats en cache et son profil. Ce qui est
+// indexé par numéro d'état ne la suit pas : la renumérotation donne à la
+// machine un nouveau layout, et les mémos de frontière liés à l'ancien
+// (voir frontier.h) sont oubliés au prochain tm_frontier_bind().
+//
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dfa.h"
+#include "profile.h"
+#include "state_table.h"
+
+struct tm_profile {
+    uint64_t hash;
+    size_t nentries;
+    uint64_t *hits;
+    const tm_machine *m;
+};
+
+typedef struct {
+    int from;
+    int to;
+    uint64_t count;
+} profile_edge;
+
+/**
+ * Crée un profil vide pour la machine m.
+ * @return le profil ou NULL si l'allocation a échoué
+ */
+tm_profile *tm_profile_create(const tm_machine *m) {
+    tm_profile *p = malloc(sizeof(tm_profile));
+    if (!p) {
+        return NULL;
+    }
+    p->hash = m->hash;
+    p->nentries = (size_t) m->nstates * m->nsyms;
+    p->hits = calloc(p->nentries, sizeof(uint64_t));
+    p->m = m;
+    if (!p->hits) {
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+void tm_profile_free(tm_profile *p) {
+    if (!p) {
+        return;
+    }
+    free(p->hits);
+    free(p);
+}
+
+/**
+ * Comme tm_run(), en comptant chaque transition dans le profil. Ni
+ * l'automate ni le mémo de frontière ne servent : chaque pas est exécuté.
+ */
+int tm_profile_run(tm_profile *p, const tm_machine *m, const char *input, size_t len,
+                   const tm_limits *limits, tm_result *result) {
+    tm_config c;
+    if (HAS_ERROR(tm_config_init(&c, m, input, len))) {
+        if (result) {
+            memset(result, 0, sizeof(tm_result));
+            result->verdict = TM_NO_MEMORY;
+        }
+        return TM_NO_MEMORY;
+    }
+    c.profile = p->hits;
+    int verdict = tm_config_run(m, &c, limits, SIZE_MAX);
+    if (result) {
+        tm_config_result(&c, verdict, result);
+    }
+    tm_config_release(&c);
+    return verdict;
+}
+
+/**
+ * Ajoute les compteurs de src à ceux de dst (même machine).
+ */
+void tm_profile_merge(tm_profile *dst, const tm_profile *src) {
+    for (size_t i = 0; i < dst->nentries && i < src->nentries; i++) {
+        dst->hits[i] += src->hits[i];
+    }
+}
+
+/**
+ * Écrit le profil : une ligne par paire (état, suivant) vue au moins une
+ * fois, les colonnes qui mènent au même suivant étant additionnées.
+ * @return 0 ou ERROR
+ */
+int tm_profile_save(const tm_profile *p, const char *path) {
+    const tm_machine *m = p->m;
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        return ERROR;
+    }
+    fprintf(fp, "# tm_profile\nhash\t%016" PRIx64 "\n", p->hash);
+    for (int s = 0; s < m->nstates; s++) {
+        const tm_entry *row = &m->table[(size_t) s * m->nsyms];
+        const uint64_t *hits = &p->hits[(size_t) s * m->nsyms];
+        for (int c = 0; c < m->nsyms; c++) {
+            if (!hits[c]) {
+                continue;
+            }
+            uint64_t count = hits[c];
+            int first = 1;
+            for (int k = 0; k < m->nsyms; k++) {
+                if (k != c && hits[k] && row[k].next == row[c].next) {
+                    if (k < c) {
+                        first = 0;
+                        break;
+                    }
+                    count += hits[k];
+                }
+            }
+            if (first) {
+                fprintf(fp, "%s\t%s\t%" PRIu64 "\n", m->names[s], m->names[row[c].next], count);
+            }
+        }
+    }
+    int status = ferror(fp) ? ERROR : 0;
+    if (fclose(fp) != 0) {
+        status = ERROR;
+    }
+    return status;
+}
+
+/**
+ * Lit les arcs d'un profil de la machine m.
+ * @param st les noms des états de m, dans l'ordre de leurs identifiants
+ * @return le nombre d'arcs, ou ERROR (fichier illisible, profil d'une autre
+ * machine, ligne invalide)
+ */
+static long read_edges(const tm_machine *m, state_table *st, const char *path, profile_edge **edges) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ERROR;
+    }
+    long nedges = 0, cap = 0;
+    int has_hash = 0;
+    char line[128];
+    *edges = NULL;
+    while (fgets(line, sizeof(line), fp)) {
+        size_t len = strcspn(line, "\r\n");
+        line[len] = '\0';
+        if (len == 0 || line[0] == '#') {
+            continue;
+        }
+        uint64_t hash;
+        if (!has_hash) {
+            if (sscanf(line, "hash\t%" SCNx64, &hash) != 1 || hash != m->hash) {
+                goto read_error;
+            }
+            has_hash = 1;
+            continue;
+        }
+        char *from = line;
+        char *to = strchr(from, '\t');
+        char *count = to ? strchr(to + 1, '\t') : NULL;
+        if (!count) {
+            goto read_error;
+        }
+        *to++ = '\0';
+        *count++ = '\0';
+        size_t from_len = strlen(from), to_len = strlen(to);
+        if (from_len == 0 || from_len > MAX_STATE_LEN || to_len == 0 || to_len > MAX_STATE_LEN) {
+            goto read_error;
+        }
+        int a = state_table_intern(st, from, from_len);
+        int b = state_table_intern(st, to, to_len);
+        if (HAS_ERROR(a) || HAS_ERROR(b) || a >= m->nstates || b >= m->nstates) {
+            goto read_error;
+        }
+        if (nedges == cap) {
+            cap = cap ? cap * 2 : 256;
+            profile_edge *grown = realloc(*edges, sizeof(profile_edge) * cap);
+            if (!grown) {
+                goto read_error;
+            }
+            *edges = grown;
+        }
+        (*edges)[nedges].from = a;
+        (*edges)[nedges].to = b;
+        (*edges)[nedges++].count = strtoull(count, NULL, 10);
+    }
+    if (!has_hash) {
+        goto read_error;
+    }
+    fclose(fp);
+    return nedges;
+
+    read_error:
+    fclose(fp);
+    free(*edges);
+    *edges = NULL;
+    return ERROR;
+}
+
+static int edge_order(const void *a, const void *b) {
+    const profile_edge *x = a, *y = b;
+    if (x->count != y->count) {
+        return x->count > y->count ? -1 : 1;
+    }
+    if (x->from != y->from) {
+        return x->from < y->from ? -1 : 1;
+    }
+    return x->to < y->to ? -1 : (x->to > y->to);
+}
+
+static int chain_root(int *parent, int s) {
+    while (parent[s] != s) {
+        parent[s] = parent[parent[s]];
+        s = parent[s];
+    }
+    return s;
+}
+
+/**
+ * Une chaîne d'états, par sa tête, et sa chaleur : la somme des passages
+ * par ses états.
+ */
+typedef struct {
+    uint64_t weight;
+    int head;
+} profile_chain;
+
+static int chain_order(const void *a, const void *b) {
+    const profile_chain *x = a, *y = b;
+    if (x->weight != y->weight) {
+        return x->weight > y->weight ? -1 : 1;
+    }
+    return x->head < y->head ? -1 : (x->head > y->head);
+}
+
+/**
+ * Calcule le nouvel ordre des états.
+ * @param order reçoit, pour chaque nouveau numéro, l'ancien numéro
+ * @return 0 ou ERROR
+ */
+static int layout_order(int nstates, profile_edge *edges, long nedges, int *order) {
+    int *next = malloc(sizeof(int) * nstates);
+    int *prev = malloc(sizeof(int) * nstates);
+    int *parent = malloc(sizeof(int) * nstates);
+    profile_chain *chains = malloc(sizeof(profile_chain) * nstates);
+    uint64_t *heat = calloc((size_t) nstates, sizeof(uint64_t));
+    uint64_t *weight = calloc((size_t) nstates, sizeof(uint64_t));
+    int status = ERROR;
+    if (!next || !prev || !parent || !chains || !heat || !weight) {
+        goto layout_cleanup;
+    }
+    for (int s = 0; s < nstates; s++) {
+        next[s] = prev[s] = -1;
+        parent[s] = s;
+    }
+    for (long i = 0; i < nedges; i++) {
+        heat[edges[i].from] += edges[i].count;
+    }
+    qsort(edges, (size_t) nedges, sizeof(profile_edge), edge_order);
+    for (long i = 0; i < nedges; i++) {
+        int a = edges[i].from, b = edges[i].to;
+        if (a == b || next[a] != -1 || prev[b] != -1) {
+            continue;
+        }
+        int ra = chain_root(parent, a), rb = chain_root(parent, b);
+        if (ra == rb) {
+            continue;
+        }
+        next[a] = b;
+        prev[b] = a;
+        parent[rb] = ra;
+    }
+    for (int s = 0; s < nstates; s++) {
+        weight[chain_root(parent, s)] += heat[s];
+    }
+    int nchains = 0;
+    for (int s = 0; s < nstates; s++) {
+        if (prev[s] == -1) {
+            chains[nchains].weight = weight[chain_root(parent, s)];
+            chains[nchains++].head = s;
+        }
+    }
+    qsort(chains, (size_t) nchains, sizeof(profile_chain), chain_order);
+    int n = 0;
+    for (int i = 0; i < nchains; i++) {
+        for (int s = chains[i].head; s != -1; s = next[s]) {
+            order[n++] = s;
+        }
+    }
+    status = n == nstates ? 0 : ERROR;
+
+    layout_cleanup:
+    free(next);
+    free(prev);
+    free(parent);
+    free(chains);
+    free(heat);
+    free(weight);
+    return status;
+}
+
+/**
+ * Renumérote les états de m : le nouvel état i est l'ancien order[i].
+ * @return 0 ou TM_NO_MEMORY (m est alors inchangée)
+ */
+static int renumber(tm_machine *m, const int *order) {
+    size_t row = (size_t) m->nsyms;
+    int *inverse = malloc(sizeof(int) * m->nstates);
+    char **names = malloc(sizeof(char *) * m->nstates);
+    tm_entry *table = malloc(sizeof(tm_entry) * m->nstates * row);
+    if (!inverse || !names || !table) {
+        free(inverse);
+        free(names);
+        free(table);
+        return TM_NO_MEMORY;
+    }
+    for (int i = 0; i < m->nstates; i++) {
+        inverse[order[i]] = i;
+    }
+    for (int i = 0; i < m->nstates; i++) {
+        names[i] = m->names[order[i]];
+        memcpy(&table[i * row], &m->table[(size_t) order[i] * row], sizeof(tm_entry) * row);
+        for (size_t c = 0; c < row; c++) {
+            tm_entry *e = &table[i * row + c];
+            if (e->next != TM_NO_STATE) {
+                e->next = inverse[e->next];
+            }
+        }
+    }
+    free(m->names);
+    free(m->table);
+    m->names = names;
+    m->table = table;
+    m->start = inverse[m->start];
+    m->accept = inverse[m->accept];
+    m->reject = inverse[m->reject];
+    tm_dfa_free(m->dfa);
+    m->dfa = tm_dfa_compile(m);
+    m->layout = tm_machine_new_layout();
+    free(inverse);
+    return 0;
+}
+
+/**
+ * Renumérote les états d'une machine chargée d'après un profil écrit par
+ * tm_profile_save(). Les verdicts, les pas et l'empreinte sont inchangés ;
+ * les mémos liés à m avant l'appel ne lui servent plus.
+ * Ne s'applique pas à une machine de tm_machine_from_static().
+ * @param profile_file le fichier du profil
+ * @return 0, ERROR si le profil est illisible ou d'une autre machine, ou
+ * TM_NO_MEMORY
+ */
+int tm_machine_relayout(tm_machine *m, const char *profile_file) {
+    state_table st = {0};
+    profile_edge *edges = NULL;
+    int *order = malloc(sizeof(int) * m->nstates);
+    int status = TM_NO_MEMORY;
+    if (!order) {
+        return TM_NO_MEMORY;
+    }
+    for (int s = 0; s < m->nstates; s++) {
+        if (HAS_ERROR(state_table_intern(&st, m->names[s], strlen(m->names[s])))) {
+            goto relayout_cleanup;
+        }
+    }
+    long nedges = read_edges(m, &st, profile_file, &edges);
+    if (HAS_ERROR(nedges)) {
+        status = ERROR;
+        goto relayout_cleanup;
+    }
+    if (HAS_NO_ERROR(layout_order(m->nstates, edges, nedges, order))) {
+        status = renumber(m, order);
+    }
+
+    relayout_cleanup:
+    state_table_free(&st);
+    free(edges);
+    free(order);
+    return status;
+}
@@ -0,0 +1,25 @@
+//
+// Profil d'exécution d'une machine et renumérotation de ses états d'après
+// ce profil.
+//
+#ifndef TP0_PROFILE_H
+#define TP0_PROFILE_H
+
+#include "machine.h"
+
+typedef struct tm_profile tm_profile;
+
+tm_profile *tm_profile_create(const tm_machine *m);
+
+void tm_profile_free(tm_profile *p);
+
+int tm_profile_run(tm_profile *p, const tm_machine *m, const char *input, size_t len,
+                   const tm_limits *limits, tm_result *result);
+
+void tm_profile_merge(tm_profile *dst, const tm_profile *src);
+
+int tm_profile_save(const tm_profile *p, const char *path);
+
+int tm_machine_relayout(tm_machine *m, const char *profile_file);
+
+#endif //TP0_PROFILE_H
@@ -0,0 +1,480 @@
+//
+// Enregistrement d'une exécution pour la rejouer dans les deux sens.
+//
+// Le ruban est découpé en pages de PAGE cases partagées par compteur de
+// références : un cliché copie seulement le répertoire des pages, et la
+// première écriture dans une page partagée la recopie (copie sur écriture).
+// Un cliché est pris tous les interval pas ; chaque pas ajoute au journal
+// d'annulation la case écrite, l'ancien symbole et l'ancien état.
+//
+// Reculer d'un pas applique une entrée du journal. Aller au pas t repart du
+// cliché le plus proche avant t, ou de la position courante si elle est plus
+// près, et rejoue au plus interval pas.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "replay.h"
+
+#define PAGE_SHIFT 10
+#define PAGE (1 << PAGE_SHIFT)
+
+/* Drapeaux d'une entrée du journal */
+#define UNDO_REACH 1
+#define UNDO_LOW 2
+
+typedef struct {
+    int refs;
+    char cells[PAGE];
+} replay_page;
+
+/**
+ * Répertoire des pages ; pages[i] couvre les cases de (first + i) * PAGE à
+ * (first + i + 1) * PAGE - 1. Une page absente est blanche.
+ */
+typedef struct {
+    replay_page **pages;
+    size_t npages;
+    int64_t first;
+} page_dir;
+
+typedef struct {
+    page_dir dir;
+    int state;
+    int64_t head;
+    int64_t reach;
+    int64_t low;
+    uint64_t steps;
+} replay_config;
+
+/**
+ * Annule un pas : remet symbol dans cell, puis la tête sur cell et la
+ * machine dans l'état state.
+ */
+typedef struct {
+    int64_t cell;
+    int32_t state;
+    char symbol;
+    unsigned char flags;
+} replay_undo;
+
+struct tm_replay {
+    const tm_machine *m;
+    int two_way;
+    int verdict;
+    uint64_t interval;
+    replay_config cur;
+    replay_undo *log;
+    uint64_t log_count;
+    uint64_t log_cap;
+    replay_config *snaps;
+    size_t snap_count;
+    size_t snap_cap;
+    size_t live_pages;
+};
+
+static int64_t page_of(int64_t cell) {
+    return cell >= 0 ? cell >> PAGE_SHIFT : -((-cell + PAGE - 1) >> PAGE_SHIFT);
+}
+
+static void page_release(tm_replay *r, replay_page *p) {
+    if (p && --p->refs == 0) {
+        free(p);
+        r->live_pages--;
+    }
+}
+
+static void dir_release(tm_replay *r, page_dir *d) {
+    for (size_t i = 0; i < d->npages; i++) {
+        page_release(r, d->pages[i]);
+    }
+    free(d->pages);
+    memset(d, 0, sizeof(page_dir));
+}
+
+/**
+ * Copie un répertoire en partageant ses pages.
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int dir_share(page_dir *to, const page_dir *from) {
+    to->pages = malloc(sizeof(replay_page *) * (from->npages ? from->npages : 1));
+    if (!to->pages) {
+        return TM_NO_MEMORY;
+    }
+    if (from->npages) {
+        memcpy(to->pages, from->pages, sizeof(replay_page *) * from->npages);
+    }
+    to->npages = from->npages;
+    to->first = from->first;
+    for (size_t i = 0; i < to->npages; i++) {
+        if (to->pages[i]) {
+            to->pages[i]->refs++;
+        }
+    }
+    return 0;
+}
+
+static char tape_get(const page_dir *d, int64_t cell) {
+    int64_t p = page_of(cell) - d->first;
+    if (p < 0 || (uint64_t) p >= d->npages || !d->pages[p]) {
+        return TM_BLANK;
+    }
+    return d->pages[p]->cells[cell - page_of(cell) * PAGE];
+}
+
+/**
+ * Étend le répertoire pour qu'il couvre la page p.
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int dir_cover(page_dir *d, int64_t p) {
+    if (d->npages == 0) {
+        d->first = p;
+    }
+    int64_t low = p < d->first ? p : d->first;
+    int64_t high = p >= d->first + (int64_t) d->npages ? p + 1 : d->first + (int64_t) d->npages;
+    if (low == d->first && (size_t) (high - low) == d->npages) {
+        return 0;
+    }
+    // Le double de la taille, pour un coût amorti constant
+    size_t n = (size_t) (high - low);
+    if (n < 2 * d->npages) {
+        n = 2 * d->npages;
+        if (p < d->first) {
+            low = high - (int64_t) n;
+        } else {
+            high = low + (int64_t) n;
+        }
+    }
+    replay_page **pages = calloc(n, sizeof(replay_page *));
+    if (!pages) {
+        return TM_NO_MEMORY;
+    }
+    if (d->npages) {
+        memcpy(pages + (d->first - low), d->pages, sizeof(replay_page *) * d->npages);
+    }
+    free(d->pages);
+    d->pages = pages;
+    d->npages = n;
+    d->first = low;
+    return 0;
+}
+
+/**
+ * Écrit symbol dans cell, en recopiant la page si un cliché la partage.
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int tape_set(tm_replay *r, page_dir *d, int64_t cell, char symbol) {
+    int64_t p = page_of(cell);
+    if (HAS_ERROR(dir_cover(d, p))) {
+        return TM_NO_MEMORY;
+    }
+    replay_page **slot = &d->pages[p - d->first];
+    if (!*slot || (*slot)->refs > 1) {
+        replay_page *page = malloc(sizeof(replay_page));
+        if (!page) {
+            return TM_NO_MEMORY;
+        }
+        if (*slot) {
+            memcpy(page->cells, (*slot)->cells, PAGE);
+            (*slot)->refs--;
+        } else {
+            memset(page->cells, TM_BLANK, PAGE);
+        }
+        page->refs = 1;
+        r->live_pages++;
+        *slot = page;
+    }
+    (*slot)->cells[cell - p * PAGE] = symbol;
+    return 0;
+}
+
+static int take_snapshot(tm_replay *r) {
+    if (r->snap_count == r->snap_cap) {
+        size_t cap = r->snap_cap ? 2 * r->snap_cap : 16;
+        replay_config *grown = realloc(r->snaps, sizeof(replay_config) * cap);
+        if (!grown) {
+            return TM_NO_MEMORY;
+        }
+        r->snaps = grown;
+        r->snap_cap = cap;
+    }
+    replay_config *s = &r->snaps[r->snap_count];
+    *s = r->cur;
+    if (HAS_ERROR(dir_share(&s->dir, &r->cur.dir))) {
+        return TM_NO_MEMORY;
+    }
+    r->snap_count++;
+    return 0;
+}
+
+/**
+ * Applique le pas numéro cur.steps, déjà enregistré. Le journal dit si un
+ * déplacement à gauche a étendu le ruban ; sinon la tête est restée en
+ * place (bord gauche, ou limite de ruban atteinte).
+ */
+static int replay_step(tm_replay *r) {
+    const tm_machine *m = r->m;
+    replay_config *c = &r->cur;
+    unsigned char read = (unsigned char) tape_get(&c->dir, c->head);
+    const tm_entry *e = &m->table[(size_t) c->state * m->nsyms + m->sym[read]];
+    if (HAS_ERROR(tape_set(r, &c->dir, c->head, e->write))) {
+        return TM_NO_MEMORY;
+    }
+    c->state = e->next;
+    if (e->movement < 0) {
+        if (c->head > c->low) {
+            c->head--;
+        } else if (r->log[c->steps].flags & UNDO_LOW) {
+            c->low = --c->head;
+        }
+    } else if (e->movement > 0 && ++c->head > c->reach) {
+        c->reach = c->head;
+    }
+    c->steps++;
+    return 0;
+}
+
+/**
+ * Exécute la machine comme tm_run() en gardant un cliché tous les interval
+ * pas et le journal d'annulation de chaque pas. L'enregistrement est
+ * ensuite positionné sur le dernier pas.
+ * @param interval le nombre de pas entre deux clichés, 0 pour
+ * TM_REPLAY_INTERVAL
+ * @return l'enregistrement ou NULL si la mémoire manque
+ */
+tm_replay *tm_replay_record(const tm_machine *m, const char *input, size_t len,
+                            const tm_limits *limits, uint64_t interval) {
+    tm_replay *r = calloc(1, sizeof(tm_replay));
+    if (!r) {
+        return NULL;
+    }
+    r->m = m;
+    r->two_way = m->tape_mode == TM_TAPE_TWO_WAY;
+    r->interval = interval ? interval : TM_REPLAY_INTERVAL;
+    r->cur.state = m->start;
+    for (size_t i = 0; i < len; i++) {
+        if (input[i] != TM_BLANK && HAS_ERROR(tape_set(r, &r->cur.dir, (int64_t) i, input[i]))) {
+            goto record_error;
+        }
+    }
+
+    // Mêmes règles que run_loop() dans machine.c
+    uint64_t max_steps = limits ? limits->max_steps : 0;
+    int64_t limit_cell = INT64_MAX;
+    if (limits && limits->max_tape) {
+        limit_cell = (int64_t) (limits->max_tape > len ? limits->max_tape : len + 1);
+    }
+    replay_config *c = &r->cur;
+    for (;;) {
+        if (c->steps % r->interval == 0 && c->steps / r->interval == r->snap_count
+            && HAS_ERROR(take_snapshot(r))) {
+            goto record_error;
+        }
+        if (c->state == m->accept) {
+            r->verdict = TM_ACCEPT;
+            break;
+        }
+        if (c->state == m->reject) {
+            r->verdict = TM_REJECT;
+            break;
+        }
+        if (max_steps && c->steps == max_steps) {
+            r->verdict = TM_STEP_LIMIT;
+            break;
+        }
+        char read = tape_get(&c->dir, c->head);
+        const tm_entry *e = &m->table[(size_t) c->state * m->nsyms + m->sym[(unsigned char) read]];
+        if (e->next == TM_NO_STATE) {
+            r->verdict = TM_NO_TRANSITION;
+            break;
+        }
+        if (r->log_count == r->log_cap) {
+            uint64_t cap = r->log_cap ? 2 * r->log_cap : 1024;
+            replay_undo *grown = realloc(r->log, sizeof(replay_undo) * cap);
+            if (!grown) {
+                goto record_error;
+            }
+            r->log = grown;
+            r->log_cap = cap;
+        }
+        replay_undo *u = &r->log[r->log_count++];
+        u->cell = c->head;
+        u->state = c->state;
+        u->symbol = read;
+        u->flags = 0;
+        if (HAS_ERROR(tape_set(r, &c->dir, c->head, e->write))) {
+            goto record_error;
+        }
+        c->state = e->next;
+        c->steps++;
+        int verdict = TM_RUNNING;
+        if (e->movement < 0) {
+            if (c->head > c->low) {
+                c->head--;
+            } else if (r->two_way) {
+                if (c->reach - c->low + 1 == limit_cell) {
+                    verdict = TM_TAPE_LIMIT;
+                } else {
+                    c->low = --c->head;
+                    u->flags |= UNDO_LOW;
+                }
+            }
+        } else if (e->movement > 0 && ++c->head > c->reach) {
+            c->reach = c->head;
+            u->flags |= UNDO_REACH;
+            if (c->reach - c->low == limit_cell) {
+                verdict = TM_TAPE_LIMIT;
+            }
+        }
+        if (verdict != TM_RUNNING) {
+            r->verdict = verdict;
+            break;
+        }
+    }
+    return r;
+
+    record_error:
+    tm_replay_free(r);
+    return NULL;
+}
+
+void tm_replay_free(tm_replay *r) {
+    if (!r) {
+        return;
+    }
+    for (size_t i = 0; i < r->snap_count; i++) {
+        dir_release(r, &r->snaps[i].dir);
+    }
+    dir_release(r, &r->cur.dir);
+    free(r->snaps);
+    free(r->log);
+    free(r);
+}
+
+/**
+ * @return le verdict de l'exécution enregistrée
+ */
+int tm_replay_verdict(const tm_replay *r) {
+    return r->verdict;
+}
+
+/**
+ * @return le nombre de pas de l'exécution enregistrée
+ */
+uint64_t tm_replay_steps(const tm_replay *r) {
+    return r->log_count;
+}
+
+/**
+ * Recule d'un pas.
+ * @return 0, ERROR au pas 0 ou TM_NO_MEMORY
+ */
+int tm_replay_back(tm_replay *r) {
+    replay_config *c = &r->cur;
+    if (c->steps == 0) {
+        return ERROR;
+    }
+    const replay_undo *u = &r->log[c->steps - 1];
+    if (HAS_ERROR(tape_set(r, &c->dir, u->cell, u->symbol))) {
+        return TM_NO_MEMORY;
+    }
+    if (u->flags & UNDO_REACH) {
+        c->reach--;
+    }
+    if (u->flags & UNDO_LOW) {
+        c->low++;
+    }
+    c->head = u->cell;
+    c->state = u->state;
+    c->steps--;
+    return 0;
+}
+
+/**
+ * Avance d'un pas.
+ * @return 0, ERROR au dernier pas ou TM_NO_MEMORY
+ */
+int tm_replay_forward(tm_replay *r) {
+    if (r->cur.steps == r->log_count) {
+        return ERROR;
+    }
+    return replay_step(r);
+}
+
+/**
+ * Va au pas step en rejouant au plus interval pas, à partir d'un
+ * cliché ou de la position courante.
+ * @return 0, ERROR si step dépasse le dernier pas ou TM_NO_MEMORY
+ */
+int tm_replay_seek(tm_replay *r, uint64_t step) {
+    if (step > r->log_count) {
+        return ERROR;
+    }
+    // Une exécution arrêtée par la limite de ruban n'a pas de cliché après
+    // son dernier pas
+    size_t snap = step / r->interval < r->snap_count ? step / r->interval : r->snap_count - 1;
+    uint64_t now = r->cur.steps;
+    uint64_t from_snap = step - r->snaps[snap].steps;
+    if (step <= now && now - step <= from_snap) {
+        while (r->cur.steps > step) {
+            if (HAS_ERROR(tm_replay_back(r))) {
+                return TM_NO_MEMORY;
+            }
+        }
+        return 0;
+    }
+    if (step < now || step - now > from_snap) {
+        const replay_config *s = &r->snaps[snap];
+        page_dir dir;
+        if (HAS_ERROR(dir_share(&dir, &s->dir))) {
+            return TM_NO_MEMORY;
+        }
+        dir_release(r, &r->cur.dir);
+        r->cur = *s;
+        r->cur.dir = dir;
+    }
+    while (r->cur.steps < step) {
+        if (HAS_ERROR(replay_step(r))) {
+            return TM_NO_MEMORY;
+        }
+    }
+    return 0;
+}
+
+void tm_replay_where(const tm_replay *r, tm_replay_position *pos) {
+    pos->step = r->cur.steps;
+    pos->state = r->cur.state;
+    pos->head = r->cur.head;
+    pos->low = r->cur.low;
+    pos->reach = r->cur.reach;
+}
+
+/**
+ * Copie les n cases du ruban courant à partir de cell dans out.
+ */
+void tm_replay_read(const tm_replay *r, int64_t cell, size_t n, char *out) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = tape_get(&r->cur.dir, cell + (int64_t) i);
+    }
+}
+
+/**
+ * Mesure ce que l'enregistrement coûte en plus du ruban courant : le
+ * journal, les répertoires des clichés et les pages qui ne sont plus
+ * tenues que par des clichés.
+ */
+void tm_replay_get_stats(const tm_replay *r, tm_replay_stats *stats) {
+    size_t current = 0;
+    for (size_t i = 0; i < r->cur.dir.npages; i++) {
+        current += r->cur.dir.pages[i] != NULL;
+    }
+    size_t dirs = 0;
+    for (size_t i = 0; i < r->snap_count; i++) {
+        dirs += sizeof(replay_config) + sizeof(replay_page *) * r->snaps[i].dir.npages;
+    }
+    stats->steps = r->log_count;
+    stats->snapshots = r->snap_count;
+    stats->log_bytes = sizeof(replay_undo) * r->log_count;
+    stats->snapshot_bytes = dirs + sizeof(replay_page) * (r->live_pages - current);
+    stats->bytes_per_step = r->log_count
+                            ? (double) (stats->log_bytes + stats->snapshot_bytes) / r->log_count : 0.0;
+}
@@ -0,0 +1,58 @@
+//
+// Enregistrement d'une exécution pour la rejouer dans les deux sens.
+//
+#ifndef TP0_REPLAY_H
+#define TP0_REPLAY_H
+
+#include "machine.h"
+
+/* Pas entre deux clichés, par défaut */
+#define TM_REPLAY_INTERVAL 4096
+
+typedef struct tm_replay tm_replay;
+
+/**
+ * Configuration courante d'un enregistrement. Les cases sont comptées à
+ * partir de la case 0 du ruban (négatives à gauche sur un ruban bi-infini).
+ */
+typedef struct {
+    uint64_t step;
+    int state;
+    int64_t head;
+    int64_t low;
+    int64_t reach;
+} tm_replay_position;
+
+/**
+ * Mémoire prise par l'enregistrement, en plus du ruban de l'exécution.
+ */
+typedef struct {
+    uint64_t steps;
+    size_t snapshots;
+    size_t log_bytes;       /* journal d'annulation */
+    size_t snapshot_bytes;  /* clichés : répertoires et pages qu'ils sont seuls à tenir */
+    double bytes_per_step;
+} tm_replay_stats;
+
+tm_replay *tm_replay_record(const tm_machine *m, const char *input, size_t len,
+                            const tm_limits *limits, uint64_t interval);
+
+void tm_replay_free(tm_replay *r);
+
+int tm_replay_verdict(const tm_replay *r);
+
+uint64_t tm_replay_steps(const tm_replay *r);
+
+int tm_replay_seek(tm_replay *r, uint64_t step);
+
+int tm_replay_back(tm_replay *r);
+
+int tm_replay_forward(tm_replay *r);
+
+void tm_replay_where(const tm_replay *r, tm_replay_position *pos);
+
+void tm_replay_read(const tm_replay *r, int64_t cell, size_t n, char *out);
+
+void tm_replay_get_stats(const tm_replay *r, tm_replay_stats *stats);
+
+#endif //TP0_REPLAY_H
@@ -0,0 +1,400 @@
+//
+// Ruban compressé par plages (voir rle_tape.h).
+//
+// La tête ne se déplace que d'une case à la fois : le ruban est gardé comme
+// une fermeture éclair, la plage courante avec la position de la tête dans
+// cette plage, et deux piles, les plages à gauche et les plages à droite,
+// chacune avec la plus proche au sommet. Passer d'une plage à la voisine,
+// couper une plage en trois sur une écriture ou fusionner deux plages
+// voisines de même symbole coûte O(1), et la mémoire suit le nombre de
+// plages. Au-delà des piles, le ruban est blanc : à droite, et à gauche sur
+// un ruban bi-infini.
+//
+// Une transition qui boucle sur son état en réécrivant le symbole lu et en
+// se déplaçant traverse une plage d'un seul coup, dans la limite des
+// cases déjà atteintes et des limites de l'exécution.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "rle_tape.h"
+
+/**
+ * Une plage : longueur dans les bits hauts, symbole dans l'octet bas.
+ */
+typedef uint64_t rle_run;
+
+#define RUN(symbol, length) (((uint64_t) (length) << 8) | (unsigned char) (symbol))
+#define RUN_SYMBOL(run) ((char) ((run) & 0xff))
+#define RUN_LENGTH(run) ((run) >> 8)
+
+/* Longueur du blanc au-delà des piles : jamais parcourue en entier */
+#define RUN_ENDLESS ((uint64_t) 1 << 54)
+
+#define MIN_STACK 16
+
+typedef struct {
+    rle_run *runs;
+    size_t n;
+    size_t cap;
+} run_stack;
+
+struct tm_rle_tape {
+    run_stack left;
+    run_stack right;
+    char symbol;        /* plage courante */
+    uint64_t length;
+    uint64_t offset;    /* position de la tête dans la plage */
+    int two_way;
+    size_t len;
+    int state;
+    int64_t head;
+    int64_t reach;
+    int64_t low;
+    uint64_t steps;
+    size_t peak_runs;
+    uint64_t swept_steps;
+};
+
+static int push(run_stack *s, char symbol, uint64_t length) {
+    if (s->n == s->cap) {
+        size_t cap = s->cap ? 2 * s->cap : MIN_STACK;
+        rle_run *grown = realloc(s->runs, sizeof(rle_run) * cap);
+        if (!grown) {
+            return TM_NO_MEMORY;
+        }
+        s->runs = grown;
+        s->cap = cap;
+    }
+    s->runs[s->n++] = RUN(symbol, length);
+    return 0;
+}
+
+static void note_runs(tm_rle_tape *t) {
+    size_t runs = t->left.n + t->right.n + 1;
+    if (runs > t->peak_runs) {
+        t->peak_runs = runs;
+    }
+}
+
+/**
+ * Prépare le ruban du mot input pour la machine m : la tête sur la case 0,
+ * la machine dans son état initial.
+ * @return le ruban, ou NULL si la mémoire manque
+ */
+tm_rle_tape *tm_rle_create(const tm_machine *m, const char *input, size_t len) {
+    tm_rle_tape *t = calloc(1, sizeof(tm_rle_tape));
+    if (!t) {
+        return NULL;
+    }
+    t->two_way = m->tape_mode == TM_TAPE_TWO_WAY;
+    t->len = len;
+    t->state = m->start;
+    t->symbol = TM_BLANK;
+    t->length = RUN_ENDLESS;
+    if (len > 0) {
+        size_t runs = 1;
+        for (size_t i = 1; i < len; i++) {
+            runs += input[i] != input[i - 1];
+        }
+        if (!(t->right.runs = malloc(sizeof(rle_run) * runs))) {
+            free(t);
+            return NULL;
+        }
+        t->right.cap = runs;
+        // Les plages du mot, la dernière au fond de la pile
+        size_t end = len;
+        while (end > 0) {
+            size_t start = end - 1;
+            while (start > 0 && input[start - 1] == input[end - 1]) {
+                start--;
+            }
+            t->right.runs[t->right.n++] = RUN(input[start], end - start);
+            end = start;
+        }
+        rle_run first = t->right.runs[--t->right.n];
+        t->symbol = RUN_SYMBOL(first);
+        t->length = RUN_LENGTH(first);
+    }
+    note_runs(t);
+    return t;
+}
+
+void tm_rle_free(tm_rle_tape *t) {
+    if (!t) {
+        return;
+    }
+    free(t->left.runs);
+    free(t->right.runs);
+    free(t);
+}
+
+/**
+ * Écrit symbol sous la tête, différent du symbole de la plage courante :
+ * la plage est coupée autour de la tête, et la case écrite fusionnée avec
+ * les plages voisines de même symbole.
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int write_cell(tm_rle_tape *t, char symbol) {
+    uint64_t before = t->offset;
+    uint64_t after = t->length - t->offset - 1;
+    uint64_t length = 1, offset = 0;
+    if (before) {
+        if (HAS_ERROR(push(&t->left, t->symbol, before))) {
+            return TM_NO_MEMORY;
+        }
+    } else if (t->left.n && RUN_SYMBOL(t->left.runs[t->left.n - 1]) == symbol) {
+        offset = RUN_LENGTH(t->left.runs[--t->left.n]);
+        length += offset;
+    } else if (!t->left.n && t->two_way && symbol == TM_BLANK) {
+        offset = RUN_ENDLESS;
+        length += offset;
+    }
+    if (after) {
+        if (HAS_ERROR(push(&t->right, t->symbol, after))) {
+            return TM_NO_MEMORY;
+        }
+    } else if (t->right.n && RUN_SYMBOL(t->right.runs[t->right.n - 1]) == symbol) {
+        length += RUN_LENGTH(t->right.runs[--t->right.n]);
+    } else if (!t->right.n && symbol == TM_BLANK) {
+        length += RUN_ENDLESS;
+    }
+    t->symbol = symbol;
+    t->length = length;
+    t->offset = offset;
+    note_runs(t);
+    return 0;
+}
+
+/**
+ * Passe à la case de droite.
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int move_right(tm_rle_tape *t) {
+    if (t->offset + 1 < t->length) {
+        t->offset++;
+        return 0;
+    }
+    if (HAS_ERROR(push(&t->left, t->symbol, t->length))) {
+        return TM_NO_MEMORY;
+    }
+    if (t->right.n) {
+        rle_run next = t->right.runs[--t->right.n];
+        t->symbol = RUN_SYMBOL(next);
+        t->length = RUN_LENGTH(next);
+    } else {
+        t->symbol = TM_BLANK;
+        t->length = RUN_ENDLESS;
+    }
+    t->offset = 0;
+    note_runs(t);
+    return 0;
+}
+
+/**
+ * Passe à la case de gauche ; l'appelant garantit qu'elle existe.
+ * @return 0 ou TM_NO_MEMORY
+ */
+static int move_left(tm_rle_tape *t) {
+    if (t->offset > 0) {
+        t->offset--;
+        return 0;
+    }
+    if (HAS_ERROR(push(&t->right, t->symbol, t->length))) {
+        return TM_NO_MEMORY;
+    }
+    if (t->left.n) {
+        rle_run next = t->left.runs[--t->left.n];
+        t->symbol = RUN_SYMBOL(next);
+        t->length = RUN_LENGTH(next);
+    } else {
+        t->symbol = TM_BLANK;
+        t->length = RUN_ENDLESS;
+    }
+    t->offset = t->length - 1;
+    note_runs(t);
+    return 0;
+}
+
+/**
+ * Fait avancer la machine sur le ruban jusqu'à l'arrêt, avec les mêmes
+ * résultats que tm_run() : mêmes verdicts, mêmes pas, mêmes limites.
+ * @return le verdict ou un code d'erreur TM_*
+ */
+int tm_rle_run(const tm_machine *m, tm_rle_tape *t, const tm_limits *limits, tm_result *result) {
+    uint64_t max_steps = limits ? limits->max_steps : 0;
+    // Même règle que run_loop() : le ruban peut toujours contenir le mot et
+    // la case qui le suit
+    int64_t limit_cell = INT64_MAX;
+    if (limits && limits->max_tape) {
+        limit_cell = (int64_t) (limits->max_tape > t->len ? limits->max_tape : t->len + 1);
+    }
+    const tm_entry *table = m->table;
+    const unsigned char *sym = m->sym;
+    const int nsyms = m->nsyms;
+    int state = t->state;
+    int64_t head = t->head, reach = t->reach, low = t->low;
+    uint64_t steps = t->steps;
+    int verdict;
+
+    for (;;) {
+        if (state == m->accept) {
+            verdict = TM_ACCEPT;
+            break;
+        }
+        if (state == m->reject) {
+            verdict = TM_REJECT;
+            break;
+        }
+        if (max_steps && steps == max_steps) {
+            verdict = TM_STEP_LIMIT;
+            break;
+        }
+        const tm_entry *e = &table[(size_t) state * nsyms + sym[(unsigned char) t->symbol]];
+        if (e->next == TM_NO_STATE) {
+            verdict = TM_NO_TRANSITION;
+            break;
+        }
+        if (e->next == state && e->write == t->symbol && e->movement != 0) {
+            // Traversée de la plage : k pas identiques, sans atteindre la
+            // case où une limite de ruban se déclencherait
+            uint64_t k;
+            int64_t room;
+            if (e->movement > 0) {
+                k = t->length - t->offset - 1;
+                room = low + limit_cell - 1 - head;
+            } else {
+                k = t->offset;
+                room = t->two_way ? head - (reach + 1 - limit_cell) : INT64_MAX;
+            }
+            if (room < 0) {
+                room = 0;
+            }
+            if (k > (uint64_t) room) {
+                k = (uint64_t) room;
+            }
+            if (max_steps && k > max_steps - steps) {
+                k = max_steps - steps;
+            }
+            if (k > 0) {
+                if (e->movement > 0) {
+                    t->offset += k;
+                    head += (int64_t) k;
+                    reach = head > reach ? head : reach;
+                } else {
+                    t->offset -= k;
+                    head -= (int64_t) k;
+                    low = head < low ? head : low;
+                }
+                steps += k;
+                t->swept_steps += k;
+                continue;
+            }
+        }
+        if (e->write != t->symbol && HAS_ERROR(write_cell(t, e->write))) {
+            verdict = TM_NO_MEMORY;
+            break;
+        }
+        state = e->next;
+        steps++;
+        if (e->movement < 0) {
+            if (head > low) {
+                head--;
+            } else if (t->two_way) {
+                if (reach - low + 1 == limit_cell) {
+                    verdict = TM_TAPE_LIMIT;
+                    break;
+                }
+                low = --head;
+            } else {
+                continue;
+            }
+            if (HAS_ERROR(move_left(t))) {
+                verdict = TM_NO_MEMORY;
+                break;
+            }
+        } else if (e->movement > 0) {
+            if (HAS_ERROR(move_right(t))) {
+                verdict = TM_NO_MEMORY;
+                break;
+            }
+            if (++head > reach) {
+                reach = head;
+                if (reach - low == limit_cell) {
+                    verdict = TM_TAPE_LIMIT;
+                    break;
+                }
+            }
+        }
+    }
+
+    t->state = state;
+    t->head = head;
+    t->reach = reach;
+    t->low = low;
+    t->steps = steps;
+    if (result) {
+        result->verdict = verdict;
+        result->steps = steps;
+        result->head = head;
+        result->tape_hwm = t->len > (size_t) reach + 1 ? t->len - 1 : (size_t) reach;
+        result->tape_low = (size_t) -low;
+    }
+    return verdict;
+}
+
+static void fill(char *out, int64_t cell, int64_t to, int64_t start, int64_t end, char symbol) {
+    int64_t from = start > cell ? start : cell;
+    int64_t until = end < to ? end : to;
+    if (from < until) {
+        memset(out + (from - cell), symbol, (size_t) (until - from));
+    }
+}
+
+/**
+ * Copie n cases du ruban à partir de la case cell (négative sur un ruban
+ * bi-infini) ; les cases hors des plages sont blanches.
+ * @return n
+ */
+size_t tm_rle_read(const tm_rle_tape *t, int64_t cell, size_t n, char *out) {
+    memset(out, TM_BLANK, n);
+    int64_t to = cell + (int64_t) n;
+    int64_t first = t->head - (int64_t) t->offset;
+    int64_t last = first + (int64_t) t->length;
+    fill(out, cell, to, first, last, t->symbol);
+    for (size_t i = t->left.n; i-- > 0;) {
+        int64_t start = first - (int64_t) RUN_LENGTH(t->left.runs[i]);
+        fill(out, cell, to, start, first, RUN_SYMBOL(t->left.runs[i]));
+        first = start;
+    }
+    for (size_t i = t->right.n; i-- > 0;) {
+        int64_t end = last + (int64_t) RUN_LENGTH(t->right.runs[i]);
+        fill(out, cell, to, last, end, RUN_SYMBOL(t->right.runs[i]));
+        last = end;
+    }
+    return n;
+}
+
+void tm_rle_get_stats(const tm_rle_tape *t, tm_rle_stats *stats) {
+    stats->runs = t->left.n + t->right.n + 1;
+    stats->peak_runs = t->peak_runs;
+    stats->bytes = sizeof(tm_rle_tape) + sizeof(rle_run) * (t->left.cap + t->right.cap);
+    stats->swept_steps = t->swept_steps;
+}
+
+/**
+ * Comme tm_run(), sur un ruban par plages.
+ */
+int tm_run_rle(const tm_machine *m, const char *input, size_t len,
+               const tm_limits *limits, tm_result *result) {
+    tm_rle_tape *t = tm_rle_create(m, input, len);
+    if (!t) {
+        if (result) {
+            memset(result, 0, sizeof(tm_result));
+            result->verdict = TM_NO_MEMORY;
+        }
+        return TM_NO_MEMORY;
+    }
+    int verdict = tm_rle_run(m, t, limits, result);
+    tm_rle_free(t);
+    return verdict;
+}
@@ -0,0 +1,36 @@
+//
+// Ruban compressé par plages : une suite de (symbole, longueur) au lieu
+// d'un octet par case.
+//
+#ifndef TP0_RLE_TAPE_H
+#define TP0_RLE_TAPE_H
+
+#include "machine.h"
+
+typedef struct tm_rle_tape tm_rle_tape;
+
+/**
+ * Compteurs d'un ruban par plages. bytes est la mémoire des plages,
+ * à comparer au cap d'un tm_config.
+ */
+typedef struct {
+    size_t runs;
+    size_t peak_runs;
+    size_t bytes;
+    uint64_t swept_steps;   /* pas franchis d'un coup dans une plage */
+} tm_rle_stats;
+
+tm_rle_tape *tm_rle_create(const tm_machine *m, const char *input, size_t len);
+
+void tm_rle_free(tm_rle_tape *t);
+
+int tm_rle_run(const tm_machine *m, tm_rle_tape *t, const tm_limits *limits, tm_result *result);
+
+size_t tm_rle_read(const tm_rle_tape *t, int64_t cell, size_t n, char *out);
+
+void tm_rle_get_stats(const tm_rle_tape *t, tm_rle_stats *stats);
+
+int tm_run_rle(const tm_machine *m, const char *input, size_t len,
+               const tm_limits *limits, tm_result *result);
+
+#endif //TP0_RLE_TAPE_H
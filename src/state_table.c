@@ -0,0 +1,100 @@
+//
+// Internement des noms d'états (voir state_table.h).
+//
+// Adressage ouvert avec sondage linéaire, sur un hachage FNV-1a du nom
+// tronqué à MAX_STATE_LEN caractères ; la table double dès qu'elle est à
+// moitié pleine. Les identifiants suivent l'ordre de première apparition.
+//
+#include <stdlib.h>
+#include <string.h>
+#include "state_table.h"
+
+uint32_t state_name_hash(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int state_table_grow(state_table *st) {
+    size_t cap = st->cap ? st->cap * 2 : 64;
+    int *slots = malloc(sizeof(int) * cap);
+    if (!slots) {
+        return ERROR;
+    }
+    for (size_t i = 0; i < cap; i++) {
+        slots[i] = TM_NO_STATE;
+    }
+    for (int id = 0; id < st->count; id++) {
+        size_t j = state_name_hash(st->names[id]) & (cap - 1);
+        while (slots[j] != TM_NO_STATE) {
+            j = (j + 1) & (cap - 1);
+        }
+        slots[j] = id;
+    }
+    free(st->slots);
+    st->slots = slots;
+    st->cap = cap;
+    return 0;
+}
+
+/**
+ * Retourne l'identifiant de l'état name, en l'ajoutant au besoin.
+ * Le nom est copié ; len est sa longueur.
+ * @return l'identifiant ou ERROR si une allocation a échoué
+ */
+int state_table_intern(state_table *st, const char *name, size_t len) {
+    char key[MAX_STATE_LEN + 1];
+    if (len > MAX_STATE_LEN) {
+        len = MAX_STATE_LEN;
+    }
+    memcpy(key, name, len);
+    key[len] = '\0';
+
+    if ((size_t) (st->count + 1) * 2 > st->cap && HAS_ERROR(state_table_grow(st))) {
+        return ERROR;
+    }
+    size_t j = state_name_hash(key) & (st->cap - 1);
+    while (st->slots[j] != TM_NO_STATE) {
+        if (!strcmp(st->names[st->slots[j]], key)) {
+            return st->slots[j];
+        }
+        j = (j + 1) & (st->cap - 1);
+    }
+
+    if (st->count == st->names_cap) {
+        int cap = st->names_cap ? st->names_cap * 2 : 16;
+        char **names = realloc(st->names, sizeof(char *) * cap);
+        if (!names) {
+            return ERROR;
+        }
+        st->names = names;
+        st->names_cap = cap;
+    }
+    char *copy = malloc(len + 1);
+    if (!copy) {
+        return ERROR;
+    }
+    memcpy(copy, key, len + 1);
+    st->names[st->count] = copy;
+    st->slots[j] = st->count;
+    return st->count++;
+}
+
+/**
+ * Libère la table ; les noms dont la propriété a été transférée (names mis
+ * à NULL) ne sont pas touchés.
+ */
+void state_table_free(state_table *st) {
+    if (st->names) {
+        for (int i = 0; i < st->count; i++) {
+            free(st->names[i]);
+        }
+        free(st->names);
+    }
+    free(st->slots);
+    st->names = NULL;
+    st->slots = NULL;
+}
@@ -0,0 +1,33 @@
+//
+// Internement des noms d'états pendant le chargement d'une machine.
+//
+#ifndef TP0_STATE_TABLE_H
+#define TP0_STATE_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "machine.h"
+
+#define MAX_STATE_LEN 5
+
+/**
+ * Table de hachage (adressage ouvert) qui interne les noms d'états pendant
+ * le chargement. names[id] est le nom de l'état id.
+ */
+typedef struct {
+    int *slots;
+    size_t cap;
+    char **names;
+    int count;
+    int names_cap;
+} state_table;
+
+uint32_t state_name_hash(const char *s);
+
+int state_table_intern(state_table *st, const char *name, size_t len);
+
+void state_table_free(state_table *st);
+
+int valid_transition_line(const char *line, size_t len);
+
+#endif //TP0_STATE_TABLE_H
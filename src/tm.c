@@ -0,0 +1,569 @@
+//
+// tm : exécute une machine sur un lot de mots.
+//
+// Usage : tm [-f tsv|bin] [-p] [-L] [-R] [-z] [-j workers] [-b lot] [-m max_pas] [-T max_ruban]
+//            [-C capacité] [-P fichier_cache] [-g profil] [-G profil] [-v] [-2]
+//            machine_file [fichier_mots]
+//
+// Les mots sont lus un par ligne (stdin par défaut). Pour chaque mot, une
+// ligne « verdict<TAB>pas<TAB>hwm » est écrite sur stdout, dans l'ordre des
+// entrées ; avec -f bin, un enregistrement tm_record par mot.
+//
+// Lecture, exécution et écriture sont trois étages qui s'échangent des lots
+// de mots par des files bornées : la lecture se fait par gros blocs et
+// l'écriture par un tampon, en parallèle avec l'exécution.
+//
+// Avec -p, les mots d'un même lot qui partagent un préfixe reprennent
+// l'exécution là où le préfixe cesse d'être commun (voir prefix.c) ; des
+// lots plus gros (-b) donnent plus de partage.
+//
+// Avec -L, les mots courts d'un lot avancent ensemble dans des voies SIMD
+// (voir lanes.c) ; utile pour de gros lots de mots de quelques symboles.
+//
+// Avec -R, chaque mot s'exécute sur un ruban par plages (voir rle_tape.c),
+// plus petit et plus rapide quand la machine écrit de longues plages d'un
+// même symbole.
+//
+// Avec -z, la machine est chargée paresseusement (voir lazy_load.c) : seuls
+// les états visités sont compilés, et l'index des lignes est gardé dans
+// machine_file.idx pour les appels suivants. Les mots s'exécutent alors sur
+// un seul fil ; -z ne se combine ni avec -p, -L, -R, -C, -P ni avec -2.
+//
+// -g écrit dans un fichier le profil des exécutions (voir profile.c) :
+// combien de fois chaque état passe à chacun de ses suivants. -G relit un
+// tel profil au chargement et renumérote les états pour que les paires
+// fréquentes aient des lignes de table voisines. -g exécute chaque pas
+// (ni -p, -L, -R, -C, -P) ; -G ne change pas les résultats.
+//
+// -C et -P activent le cache de résultats (cache.h) en mémoire et dans un
+// fichier ; -v affiche ses compteurs sur stderr à la fin.
+//
+// -2 exécute la machine sur un ruban infini des deux côtés.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cache.h"
+#include "lanes.h"
+#include "lazy_load.h"
+#include "machine.h"
+#include "prefix.h"
+#include "profile.h"
+#include "rle_tape.h"
+
+#define READ_CHUNK (1u << 20)
+#define QUEUE_DEPTH 4
+
+/**
+ * Enregistrement du format binaire (-f bin).
+ */
+typedef struct {
+    uint64_t index;
+    int32_t verdict;
+    uint32_t reserved;
+    uint64_t steps;
+    uint64_t tape_hwm;
+} tm_record;
+
+typedef struct {
+    uint64_t seq;
+    uint64_t first_index;
+    char *data;
+    size_t data_len;
+    size_t data_cap;
+    size_t *offsets;
+    size_t *lengths;
+    size_t count;
+    size_t cap;
+    tm_result *results;
+} batch;
+
+/**
+ * File bornée de lots entre deux étages.
+ */
+typedef struct {
+    batch **items;
+    size_t cap;
+    size_t head;
+    size_t count;
+    int closed;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} batch_queue;
+
+static const tm_machine *machine;
+static tm_limits limits;
+static size_t batch_size = 4096;
+static int binary_output = 0;
+static int share_prefixes = 0;
+static int use_lanes = 0;
+static int use_rle = 0;
+static tm_cache *results_cache;
+static tm_lazy_machine *lazy_machine;
+static tm_profile *run_profile;
+static pthread_mutex_t profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static batch_queue to_run, to_write;
+
+static void queue_init(batch_queue *q, size_t cap) {
+    q->items = malloc(sizeof(batch *) * cap);
+    q->cap = cap;
+    q->head = 0;
+    q->count = 0;
+    q->closed = 0;
+    pthread_mutex_init(&q->lock, NULL);
+    pthread_cond_init(&q->not_empty, NULL);
+    pthread_cond_init(&q->not_full, NULL);
+}
+
+static void queue_push(batch_queue *q, batch *b) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == q->cap) {
+        pthread_cond_wait(&q->not_full, &q->lock);
+    }
+    q->items[(q->head + q->count++) % q->cap] = b;
+    pthread_cond_signal(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+/**
+ * @return le prochain lot, ou NULL si la file est fermée et vide
+ */
+static batch *queue_pop(batch_queue *q) {
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) {
+        pthread_cond_wait(&q->not_empty, &q->lock);
+    }
+    batch *b = NULL;
+    if (q->count > 0) {
+        b = q->items[q->head];
+        q->head = (q->head + 1) % q->cap;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return b;
+}
+
+static void queue_close(batch_queue *q) {
+    pthread_mutex_lock(&q->lock);
+    q->closed = 1;
+    pthread_cond_broadcast(&q->not_empty);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static batch *batch_new(uint64_t seq, uint64_t first_index) {
+    batch *b = calloc(1, sizeof(batch));
+    if (!b) {
+        return NULL;
+    }
+    b->seq = seq;
+    b->first_index = first_index;
+    b->cap = batch_size;
+    b->data_cap = batch_size * 16;
+    b->data = malloc(b->data_cap);
+    b->offsets = malloc(sizeof(size_t) * b->cap);
+    b->lengths = malloc(sizeof(size_t) * b->cap);
+    b->results = malloc(sizeof(tm_result) * b->cap);
+    if (!b->data || !b->offsets || !b->lengths || !b->results) {
+        free(b->data);
+        free(b->offsets);
+        free(b->lengths);
+        free(b->results);
+        free(b);
+        return NULL;
+    }
+    return b;
+}
+
+static void batch_free(batch *b) {
+    free(b->data);
+    free(b->offsets);
+    free(b->lengths);
+    free(b->results);
+    free(b);
+}
+
+static int batch_add(batch *b, const char *word, size_t len) {
+    if (len > 0 && word[len - 1] == '\r') {
+        len--;
+    }
+    if (b->data_len + len > b->data_cap) {
+        size_t cap = b->data_cap * 2;
+        while (b->data_len + len > cap) {
+            cap *= 2;
+        }
+        char *grown = realloc(b->data, cap);
+        if (!grown) {
+            return ERROR;
+        }
+        b->data = grown;
+        b->data_cap = cap;
+    }
+    memcpy(b->data + b->data_len, word, len);
+    b->offsets[b->count] = b->data_len;
+    b->lengths[b->count++] = len;
+    b->data_len += len;
+    return 0;
+}
+
+/**
+ * Étage de lecture : découpe l'entrée en lignes et remplit des lots.
+ */
+static void *reader_main(void *arg) {
+    FILE *in = arg;
+    char *chunk = malloc(READ_CHUNK);
+    char *carry = NULL;
+    size_t carry_len = 0, carry_cap = 0;
+    uint64_t seq = 0, index = 0;
+    batch *b = chunk ? batch_new(seq, index) : NULL;
+    int failed = !b;
+
+    size_t n;
+    while (!failed && (n = fread(chunk, 1, READ_CHUNK, in)) > 0) {
+        size_t start = 0;
+        for (;;) {
+            char *nl = memchr(chunk + start, '\n', n - start);
+            if (!nl) {
+                break;
+            }
+            size_t len = (size_t) (nl - (chunk + start));
+            int err;
+            if (carry_len > 0) {
+                if (carry_len + len > carry_cap) {
+                    carry_cap = (carry_len + len) * 2;
+                    char *grown = realloc(carry, carry_cap);
+                    if (!grown) {
+                        failed = 1;
+                        break;
+                    }
+                    carry = grown;
+                }
+                memcpy(carry + carry_len, chunk + start, len);
+                err = batch_add(b, carry, carry_len + len);
+                carry_len = 0;
+            } else {
+                err = batch_add(b, chunk + start, len);
+            }
+            start += len + 1;
+            index++;
+            if (HAS_ERROR(err)) {
+                failed = 1;
+                break;
+            }
+            if (b->count == b->cap) {
+                queue_push(&to_run, b);
+                if (!(b = batch_new(++seq, index))) {
+                    failed = 1;
+                    break;
+                }
+            }
+        }
+        if (failed) {
+            break;
+        }
+        // Ligne incomplète : on la garde pour le prochain bloc
+        size_t rest = n - start;
+        if (carry_len + rest > carry_cap) {
+            carry_cap = (carry_len + rest) * 2;
+            char *grown = realloc(carry, carry_cap);
+            if (!grown) {
+                failed = 1;
+                break;
+            }
+            carry = grown;
+        }
+        memcpy(carry + carry_len, chunk + start, rest);
+        carry_len += rest;
+    }
+    if (!failed && carry_len > 0 && HAS_ERROR(batch_add(b, carry, carry_len))) {
+        failed = 1;
+    }
+    if (b && b->count > 0) {
+        queue_push(&to_run, b);
+    } else if (b) {
+        batch_free(b);
+    }
+    if (failed) {
+        fprintf(stderr, "tm: out of memory while reading inputs\n");
+    }
+    free(chunk);
+    free(carry);
+    queue_close(&to_run);
+    return NULL;
+}
+
+static void run_batch(batch *b, const char **words, tm_profile *profile) {
+    if (profile) {
+        for (size_t i = 0; i < b->count; i++) {
+            tm_profile_run(profile, machine, b->data + b->offsets[i], b->lengths[i], &limits, &b->results[i]);
+        }
+        return;
+    }
+    if (lazy_machine) {
+        for (size_t i = 0; i < b->count; i++) {
+            tm_lazy_run(lazy_machine, b->data + b->offsets[i], b->lengths[i], &limits, &b->results[i]);
+        }
+        return;
+    }
+    if (share_prefixes && !results_cache) {
+        for (size_t i = 0; i < b->count; i++) {
+            words[i] = b->data + b->offsets[i];
+        }
+        if (HAS_NO_ERROR(tm_run_shared(machine, words, b->lengths, b->count, &limits, b->results, NULL))) {
+            return;
+        }
+    } else if (use_lanes && !results_cache) {
+        for (size_t i = 0; i < b->count; i++) {
+            words[i] = b->data + b->offsets[i];
+        }
+        if (HAS_NO_ERROR(tm_run_lanes(machine, words, b->lengths, b->count, &limits, b->results, NULL))) {
+            return;
+        }
+    } else if (use_rle && !results_cache) {
+        for (size_t i = 0; i < b->count; i++) {
+            tm_run_rle(machine, b->data + b->offsets[i], b->lengths[i], &limits, &b->results[i]);
+        }
+        return;
+    }
+    for (size_t i = 0; i < b->count; i++) {
+        tm_cache_run(results_cache, machine, b->data + b->offsets[i], b->lengths[i], &limits,
+                     &b->results[i], 0);
+    }
+}
+
+static void *worker_main(void *arg) {
+    (void) arg;
+    int by_batch = share_prefixes || use_lanes;
+    const char **words = by_batch ? malloc(sizeof(char *) * batch_size) : NULL;
+    if (by_batch && !words) {
+        share_prefixes = 0;
+        use_lanes = 0;
+    }
+    // Un profil par fil, ajouté au profil commun à la fin
+    tm_profile *profile = run_profile ? tm_profile_create(machine) : NULL;
+    if (run_profile && !profile) {
+        fprintf(stderr, "tm: out of memory for the profile\n");
+        exit(1);
+    }
+    batch *b;
+    while ((b = queue_pop(&to_run))) {
+        run_batch(b, words, profile);
+        queue_push(&to_write, b);
+    }
+    if (profile) {
+        pthread_mutex_lock(&profile_lock);
+        tm_profile_merge(run_profile, profile);
+        pthread_mutex_unlock(&profile_lock);
+        tm_profile_free(profile);
+    }
+    free(words);
+    return NULL;
+}
+
+static void write_batch(FILE *out, const batch *b) {
+    for (size_t i = 0; i < b->count; i++) {
+        const tm_result *r = &b->results[i];
+        if (binary_output) {
+            tm_record rec = {b->first_index + i, r->verdict, 0, r->steps, r->tape_hwm};
+            fwrite(&rec, sizeof(rec), 1, out);
+        } else {
+            fprintf(out, "%s\t%llu\t%llu\n", tm_verdict_name(r->verdict),
+                    (unsigned long long) r->steps, (unsigned long long) r->tape_hwm);
+        }
+    }
+}
+
+/**
+ * Étage d'écriture : remet les lots dans l'ordre de lecture.
+ */
+static void *writer_main(void *arg) {
+    FILE *out = arg;
+    batch **pending = NULL;
+    size_t npending = 0, pending_cap = 0;
+    uint64_t next_seq = 0;
+    batch *b;
+    while ((b = queue_pop(&to_write))) {
+        if (npending == pending_cap) {
+            pending_cap = pending_cap ? pending_cap * 2 : 16;
+            pending = realloc(pending, sizeof(batch *) * pending_cap);
+            if (!pending) {
+                fprintf(stderr, "tm: out of memory while writing results\n");
+                exit(1);
+            }
+        }
+        pending[npending++] = b;
+        for (size_t i = 0; i < npending;) {
+            if (pending[i]->seq == next_seq) {
+                write_batch(out, pending[i]);
+                batch_free(pending[i]);
+                pending[i] = pending[--npending];
+                next_seq++;
+                i = 0;
+            } else {
+                i++;
+            }
+        }
+    }
+    fflush(out);
+    free(pending);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    size_t cache_capacity = 0;
+    const char *cache_file = NULL;
+    int verbose = 0;
+    int two_way = 0;
+    int lazy = 0;
+    const char *profile_file = NULL;
+    const char *layout_file = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:pLRzj:b:m:T:C:P:g:G:v2")) != -1) {
+        if (opt == 'f' && (!strcmp(optarg, "tsv") || !strcmp(optarg, "bin"))) {
+            binary_output = !strcmp(optarg, "bin");
+        } else if (opt == 'p') {
+            share_prefixes = 1;
+        } else if (opt == 'L') {
+            use_lanes = 1;
+        } else if (opt == 'R') {
+            use_rle = 1;
+        } else if (opt == 'z') {
+            lazy = 1;
+        } else if (opt == 'j') {
+            workers = atoi(optarg);
+        } else if (opt == 'b' && atol(optarg) > 0) {
+            batch_size = (size_t) atol(optarg);
+        } else if (opt == 'm') {
+            limits.max_steps = strtoull(optarg, NULL, 10);
+        } else if (opt == 'T') {
+            limits.max_tape = (size_t) strtoull(optarg, NULL, 10);
+        } else if (opt == 'C') {
+            cache_capacity = (size_t) strtoull(optarg, NULL, 10);
+        } else if (opt == 'P') {
+            cache_file = optarg;
+        } else if (opt == 'g') {
+            profile_file = optarg;
+        } else if (opt == 'G') {
+            layout_file = optarg;
+        } else if (opt == 'v') {
+            verbose = 1;
+        } else if (opt == '2') {
+            two_way = 1;
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (lazy && (share_prefixes || use_lanes || use_rle || cache_capacity > 0 || cache_file || two_way
+                 || profile_file || layout_file)) {
+        fprintf(stderr, "tm: -z cannot be combined with -p, -L, -R, -C, -P, -g, -G or -2\n");
+        return 2;
+    }
+    if (profile_file && (share_prefixes || use_lanes || use_rle || cache_capacity > 0 || cache_file)) {
+        fprintf(stderr, "tm: -g cannot be combined with -p, -L, -R, -C or -P\n");
+        return 2;
+    }
+    if (optind != argc - 1 && optind != argc - 2) {
+        fprintf(stderr, "usage: %s [-f tsv|bin] [-p] [-L] [-R] [-z] [-j workers] [-b batch] [-m max_steps] "
+                        "[-T max_tape] [-C cache_capacity] [-P cache_file] [-g profile] [-G profile] [-v] [-2] "
+                        "machine_file [inputs]\n",
+                argv[0]);
+        return 2;
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+
+    tm_machine *m = NULL;
+    if (lazy) {
+        // Une machine paresseuse se remplit en cours d'exécution : un seul fil
+        lazy_machine = tm_lazy_open(argv[optind], TM_LAZY_INDEX_FILE);
+        workers = 1;
+    } else {
+        m = tm_machine_load(argv[optind]);
+    }
+    if (!m && !lazy_machine) {
+        fprintf(stderr, "tm: cannot load machine %s\n", argv[optind]);
+        return 1;
+    }
+    if (two_way) {
+        m->tape_mode = TM_TAPE_TWO_WAY;
+    }
+    if (layout_file && HAS_ERROR(tm_machine_relayout(m, layout_file))) {
+        fprintf(stderr, "tm: cannot apply profile %s to %s\n", layout_file, argv[optind]);
+        tm_machine_free(m);
+        return 1;
+    }
+    if (profile_file && !(run_profile = tm_profile_create(m))) {
+        fprintf(stderr, "tm: out of memory for the profile\n");
+        tm_machine_free(m);
+        return 1;
+    }
+    machine = m;
+    if ((cache_capacity > 0 || cache_file)
+        && !(results_cache = tm_cache_create(cache_capacity ? cache_capacity : 1u << 16, cache_file,
+                                             cache_capacity ? 4 * cache_capacity : 1u << 20))) {
+        fprintf(stderr, "tm: cannot create result cache\n");
+        tm_machine_free(m);
+        return 1;
+    }
+    FILE *in = stdin;
+    if (optind == argc - 2 && strcmp(argv[argc - 1], "-") != 0 && !(in = fopen(argv[argc - 1], "rb"))) {
+        perror(argv[argc - 1]);
+        tm_machine_free(m);
+        tm_lazy_free(lazy_machine);
+        return 1;
+    }
+    static char out_buf[1u << 20];
+    setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+
+    queue_init(&to_run, QUEUE_DEPTH * (size_t) workers);
+    queue_init(&to_write, QUEUE_DEPTH * (size_t) workers);
+
+    pthread_t reader, writer;
+    pthread_t *threads = malloc(sizeof(pthread_t) * workers);
+    if (!threads) {
+        return 1;
+    }
+    pthread_create(&reader, NULL, reader_main, in);
+    pthread_create(&writer, NULL, writer_main, stdout);
+    for (int i = 0; i < workers; i++) {
+        pthread_create(&threads[i], NULL, worker_main, NULL);
+    }
+    pthread_join(reader, NULL);
+    for (int i = 0; i < workers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    queue_close(&to_write);
+    pthread_join(writer, NULL);
+
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (results_cache && verbose) {
+        tm_cache_stats st;
+        tm_cache_get_stats(results_cache, &st);
+        fprintf(stderr, "cache: %llu memory hits, %llu file hits, %llu misses, %llu evictions\n",
+                (unsigned long long) st.memory_hits, (unsigned long long) st.file_hits,
+                (unsigned long long) st.misses, (unsigned long long) st.evictions);
+    }
+    int status = 0;
+    if (run_profile && HAS_ERROR(tm_profile_save(run_profile, profile_file))) {
+        fprintf(stderr, "tm: cannot write profile %s\n", profile_file);
+        status = 1;
+    }
+    tm_profile_free(run_profile);
+    tm_cache_destroy(results_cache);
+    free(threads);
+    free(to_run.items);
+    free(to_write.items);
+    tm_machine_free(m);
+    tm_lazy_free(lazy_machine);
+    return status;
+}
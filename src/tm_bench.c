@@ -0,0 +1,824 @@
+//
+// tm_bench : banc d'essai du moteur d'exécution.
+//
+// Usage : tm_bench [-d dossier_machines] [-r répétitions] [-n]
+//
+// Chaque cas exécute une machine du dossier (par défaut celui des sources)
+// sur des mots de 1 de longueurs croissantes et affiche une ligne par
+// mesure : cas, longueur, verdict, pas, ns par exécution et pas par seconde.
+// Les cas vont par paires qui décident le même langage, par exemple
+// power_len.txt à un ruban et power_len_2tapes.txt à deux rubans.
+//
+// Chaque exécution mesurée est entourée de compteurs perf_event_open (voir
+// perf_counters.h) ; la meilleure répétition donne pour chaque compteur son
+// total et sa valeur par pas, un pas étant une transition appliquée. Une
+// ligne « # counters: » en tête indique s'il s'agit des compteurs matériels
+// ou des compteurs logiciels de repli. -n désactive les compteurs.
+//
+// Une seconde table compare, sur un lot de mots binaires courts, le chemin
+// scalaire et l'exécution en voies SIMD de tm_run_lanes. Une troisième
+// donne le temps de chargement d'une machine analysée depuis son fichier
+// et de la même machine intégrée à la construction (tm_embed). La dernière
+// oppose le ruban d'un octet par case et le ruban par plages (rle_tape.h) :
+// débit, mémoire du ruban en fin d'exécution et plus grand nombre de plages.
+// Une machine générée qui écrit une longue traîne de marqueurs au bout de
+// chaque mot mesure le mémo de frontière (frontier.h). Enfin, une très
+// grande machine générée, dont chaque mot ne visite que quelques états,
+// compare le chargement complet et le chargement paresseux (lazy_load.h),
+// avec et sans index gardé : temps jusqu'au premier verdict, débit, et
+// mémoire de la table, de l'index et résidente. La table layout exécute une
+// autre grande machine générée dont les états chauds sont dispersés dans la
+// table, avant et après la renumérotation guidée par son profil
+// (profile.h), avec les compteurs de chaque mesure.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "machine.h"
+#include "lanes.h"
+#include "multitape.h"
+#include "perf_counters.h"
+#include "rle_tape.h"
+#include "frontier.h"
+#include "lazy_load.h"
+#include "profile.h"
+#include "tm_embedded_has_five_ones.h"
+#include "tm_embedded_power_len_txt.h"
+
+#ifndef TM_SOURCE_DIR
+#define TM_SOURCE_DIR "."
+#endif
+
+#define MAX_PATH_LEN 4096
+
+typedef struct {
+    const char *name;
+    const char *file;
+    int ntapes;
+} bench_case;
+
+static const bench_case cases[] = {
+        {"power_len/1", "power_len.txt", 1},
+        {"power_len/2", "power_len_2tapes.txt", 2},
+};
+
+static const size_t lengths[] = {1u << 10, 1u << 12, 1u << 14, 1u << 16};
+
+/**
+ * Lots de mots courts : chemin scalaire (tm_run mot par mot) contre voies
+ * SIMD (tm_run_lanes).
+ */
+static const char *const batch_files[] = {"has_five_ones", "power_len.txt"};
+
+#define BATCH_WORDS 65536
+#define BATCH_MAX_LEN 16
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Machine d'un cas, à un ou plusieurs rubans.
+ */
+typedef struct {
+    tm_machine *single;
+    tm_mt_machine *multi;
+} bench_machine;
+
+static int bench_load(const char *dir, const bench_case *bc, bench_machine *bm) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", dir, bc->file);
+    bm->single = NULL;
+    bm->multi = NULL;
+    if (bc->ntapes == 1) {
+        bm->single = tm_machine_load(path);
+    } else {
+        bm->multi = tm_mt_machine_load(path);
+    }
+    if (!bm->single && !bm->multi) {
+        fprintf(stderr, "tm_bench: cannot load %s\n", path);
+        return ERROR;
+    }
+    return 0;
+}
+
+/**
+ * Affiche chaque compteur en total et par pas.
+ */
+static void print_counters(const perf_counters *pc, const uint64_t *values, uint64_t steps) {
+    for (int i = 0; i < pc->count; i++) {
+        printf("\t%llu\t%.3f", (unsigned long long) values[i],
+               steps ? (double) values[i] / steps : 0.0);
+    }
+    printf("\n");
+}
+
+static void print_counter_header(const perf_counters *pc) {
+    for (int i = 0; i < pc->count; i++) {
+        printf("\t%s\t%s_per_step", pc->names[i], pc->names[i]);
+    }
+    printf("\n");
+}
+
+static int bench_run(const bench_machine *bm, const char *input, size_t len, tm_result *result) {
+    if (bm->single) {
+        return tm_run(bm->single, input, len, NULL, result);
+    }
+    return tm_mt_run(bm->multi, input, len, NULL, result);
+}
+
+static int bench_tapes(const char *dir, int reps, perf_counters *pc) {
+    size_t max_len = lengths[sizeof(lengths) / sizeof(lengths[0]) - 1];
+    char *input = malloc(max_len);
+    if (!input) {
+        return ERROR;
+    }
+    memset(input, '1', max_len);
+
+    printf("case\tlength\tverdict\tsteps\tns_per_run\tsteps_per_s");
+    print_counter_header(pc);
+    int status = 0;
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        bench_machine bm;
+        if (HAS_ERROR(bench_load(dir, &cases[c], &bm))) {
+            status = ERROR;
+            continue;
+        }
+        for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+            tm_result result;
+            uint64_t best = UINT64_MAX;
+            uint64_t best_values[PERF_MAX_COUNTERS] = {0};
+            for (int r = 0; r < reps; r++) {
+                perf_counters_start(pc);
+                uint64_t start = now_ns();
+                bench_run(&bm, input, lengths[l], &result);
+                uint64_t elapsed = now_ns() - start;
+                perf_counters_stop(pc);
+                if (elapsed < best) {
+                    best = elapsed;
+                    memcpy(best_values, pc->values, sizeof(best_values));
+                }
+            }
+            printf("%s\t%zu\t%s\t%llu\t%llu\t%.0f", cases[c].name, lengths[l],
+                   tm_verdict_name(result.verdict), (unsigned long long) result.steps,
+                   (unsigned long long) best, best ? result.steps * 1e9 / best : 0.0);
+            print_counters(pc, best_values, result.steps);
+        }
+        tm_machine_free(bm.single);
+        tm_mt_machine_free(bm.multi);
+    }
+    free(input);
+    return status;
+}
+
+/**
+ * Compare tm_run et tm_run_lanes sur BATCH_WORDS mots binaires de 1 à
+ * BATCH_MAX_LEN symboles, tirés avec une graine fixe.
+ */
+static int bench_batches(const char *dir, int reps, perf_counters *pc) {
+    char *data = malloc((size_t) BATCH_WORDS * BATCH_MAX_LEN);
+    const char **words = malloc(sizeof(char *) * BATCH_WORDS);
+    size_t *lens = malloc(sizeof(size_t) * BATCH_WORDS);
+    tm_result *results = malloc(sizeof(tm_result) * BATCH_WORDS);
+    int status = 0;
+    if (!data || !words || !lens || !results) {
+        status = ERROR;
+        goto batches_cleanup;
+    }
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < BATCH_WORDS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        lens[i] = 1 + (seed >> 16) % BATCH_MAX_LEN;
+        words[i] = data + i * BATCH_MAX_LEN;
+        for (size_t c = 0; c < lens[i]; c++) {
+            seed = seed * 1103515245u + 12345u;
+            data[i * BATCH_MAX_LEN + c] = (char) ('0' + ((seed >> 16) & 1));
+        }
+    }
+
+    printf("\nbatch\tpath\twords\tsteps\tns_per_batch\twords_per_s\tsteps_per_s");
+    print_counter_header(pc);
+    for (size_t f = 0; f < sizeof(batch_files) / sizeof(batch_files[0]); f++) {
+        char path[MAX_PATH_LEN];
+        snprintf(path, sizeof(path), "%s/%s", dir, batch_files[f]);
+        tm_machine *m = tm_machine_load(path);
+        if (!m) {
+            fprintf(stderr, "tm_bench: cannot load %s\n", path);
+            status = ERROR;
+            continue;
+        }
+        for (int lanes = 0; lanes <= 1; lanes++) {
+            uint64_t best = UINT64_MAX;
+            uint64_t best_values[PERF_MAX_COUNTERS] = {0};
+            for (int r = 0; r < reps; r++) {
+                perf_counters_start(pc);
+                uint64_t start = now_ns();
+                if (lanes) {
+                    tm_run_lanes(m, words, lens, BATCH_WORDS, NULL, results, NULL);
+                } else {
+                    for (size_t i = 0; i < BATCH_WORDS; i++) {
+                        tm_run(m, words[i], lens[i], NULL, &results[i]);
+                    }
+                }
+                uint64_t elapsed = now_ns() - start;
+                perf_counters_stop(pc);
+                if (elapsed < best) {
+                    best = elapsed;
+                    memcpy(best_values, pc->values, sizeof(best_values));
+                }
+            }
+            uint64_t steps = 0;
+            for (size_t i = 0; i < BATCH_WORDS; i++) {
+                steps += results[i].steps;
+            }
+            printf("%s\t%s%s\t%d\t%llu\t%llu\t%.0f\t%.0f", batch_files[f], lanes ? "lanes/" : "scalar",
+                   lanes ? tm_lanes_backend() : "", BATCH_WORDS,
+                   (unsigned long long) steps, (unsigned long long) best,
+                   best ? BATCH_WORDS * 1e9 / best : 0.0, best ? steps * 1e9 / best : 0.0);
+            print_counters(pc, best_values, steps);
+        }
+        tm_machine_free(m);
+    }
+
+    batches_cleanup:
+    free(data);
+    free(words);
+    free(lens);
+    free(results);
+    return status;
+}
+
+typedef struct {
+    const char *file;
+    const tm_static_machine *embedded;
+} load_case;
+
+static const load_case load_cases[] = {
+        {"power_len.txt", &tm_embedded_power_len_txt},
+        {"has_five_ones", &tm_embedded_has_five_ones},
+};
+
+#define LOADS_PER_REP 1000
+
+/**
+ * Compare tm_machine_load() et tm_machine_from_static() sur les machines
+ * intégrées à tm_bench.
+ */
+static int bench_loads(const char *dir, int reps) {
+    printf("\nload\tpath\tns_per_load\n");
+    int status = 0;
+    for (size_t l = 0; l < sizeof(load_cases) / sizeof(load_cases[0]); l++) {
+        char path[MAX_PATH_LEN];
+        snprintf(path, sizeof(path), "%s/%s", dir, load_cases[l].file);
+        tm_machine *parsed = tm_machine_load(path);
+        if (!parsed) {
+            fprintf(stderr, "tm_bench: cannot load %s\n", path);
+            status = ERROR;
+            continue;
+        }
+        tm_machine embedded;
+        tm_machine_from_static(load_cases[l].embedded, &embedded);
+        if (tm_machine_hash(&embedded) != parsed->hash) {
+            fprintf(stderr, "tm_bench: embedded %s differs from %s\n", load_cases[l].file, path);
+            status = ERROR;
+        }
+        tm_machine_free(parsed);
+        volatile int sink = 0;
+        for (int from_static = 0; from_static <= 1; from_static++) {
+            uint64_t best = UINT64_MAX;
+            for (int r = 0; r < reps; r++) {
+                uint64_t start = now_ns();
+                for (int i = 0; i < LOADS_PER_REP; i++) {
+                    if (from_static) {
+                        tm_machine_from_static(load_cases[l].embedded, &embedded);
+                        sink += embedded.nstates;
+                    } else {
+                        tm_machine_free(tm_machine_load(path));
+                    }
+                }
+                uint64_t elapsed = now_ns() - start;
+                if (elapsed < best) {
+                    best = elapsed;
+                }
+            }
+            printf("%s\t%s\t%.1f\n", load_cases[l].file, from_static ? "static" : "parse",
+                   (double) best / LOADS_PER_REP);
+        }
+    }
+    return status;
+}
+
+typedef struct {
+    const char *file;
+    char fill;
+    size_t length;
+} tape_case;
+
+static const tape_case tape_cases[] = {
+        {"power_len.txt", '1', 1u << 10},
+        {"power_len.txt", '1', 1u << 14},
+        {"power_len.txt", '1', 1u << 16},
+        {"youre_gonna_go_far_kid", TM_BLANK, 1},
+};
+
+/**
+ * Compare le ruban plat de tm_config et le ruban par plages sur les mêmes
+ * exécutions.
+ */
+static int bench_rle(const char *dir, int reps) {
+    printf("\ntape\tlength\tbackend\tsteps\tns_per_run\tsteps_per_s\ttape_bytes\tpeak_runs\n");
+    int status = 0;
+    for (size_t k = 0; k < sizeof(tape_cases) / sizeof(tape_cases[0]); k++) {
+        const tape_case *tc = &tape_cases[k];
+        char path[MAX_PATH_LEN];
+        snprintf(path, sizeof(path), "%s/%s", dir, tc->file);
+        tm_machine *m = tm_machine_load(path);
+        char *input = malloc(tc->length);
+        if (!m || !input) {
+            fprintf(stderr, "tm_bench: cannot load %s\n", path);
+            tm_machine_free(m);
+            free(input);
+            status = ERROR;
+            continue;
+        }
+        memset(input, tc->fill, tc->length);
+        for (int rle = 0; rle <= 1; rle++) {
+            uint64_t best = UINT64_MAX;
+            tm_result result = {0};
+            size_t bytes = 0, runs = 0;
+            for (int r = 0; r < reps; r++) {
+                uint64_t start = now_ns();
+                if (rle) {
+                    tm_rle_tape *t = tm_rle_create(m, input, tc->length);
+                    if (t) {
+                        tm_rle_run(m, t, NULL, &result);
+                        tm_rle_stats st;
+                        tm_rle_get_stats(t, &st);
+                        bytes = st.bytes;
+                        runs = st.peak_runs;
+                    }
+                    tm_rle_free(t);
+                } else {
+                    tm_config c;
+                    if (HAS_NO_ERROR(tm_config_init(&c, m, input, tc->length))) {
+                        int verdict = tm_config_run(m, &c, NULL, SIZE_MAX);
+                        tm_config_result(&c, verdict, &result);
+                        bytes = c.cap;
+                        tm_config_release(&c);
+                    }
+                }
+                uint64_t elapsed = now_ns() - start;
+                if (elapsed < best) {
+                    best = elapsed;
+                }
+            }
+            printf("%s\t%zu\t%s\t%llu\t%llu\t%.0f\t%zu\t", tc->file, tc->length, rle ? "rle" : "flat",
+                   (unsigned long long) result.steps, (unsigned long long) best,
+                   best ? result.steps * 1e9 / best : 0.0, bytes);
+            if (rle) {
+                printf("%zu\n", runs);
+            } else {
+                printf("-\n");
+            }
+        }
+        tm_machine_free(m);
+        free(input);
+    }
+    return status;
+}
+
+#define TRAILER_LENGTH 1000
+#define TRAILER_WORDS 4096
+
+/**
+ * Machine « traîne » : parcourt le mot puis écrit TRAILER_LENGTH marqueurs
+ * à sa suite et accepte ; toute l'écriture se fait sur la frontière
+ * blanche, dans le même état d'arrivée pour chaque mot.
+ * @return le texte de la machine, à libérer, ou NULL
+ */
+static char *trailer_machine(size_t *len) {
+    size_t cap = 64 + 32 * (size_t) TRAILER_LENGTH;
+    char *text = malloc(cap);
+    if (!text) {
+        return NULL;
+    }
+    size_t n = (size_t) snprintf(text, cap, "S\nA\nR\n(S,0)->(S,0,D)\n(S,1)->(S,1,D)\n(S, )->(T1,@,D)\n");
+    for (int t = 1; t < TRAILER_LENGTH - 1; t++) {
+        n += (size_t) snprintf(text + n, cap - n, "(T%d, )->(T%d,@,D)\n", t, t + 1);
+    }
+    n += (size_t) snprintf(text + n, cap - n, "(T%d, )->(A,@,G)\n", TRAILER_LENGTH - 1);
+    *len = n;
+    return text;
+}
+
+/**
+ * Compare, sur TRAILER_WORDS mots binaires courts, le moteur sans mémo
+ * (tm_config_init) et avec le mémo de frontière d'un contexte.
+ */
+static int bench_frontier(int reps) {
+    size_t text_len;
+    char *text = trailer_machine(&text_len);
+    tm_machine *m = text ? tm_machine_parse(text, text_len) : NULL;
+    char *data = malloc((size_t) TRAILER_WORDS * BATCH_MAX_LEN);
+    size_t *lens = malloc(sizeof(size_t) * TRAILER_WORDS);
+    int status = 0;
+    if (!m || !data || !lens) {
+        status = ERROR;
+        goto frontier_cleanup;
+    }
+    uint32_t seed = 54321;
+    for (size_t i = 0; i < TRAILER_WORDS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        lens[i] = 1 + (seed >> 16) % BATCH_MAX_LEN;
+        for (size_t c = 0; c < lens[i]; c++) {
+            seed = seed * 1103515245u + 12345u;
+            data[i * BATCH_MAX_LEN + c] = (char) ('0' + ((seed >> 16) & 1));
+        }
+    }
+
+    printf("\nfrontier\tmemo\twords\tsteps\tns_per_word\tsteps_per_s\thits\tskipped_steps\n");
+    for (int memo = 0; memo <= 1; memo++) {
+        uint64_t best = UINT64_MAX, steps = 0;
+        tm_frontier_stats st = {0};
+        for (int r = 0; r < reps; r++) {
+            tm_context *ctx = memo ? tm_context_create() : NULL;
+            if (memo && !ctx) {
+                status = ERROR;
+                break;
+            }
+            steps = 0;
+            uint64_t start = now_ns();
+            for (size_t i = 0; i < TRAILER_WORDS; i++) {
+                tm_result result;
+                if (memo) {
+                    tm_context_run(ctx, m, data + i * BATCH_MAX_LEN, lens[i], NULL, &result);
+                } else {
+                    tm_config c;
+                    if (HAS_ERROR(tm_config_init(&c, m, data + i * BATCH_MAX_LEN, lens[i]))) {
+                        continue;
+                    }
+                    int verdict = tm_config_run(m, &c, NULL, SIZE_MAX);
+                    tm_config_result(&c, verdict, &result);
+                    tm_config_release(&c);
+                }
+                steps += result.steps;
+            }
+            uint64_t elapsed = now_ns() - start;
+            if (elapsed < best) {
+                best = elapsed;
+                if (ctx && ctx->frontier) {
+                    tm_frontier_get_stats(ctx->frontier, &st);
+                }
+            }
+            tm_context_free(ctx);
+        }
+        printf("trailer/%d\t%s\t%d\t%llu\t%.1f\t%.0f\t%llu\t%llu\n", TRAILER_LENGTH, memo ? "on" : "off",
+               TRAILER_WORDS, (unsigned long long) steps, (double) best / TRAILER_WORDS,
+               best ? steps * 1e9 / best : 0.0, (unsigned long long) st.hits,
+               (unsigned long long) st.skipped_steps);
+    }
+
+    frontier_cleanup:
+    tm_machine_free(m);
+    free(text);
+    free(data);
+    free(lens);
+    return status;
+}
+
+#define TREE_STATES (1 << 18)
+#define TREE_WORDS 2000
+
+/**
+ * Nom de l'état i de la machine arbre : « q » suivi de i en base 36.
+ */
+static void tree_name(char *buf, long i) {
+    char digits[8];
+    int n = 0;
+    do {
+        digits[n++] = "0123456789abcdefghijklmnopqrstuvwxyz"[i % 36];
+        i /= 36;
+    } while (i > 0);
+    *buf++ = 'q';
+    while (n > 0) {
+        *buf++ = digits[--n];
+    }
+    *buf = '\0';
+}
+
+/**
+ * Écrit la machine arbre : TREE_STATES états en arbre binaire, l'état i
+ * allant à 2i + 1 sur 0 et à 2i + 2 sur 1 ; un mot de longueur n ne visite
+ * que n + 1 états.
+ * @return 0 ou ERROR
+ */
+static int write_tree_machine(FILE *fp) {
+    char name[8], child[8];
+    fprintf(fp, "q0\nA\nR\n");
+    for (long i = 0; i < TREE_STATES; i++) {
+        tree_name(name, i);
+        for (int bit = 0; bit < 2; bit++) {
+            long c = 2 * i + 1 + bit;
+            if (c < TREE_STATES) {
+                tree_name(child, c);
+            } else {
+                strcpy(child, "A");
+            }
+            fprintf(fp, "(%s,%d)->(%s,%d,D)\n", name, bit, child, bit);
+        }
+        fprintf(fp, "(%s, )->(A, ,G)\n", name);
+    }
+    return ferror(fp) ? ERROR : 0;
+}
+
+/**
+ * @return la mémoire résidente du processus en Kio, 0 si elle est inconnue
+ */
+static size_t resident_kb(void) {
+    FILE *fp = fopen("/proc/self/statm", "r");
+    unsigned long size, resident = 0;
+    if (fp) {
+        if (fscanf(fp, "%lu %lu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(fp);
+    }
+    return resident * (size_t) sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/**
+ * Compare tm_machine_load() et tm_lazy_open(), avec un index construit
+ * puis relu, sur la machine arbre.
+ */
+static int bench_lazy(void) {
+    char path[] = "/tmp/tm_bench_XXXXXX";
+    char idx_path[sizeof(path) + 4];
+    char *data = malloc((size_t) TREE_WORDS * BATCH_MAX_LEN);
+    size_t *lens = malloc(sizeof(size_t) * TREE_WORDS);
+    int status = 0;
+    int fd = mkstemp(path);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp || !data || !lens) {
+        if (fd >= 0) {
+            close(fd);
+            remove(path);
+        }
+        free(data);
+        free(lens);
+        return ERROR;
+    }
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+    int written = HAS_NO_ERROR(write_tree_machine(fp));
+    if (fclose(fp) != 0 || !written) {
+        status = ERROR;
+        goto lazy_cleanup;
+    }
+    uint32_t seed = 777;
+    for (size_t i = 0; i < TREE_WORDS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        lens[i] = 1 + (seed >> 16) % BATCH_MAX_LEN;
+        for (size_t c = 0; c < lens[i]; c++) {
+            seed = seed * 1103515245u + 12345u;
+            data[i * BATCH_MAX_LEN + c] = (char) ('0' + ((seed >> 16) & 1));
+        }
+    }
+
+    printf("\nlazy\tstates\tloaded\tfirst_ms\tfirst_rss_kb\tns_per_word\trss_kb\ttable_kb\tindex_kb\n");
+    static const char *const variants[] = {"full", "lazy", "lazy+idx"};
+    for (int v = 0; v < 3; v++) {
+        size_t rss_before = resident_kb();
+        uint64_t start = now_ns();
+        tm_machine *m = NULL;
+        tm_lazy_machine *lm = NULL;
+        if (v == 0) {
+            m = tm_machine_load(path);
+        } else {
+            lm = tm_lazy_open(path, TM_LAZY_INDEX_FILE);
+        }
+        if (!m && !lm) {
+            status = ERROR;
+            break;
+        }
+        uint64_t first = 0;
+        size_t first_rss = 0;
+        for (size_t i = 0; i < TREE_WORDS; i++) {
+            if (m) {
+                tm_run(m, data + i * BATCH_MAX_LEN, lens[i], NULL, NULL);
+            } else {
+                tm_lazy_run(lm, data + i * BATCH_MAX_LEN, lens[i], NULL, NULL);
+            }
+            if (i == 0) {
+                first = now_ns();
+                first_rss = resident_kb();
+            }
+        }
+        uint64_t end = now_ns();
+        size_t rss = resident_kb();
+        size_t states, loaded, table_bytes, index_bytes;
+        if (m) {
+            states = loaded = (size_t) m->nstates;
+            table_bytes = sizeof(tm_entry) * (size_t) m->nstates * m->nsyms;
+            index_bytes = 0;
+        } else {
+            tm_lazy_stats st;
+            tm_lazy_get_stats(lm, &st);
+            states = st.indexed_states;
+            loaded = st.loaded_states;
+            table_bytes = st.table_bytes;
+            index_bytes = st.index_bytes;
+        }
+        printf("%s\t%zu\t%zu\t%.2f\t%zu\t%.1f\t%zu\t%zu\t%zu\n", variants[v], states, loaded,
+               (double) (first - start) / 1e6, first_rss > rss_before ? first_rss - rss_before : 0,
+               (double) (end - first) / (TREE_WORDS - 1), rss > rss_before ? rss - rss_before : 0,
+               table_bytes / 1024, index_bytes / 1024);
+        tm_machine_free(m);
+        tm_lazy_free(lm);
+    }
+
+    lazy_cleanup:
+    remove(path);
+    remove(idx_path);
+    free(data);
+    free(lens);
+    return status;
+}
+
+#define SCATTER_STATES (1 << 18)
+#define SCATTER_HOT (1 << 15)
+#define SCATTER_STEPS 4000000
+
+/**
+ * Écrit la machine dispersée : SCATTER_HOT états chauds tirés au hasard
+ * parmi SCATTER_STATES. La tête reste sur la case 0 ; l'état chaud k y
+ * lit 0 et va à l'état chaud k + 1, ou lit 1 et va à l'état chaud 5k + 3,
+ * en inversant le symbole : une marche pseudo-aléatoire qui ne s'arrête
+ * qu'à la limite de pas. Les autres états ne sont jamais visités.
+ * @return 0 ou ERROR
+ */
+static int write_scatter_machine(FILE *fp) {
+    long *ids = malloc(sizeof(long) * SCATTER_STATES);
+    long *hot = malloc(sizeof(long) * SCATTER_STATES);
+    if (!ids || !hot) {
+        free(ids);
+        free(hot);
+        return ERROR;
+    }
+    // Les SCATTER_HOT premiers de ids, mélangé, sont les états chauds ;
+    // hot[id] donne le rang k d'un état chaud, -1 sinon
+    for (long i = 0; i < SCATTER_STATES; i++) {
+        ids[i] = i;
+        hot[i] = -1;
+    }
+    uint32_t seed = 4242;
+    for (long k = 0; k < SCATTER_HOT; k++) {
+        seed = seed * 1103515245u + 12345u;
+        long j = k + (long) (seed >> 8) % (SCATTER_STATES - k);
+        long t = ids[k];
+        ids[k] = ids[j];
+        ids[j] = t;
+        hot[ids[k]] = k;
+    }
+    char name[8], zero[8], one[8];
+    tree_name(name, ids[0]);
+    fprintf(fp, "%s\nA\nR\n", name);
+    for (long i = 0; i < SCATTER_STATES; i++) {
+        tree_name(name, i);
+        long k = hot[i];
+        if (k < 0) {
+            fprintf(fp, "(%s,0)->(A,0,D)\n(%s,1)->(R,1,G)\n", name, name);
+            continue;
+        }
+        tree_name(zero, ids[(k + 1) % SCATTER_HOT]);
+        tree_name(one, ids[(5 * k + 3) % SCATTER_HOT]);
+        fprintf(fp, "(%s,0)->(%s,1,R)\n(%s,1)->(%s,0,R)\n", name, zero, name, one);
+    }
+    free(ids);
+    free(hot);
+    return ferror(fp) ? ERROR : 0;
+}
+
+/**
+ * Exécute la machine dispersée dans l'ordre du fichier puis renumérotée
+ * d'après un profil d'une exécution : débit et compteurs par pas.
+ */
+static int bench_layout(int reps, perf_counters *pc) {
+    char path[] = "/tmp/tm_bench_XXXXXX";
+    char profile_path[sizeof(path) + 8];
+    tm_machine *m[2] = {NULL, NULL};
+    tm_profile *profile = NULL;
+    int status = 0;
+    int fd = mkstemp(path);
+    FILE *fp = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!fp) {
+        if (fd >= 0) {
+            close(fd);
+            remove(path);
+        }
+        return ERROR;
+    }
+    snprintf(profile_path, sizeof(profile_path), "%s.profile", path);
+    int written = HAS_NO_ERROR(write_scatter_machine(fp));
+    if (fclose(fp) != 0 || !written || !(m[0] = tm_machine_load(path)) || !(m[1] = tm_machine_load(path))
+        || !(profile = tm_profile_create(m[1]))) {
+        status = ERROR;
+        goto layout_cleanup;
+    }
+    tm_limits limits = {SCATTER_STEPS, 0};
+    tm_profile_run(profile, m[1], "0", 1, &limits, NULL);
+    if (HAS_ERROR(tm_profile_save(profile, profile_path)) || HAS_ERROR(tm_machine_relayout(m[1], profile_path))) {
+        status = ERROR;
+        goto layout_cleanup;
+    }
+
+    printf("\nlayout\tstates\thot\tsteps\tns_per_run\tsteps_per_s");
+    print_counter_header(pc);
+    static const char *const layouts[] = {"file", "profile"};
+    for (int v = 0; v < 2; v++) {
+        tm_result result;
+        uint64_t best = UINT64_MAX;
+        uint64_t best_values[PERF_MAX_COUNTERS] = {0};
+        for (int r = 0; r < reps; r++) {
+            perf_counters_start(pc);
+            uint64_t start = now_ns();
+            tm_run(m[v], "0", 1, &limits, &result);
+            uint64_t elapsed = now_ns() - start;
+            perf_counters_stop(pc);
+            if (elapsed < best) {
+                best = elapsed;
+                memcpy(best_values, pc->values, sizeof(best_values));
+            }
+        }
+        printf("%s\t%d\t%d\t%llu\t%llu\t%.0f", layouts[v], m[v]->nstates, SCATTER_HOT,
+               (unsigned long long) result.steps, (unsigned long long) best,
+               best ? result.steps * 1e9 / best : 0.0);
+        print_counters(pc, best_values, result.steps);
+    }
+
+    layout_cleanup:
+    tm_profile_free(profile);
+    tm_machine_free(m[0]);
+    tm_machine_free(m[1]);
+    remove(path);
+    remove(profile_path);
+    return status;
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = TM_SOURCE_DIR;
+    int reps = 5;
+    int use_counters = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:r:n")) != -1) {
+        if (opt == 'd') {
+            dir = optarg;
+        } else if (opt == 'r') {
+            reps = atoi(optarg);
+        } else if (opt == 'n') {
+            use_counters = 0;
+        } else {
+            fprintf(stderr, "usage: %s [-d machine_dir] [-r repetitions] [-n]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (reps < 1) {
+        reps = 1;
+    }
+
+    perf_counters pc = {0};
+    if (use_counters) {
+        if (HAS_ERROR(perf_counters_open(&pc))) {
+            printf("# counters: none (perf_event_open: %s)\n", strerror(pc.open_errno));
+        } else if (pc.hardware) {
+            printf("# counters: hardware\n");
+        } else {
+            printf("# counters: software fallback (hardware counters unavailable: %s)\n",
+                   strerror(pc.open_errno));
+        }
+    }
+    int status = bench_tapes(dir, reps, &pc);
+    if (HAS_ERROR(bench_batches(dir, reps, &pc))) {
+        status = ERROR;
+    }
+    if (HAS_ERROR(bench_loads(dir, reps))) {
+        status = ERROR;
+    }
+    if (HAS_ERROR(bench_rle(dir, reps))) {
+        status = ERROR;
+    }
+    if (HAS_ERROR(bench_frontier(reps))) {
+        status = ERROR;
+    }
+    if (HAS_ERROR(bench_lazy())) {
+        status = ERROR;
+    }
+    if (HAS_ERROR(bench_layout(reps, &pc))) {
+        status = ERROR;
+    }
+    perf_counters_close(&pc);
+    return HAS_ERROR(status) ? 1 : 0;
+}
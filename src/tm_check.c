@@ -0,0 +1,932 @@
+//
+// tm_check : tests de non-régression de la bibliothèque tm.
+//
+// Usage : tm_check [nom_du_test]
+//
+// Sans argument, tous les tests sont exécutés. Le code de sortie est le
+// nombre de tests en échec ; chaque test est aussi enregistré auprès de
+// ctest sous son nom (voir CMakeLists.txt).
+//
+#define _POSIX_C_SOURCE 200809L
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "cache.h"
+#include "dfa.h"
+#include "execute_ex.h"
+#include "frontier.h"
+#include "lanes.h"
+#include "lazy_load.h"
+#include "machine.h"
+#include "pipeline.h"
+#include "prefix.h"
+#include "profile.h"
+#include "replay.h"
+#include "rle_tape.h"
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: échec : %s\n", __FILE__, __LINE__, #cond); \
+        goto cleanup; \
+    } \
+} while (0)
+
+typedef struct {
+    const char *name;
+    int (*run)(void);
+} check_case;
+
+/**
+ * Écrit la description text dans un fichier temporaire.
+ * @param path reçoit le chemin, au moins 32 octets
+ * @return 0 ou ERROR
+ */
+static int write_machine(const char *text, char *path) {
+    strcpy(path, "/tmp/tm_check_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return ERROR;
+    }
+    size_t len = strlen(text);
+    ssize_t written = write(fd, text, len);
+    close(fd);
+    if (written != (ssize_t) len) {
+        unlink(path);
+        return ERROR;
+    }
+    return 0;
+}
+
+/**
+ * Le ruban gardé par execute_ex() se termine par un '\0' même quand la
+ * machine s'est arrêtée sur la dernière case allouée.
+ */
+static int check_keep_tape_full(void) {
+    // 15 pas à droite depuis le mot vide : la tête finit sur la case 15
+    char text[1024] = "q0\nqA\nqR\n";
+    for (int i = 0; i < 15; i++) {
+        char line[64];
+        if (i < 14) {
+            sprintf(line, "(q%d, )->(q%d,x,D)\n", i, i + 1);
+        } else {
+            sprintf(line, "(q%d, )->(qA,x,D)\n", i);
+        }
+        strcat(text, line);
+    }
+    char path[32];
+    execute_result r = {0};
+    int status = ERROR;
+    if (HAS_ERROR(write_machine(text, path))) {
+        return ERROR;
+    }
+    CHECK(execute_ex(path, "", EXECUTE_KEEP_TAPE, &r) == 1);
+    CHECK(r.tape_hwm == 15);
+    CHECK(r.tape_len == 16);
+    CHECK(r.tape[r.tape_len] == '\0');
+    CHECK(strcmp(r.tape, "xxxxxxxxxxxxxxx ") == 0);
+    status = 0;
+
+    cleanup:
+    free(r.tape);
+    unlink(path);
+    return status;
+}
+
+/**
+ * Écrit dans text une machine qui parcourt le mot puis écrit length
+ * marqueurs sur la frontière blanche et accepte.
+ */
+static void trailer_text(char *text, int length) {
+    strcpy(text, "S\nA\nR\n(S,0)->(S,0,D)\n(S, )->(T1,@,D)\n");
+    for (int t = 1; t < length; t++) {
+        char line[64];
+        sprintf(line, t < length - 1 ? "(T%d, )->(T%d,@,D)\n" : "(T%d, )->(A,@,G)\n", t, t + 1);
+        strcat(text, line);
+    }
+}
+
+/**
+ * Après tm_machine_relayout(), le mémo de frontière d'un contexte qui a
+ * déjà servi la machine ne s'applique plus à ses nouveaux numéros d'états.
+ */
+static int check_relayout_memo(void) {
+    char text[2048];
+    trailer_text(text, 20);
+    tm_machine *m = tm_machine_parse(text, strlen(text));
+    tm_context *ctx = tm_context_create();
+    tm_profile *p = m ? tm_profile_create(m) : NULL;
+    tm_limits limits = {1000, 0};
+    tm_result expected, result;
+    char path[32] = "";
+    int status = ERROR;
+    CHECK(m && ctx && p);
+    CHECK(HAS_NO_ERROR(write_machine("", path)));
+    // Deux passages : le premier remplit le mémo, le second s'en sert
+    for (int i = 0; i < 2; i++) {
+        CHECK(tm_context_run(ctx, m, "000", 3, &limits, &expected) == TM_ACCEPT);
+    }
+    CHECK(HAS_NO_ERROR(tm_profile_run(p, m, "000", 3, &limits, &result)));
+    CHECK(HAS_NO_ERROR(tm_profile_save(p, path)));
+    int accept = m->accept;
+    CHECK(HAS_NO_ERROR(tm_machine_relayout(m, path)));
+    CHECK(m->accept != accept);
+    CHECK(tm_context_run(ctx, m, "000", 3, &limits, &result) == TM_ACCEPT);
+    CHECK(result.steps == expected.steps);
+    CHECK(result.head == expected.head);
+    status = 0;
+
+    cleanup:
+    if (path[0]) {
+        unlink(path);
+    }
+    tm_profile_free(p);
+    tm_context_free(ctx);
+    tm_machine_free(m);
+    return status;
+}
+
+/**
+ * Un contexte qui alterne entre deux machines garde le mémo de chacune.
+ */
+static int check_frontier_switch(void) {
+    char text[2][2048];
+    tm_machine *m[2];
+    trailer_text(text[0], 20);
+    trailer_text(text[1], 30);
+    m[0] = tm_machine_parse(text[0], strlen(text[0]));
+    m[1] = tm_machine_parse(text[1], strlen(text[1]));
+    tm_context *ctx = tm_context_create();
+    tm_frontier_stats st;
+    tm_result result;
+    int status = ERROR;
+    CHECK(m[0] && m[1] && ctx);
+    for (int i = 0; i < 6; i++) {
+        CHECK(tm_context_run(ctx, m[i % 2], "00", 2, NULL, &result) == TM_ACCEPT);
+    }
+    // Trois passages sur chaque machine : le premier remplit son mémo
+    tm_frontier_get_stats(ctx->frontier, &st);
+    CHECK(st.hits == 2);
+    status = 0;
+
+    cleanup:
+    tm_context_free(ctx);
+    tm_machine_free(m[0]);
+    tm_machine_free(m[1]);
+    return status;
+}
+
+/**
+ * Un index .idx dont la taille et la date correspondent encore à la
+ * machine, mais qui ne connaît pas un symbole lu par un état, fait échouer
+ * le chargement de cet état au lieu de l'écrire dans la colonne 0.
+ */
+static int check_lazy_unknown_symbol(void) {
+    char path[32], idx_path[40] = "";
+    tm_lazy_machine *lm = NULL;
+    struct stat st;
+    tm_result result;
+    int status = ERROR;
+    if (HAS_ERROR(write_machine("q0\nqA\nqR\n(q0,1)->(qA,1,R)\n", path))) {
+        return ERROR;
+    }
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+    CHECK((lm = tm_lazy_open(path, TM_LAZY_INDEX_FILE)) != NULL);
+    CHECK(tm_lazy_run(lm, "1", 1, NULL, &result) == TM_ACCEPT);
+    tm_lazy_free(lm);
+    lm = NULL;
+    // Même taille, même date : l'index est repris tel quel
+    CHECK(stat(path, &st) == 0);
+    FILE *fp = fopen(path, "r+");
+    CHECK(fp != NULL);
+    fseek(fp, 13, SEEK_SET);
+    fputc('x', fp);
+    fclose(fp);
+    struct timespec times[2] = {st.st_atim, st.st_mtim};
+    CHECK(utimensat(AT_FDCWD, path, times, 0) == 0);
+    CHECK((lm = tm_lazy_open(path, TM_LAZY_INDEX_FILE)) != NULL);
+    CHECK(tm_lazy_run(lm, "y", 1, NULL, &result) == TM_LOAD_ERROR);
+    status = 0;
+
+    cleanup:
+    tm_lazy_free(lm);
+    unlink(path);
+    unlink(idx_path);
+    return status;
+}
+
+/**
+ * Un arrêt sans transition au pas max_steps, mis en cache sans limite,
+ * n'est pas rendu sous une limite de max_steps pas : la limite est
+ * atteinte avant que la transition manquante soit constatée.
+ */
+static int check_cache_step_limit(void) {
+    const char *text = "S\nA\nR\n(S,0)->(T,0,D)\n(T,0)->(A,0,R)\n";
+    tm_machine *m = tm_machine_parse(text, strlen(text));
+    tm_cache *cache = tm_cache_create(16, NULL, 0);
+    tm_limits one = {1, 0};
+    tm_result result;
+    int status = ERROR;
+    CHECK(m && cache);
+    CHECK(tm_cache_run(cache, m, "0", 1, NULL, &result, 0) == TM_NO_TRANSITION);
+    CHECK(result.steps == 1);
+    CHECK(tm_cache_run(cache, m, "0", 1, &one, &result, 0) == TM_STEP_LIMIT);
+    CHECK(tm_run(m, "0", 1, &one, &result) == TM_STEP_LIMIT);
+    status = 0;
+
+    cleanup:
+    tm_cache_destroy(cache);
+    tm_machine_free(m);
+    return status;
+}
+
+/**
+ * Sur un ruban bi-infini limité à 3 cases, une machine qui écrit en
+ * allant toujours du même côté atteint la limite au 3e pas, à gauche comme
+ * à droite, sur le ruban plat, le ruban par plages et l'enregistrement.
+ */
+static int check_two_way_tape_limit(void) {
+    const char *texts[2] = {"S\nA\nR\n(S, )->(S,x,D)\n", "S\nA\nR\n(S, )->(S,x,G)\n"};
+    tm_limits limits = {0, 3};
+    tm_machine *m = NULL;
+    tm_replay *r = NULL;
+    tm_result result;
+    int status = ERROR;
+    for (int i = 0; i < 2; i++) {
+        CHECK((m = tm_machine_parse(texts[i], strlen(texts[i]))) != NULL);
+        m->tape_mode = TM_TAPE_TWO_WAY;
+        CHECK(tm_run(m, "", 0, &limits, &result) == TM_TAPE_LIMIT);
+        CHECK(result.steps == 3);
+        CHECK(tm_run_rle(m, "", 0, &limits, &result) == TM_TAPE_LIMIT);
+        CHECK(result.steps == 3);
+        CHECK((r = tm_replay_record(m, "", 0, &limits, 0)) != NULL);
+        CHECK(tm_replay_verdict(r) == TM_TAPE_LIMIT);
+        CHECK(tm_replay_steps(r) == 3);
+        tm_replay_free(r);
+        r = NULL;
+        tm_machine_free(m);
+        m = NULL;
+    }
+    status = 0;
+
+    cleanup:
+    tm_replay_free(r);
+    tm_machine_free(m);
+    return status;
+}
+
+/**
+ * Une description équivalente mais aux lignes dans un autre ordre, donc
+ * de même empreinte et aux états numérotés autrement, chargée à l'adresse
+ * d'une machine déjà servie par un contexte, n'hérite pas de son mémo.
+ */
+static int check_reload_same_address(void) {
+    // Le retour à gauche de la traîne finit dans U : l'issue retenue par le
+    // mémo nomme U par son numéro
+    char text[2][2048], lines[24][48];
+    int n = 0;
+    strcpy(lines[n++], "(S,0)->(S,0,D)\n");
+    strcpy(lines[n++], "(S, )->(T1,@,D)\n");
+    for (int t = 1; t < 19; t++) {
+        sprintf(lines[n++], "(T%d, )->(T%d,@,D)\n", t, t + 1);
+    }
+    strcpy(lines[n++], "(T19, )->(U,@,G)\n");
+    strcpy(lines[n++], "(U,@)->(U,@,G)\n");
+    strcpy(lines[n++], "(U,0)->(A,0,R)\n");
+    for (int k = 0; k < 2; k++) {
+        strcpy(text[k], "S\nA\nR\n");
+        for (int i = 0; i < n; i++) {
+            strcat(text[k], lines[k ? n - 1 - i : i]);
+        }
+    }
+    tm_machine *m = tm_machine_parse(text[0], strlen(text[0]));
+    tm_machine *reordered = tm_machine_parse(text[1], strlen(text[1]));
+    tm_context *ctx = tm_context_create();
+    tm_result expected, result;
+    int status = ERROR;
+    CHECK(m && reordered && ctx);
+    CHECK(m->hash == reordered->hash);
+    CHECK(tm_state_id(m, "U") != tm_state_id(reordered, "U"));
+    CHECK(tm_run(reordered, "000", 3, NULL, &expected) == TM_ACCEPT);
+    for (int i = 0; i < 2; i++) {
+        CHECK(tm_context_run(ctx, m, "000", 3, NULL, &result) == TM_ACCEPT);
+    }
+    // La machine réordonnée prend la place de m, à la même adresse
+    tm_machine swap = *m;
+    *m = *reordered;
+    *reordered = swap;
+    CHECK(tm_context_run(ctx, m, "000", 3, NULL, &result) == TM_ACCEPT);
+    CHECK(result.steps == expected.steps);
+    status = 0;
+
+    cleanup:
+    tm_context_free(ctx);
+    tm_machine_free(reordered);
+    tm_machine_free(m);
+    return status;
+}
+
+/* Étages des tests d'enchaînement : MARK remplace les 0 par des 1 et
+ * rejette sur un 1, BACK parcourt les 1 et accepte sur le blanc */
+#define PIPE_MARK "S\nA\nR\n(S,0)->(S,1,D)\n(S,1)->(R,1,R)\n(S, )->(A, ,G)\n"
+#define PIPE_BACK "S\nA\nR\n(S,1)->(S,1,D)\n(S, )->(A, ,R)\n"
+
+/**
+ * Exécute un enchaînement sur le mot input.
+ * @param verdict reçoit le verdict de tm_pipeline_run()
+ * @param tape reçoit les len premières cases du ruban final
+ * @return 0, ou ERROR si l'enchaînement n'a pas pu être préparé ou si le
+ * ruban a été réalloué en cours de route
+ */
+static int run_pipeline(const tm_stage *stages, int n, int flags, const char *input,
+                        int *verdict, tm_result *results, int *ran, uint64_t *steps, char *tape) {
+    size_t len = strlen(input);
+    tm_pipeline *p = tm_pipeline_create(stages, n, flags);
+    tm_config c;
+    if (!p) {
+        return ERROR;
+    }
+    if (HAS_ERROR(tm_config_init(&c, stages[0].m, input, len))) {
+        tm_pipeline_free(p);
+        return ERROR;
+    }
+    // Le ruban passe d'un étage à l'autre sans être recopié
+    char *before = c.tape;
+    *verdict = tm_pipeline_run(p, &c, NULL, results, ran);
+    int status = c.tape == before ? 0 : ERROR;
+    *steps = c.steps;
+    memcpy(tape, c.tape + c.origin, len);
+    tape[len] = '\0';
+    tm_config_release(&c);
+    tm_pipeline_free(p);
+    return status;
+}
+
+/**
+ * Les étages s'enchaînent sur le même ruban selon leurs conditions
+ * TM_PIPE_IF_* : ran compte les étages exécutés, chaque résultat ne compte
+ * que les pas de son étage et, sans TM_PIPE_RESET_HEAD, un étage reprend
+ * la tête où le précédent l'a laissée.
+ */
+static int check_pipeline_stages(void) {
+    tm_machine *mark = tm_machine_parse(PIPE_MARK, strlen(PIPE_MARK));
+    tm_machine *back = tm_machine_parse(PIPE_BACK, strlen(PIPE_BACK));
+    tm_result results[3];
+    uint64_t steps;
+    char tape[8];
+    int verdict, ran;
+    int status = ERROR;
+    CHECK(mark && back);
+    tm_stage accepted[3] = {{mark, 0}, {back, TM_PIPE_IF_ACCEPT | TM_PIPE_RESET_HEAD},
+                            {mark, TM_PIPE_IF_REJECT}};
+    // BACK relit depuis la case 0 les 1 écrits par MARK ; le 3e étage
+    // attend un rejet
+    CHECK(HAS_NO_ERROR(run_pipeline(accepted, 3, 0, "000", &verdict, results, &ran, &steps, tape)));
+    CHECK(verdict == TM_ACCEPT);
+    CHECK(ran == 2);
+    CHECK(results[0].verdict == TM_ACCEPT && results[0].steps == 4 && results[0].head == 2);
+    CHECK(results[1].verdict == TM_ACCEPT && results[1].steps == 4 && results[1].head == 3);
+    CHECK(steps == 8);
+    CHECK(strcmp(tape, "111") == 0);
+    // MARK rejette sur la case 1 : BACK ne suit qu'un accept
+    CHECK(HAS_NO_ERROR(run_pipeline(accepted, 3, 0, "010", &verdict, results, &ran, &steps, tape)));
+    CHECK(verdict == TM_REJECT);
+    CHECK(ran == 1);
+    CHECK(results[0].steps == 2 && results[0].head == 1);
+    CHECK(strcmp(tape, "110") == 0);
+    // Sans TM_PIPE_RESET_HEAD, BACK part de la case 1 et bute sur le 0 de
+    // la case 2 ; le 3e étage ne suit pas un code d'erreur
+    tm_stage rejected[3] = {{mark, 0}, {back, TM_PIPE_IF_REJECT}, {back, 0}};
+    CHECK(HAS_NO_ERROR(run_pipeline(rejected, 3, 0, "010", &verdict, results, &ran, &steps, tape)));
+    CHECK(verdict == TM_NO_TRANSITION);
+    CHECK(ran == 2);
+    CHECK(results[1].steps == 1 && results[1].head == 2);
+    CHECK(steps == 3);
+    status = 0;
+
+    cleanup:
+    tm_machine_free(mark);
+    tm_machine_free(back);
+    return status;
+}
+
+/**
+ * Avec TM_PIPE_SHARED_SYMBOLS, les étages, qui ne lisent pas les mêmes
+ * symboles, rendent les mêmes résultats et le même ruban que sans.
+ */
+static int check_pipeline_shared_symbols(void) {
+    tm_machine *mark = tm_machine_parse(PIPE_MARK, strlen(PIPE_MARK));
+    tm_machine *back = tm_machine_parse(PIPE_BACK, strlen(PIPE_BACK));
+    const char *inputs[] = {"", "0", "000", "010", "0001"};
+    tm_result results[2][3];
+    uint64_t steps[2];
+    char tape[2][8];
+    int ran[2], verdict[2];
+    int status = ERROR;
+    CHECK(mark && back);
+    CHECK(mark->sym['1'] != back->sym['1']);
+    tm_stage stages[3] = {{mark, 0}, {back, TM_PIPE_RESET_HEAD}, {mark, TM_PIPE_IF_ACCEPT}};
+    for (size_t i = 0; i < sizeof(inputs) / sizeof(inputs[0]); i++) {
+        for (int k = 0; k < 2; k++) {
+            CHECK(HAS_NO_ERROR(run_pipeline(stages, 3, k ? TM_PIPE_SHARED_SYMBOLS : 0, inputs[i],
+                                            &verdict[k], results[k], &ran[k], &steps[k], tape[k])));
+        }
+        CHECK(verdict[0] == verdict[1]);
+        CHECK(ran[0] == ran[1]);
+        CHECK(steps[0] == steps[1]);
+        CHECK(strcmp(tape[0], tape[1]) == 0);
+        for (int j = 0; j < ran[0]; j++) {
+            CHECK(results[0][j].verdict == results[1][j].verdict);
+            CHECK(results[0][j].steps == results[1][j].steps);
+            CHECK(results[0][j].head == results[1][j].head);
+        }
+    }
+    status = 0;
+
+    cleanup:
+    tm_machine_free(mark);
+    tm_machine_free(back);
+    return status;
+}
+
+/**
+ * Compare deux résultats champ par champ.
+ * @return 1 s'ils sont égaux, sinon 0 après avoir décrit l'écart sur stderr
+ */
+static int same_result(const tm_result *a, const tm_result *b) {
+    if (a->verdict == b->verdict && a->steps == b->steps && a->head == b->head
+        && a->tape_hwm == b->tape_hwm && a->tape_low == b->tape_low) {
+        return 1;
+    }
+    fprintf(stderr, "verdict %d/%d, pas %llu/%llu, tête %lld/%lld, hwm %zu/%zu, low %zu/%zu\n",
+            a->verdict, b->verdict, (unsigned long long) a->steps, (unsigned long long) b->steps,
+            (long long) a->head, (long long) b->head, a->tape_hwm, b->tape_hwm,
+            a->tape_low, b->tape_low);
+    return 0;
+}
+
+/**
+ * Écrit dans word le mot binaire d'indice i parmi ceux de longueur len.
+ */
+static void binary_word(char *word, size_t len, unsigned i) {
+    for (size_t k = 0; k < len; k++) {
+        word[k] = (char) ('0' + ((i >> k) & 1));
+    }
+}
+
+/**
+ * L'automate d'une machine qui ne va jamais à gauche rend les résultats
+ * de run_loop() pour tous les mots binaires courts, de longueur paire ou
+ * impaire, sous toutes les limites de pas et de ruban proches de leur
+ * seuil, y compris pendant le parcours du blanc après le mot.
+ */
+static int check_dfa_limits(void) {
+    // Remplacements sur place (R) puis traîne sur le blanc ; parcours sans
+    // fin du blanc ; arrêt sans transition sur le blanc ; boucle sur place
+    const char *texts[] = {
+            "S\nA\nR\n(S,0)->(S,1,D)\n(S,1)->(T,0,R)\n(T,0)->(S,0,D)\n(S, )->(B1,x,D)\n"
+            "(B1, )->(B2,y,R)\n(B2,y)->(B3,y,D)\n(B3, )->(A, ,R)\n",
+            "S\nA\nR\n(S,0)->(S,0,D)\n(S,1)->(R,1,R)\n(S, )->(S, ,D)\n",
+            "S\nA\nR\n(S,0)->(S,0,D)\n(S,1)->(U,1,R)\n(U,1)->(S,0,D)\n",
+            "S\nA\nR\n(S,0)->(S,0,D)\n(S,1)->(L,1,R)\n(L,1)->(S,1,R)\n(S, )->(A, ,R)\n",
+    };
+    // Sans limite, le 2e ne s'arrête pas ; sans limite de pas, le 4e non plus
+    const int needs_limit[] = {0, 1, 0, 2};
+    tm_machine *m = NULL;
+    char word[8];
+    int status = ERROR;
+    for (size_t t = 0; t < sizeof(texts) / sizeof(texts[0]); t++) {
+        CHECK((m = tm_machine_parse(texts[t], strlen(texts[t]))) != NULL);
+        CHECK(m->dfa != NULL);
+        tm_machine plain = *m;
+        plain.dfa = NULL;
+        for (size_t len = 0; len <= 7; len++) {
+            for (unsigned i = 0; i < 1u << len; i++) {
+                binary_word(word, len, i);
+                for (uint64_t steps = 0; steps <= 24; steps++) {
+                    for (size_t cells = 0; cells <= len + 6; cells++) {
+                        tm_limits limits = {steps, cells};
+                        tm_result fast, slow;
+                        if ((needs_limit[t] == 1 && !steps && !cells)
+                            || (needs_limit[t] == 2 && !steps)) {
+                            continue;
+                        }
+                        int verdict = tm_dfa_run(m, word, len, &limits, &fast);
+                        CHECK(verdict != TM_RUNNING);
+                        CHECK(tm_run(&plain, word, len, &limits, &slow) == verdict);
+                        CHECK(same_result(&fast, &slow));
+                    }
+                }
+            }
+        }
+        tm_machine_free(m);
+        m = NULL;
+    }
+    status = 0;
+
+    cleanup:
+    tm_machine_free(m);
+    return status;
+}
+
+/* Mots du test des voies : assez pour remplir plusieurs fois les voies */
+#define LANE_WORDS 96
+
+/**
+ * tm_run_lanes() rend les résultats de tm_run() avec chaque version du pas
+ * disponible, la version portable comprise, y compris pour les mots
+ * évincés au bord du ruban d'une voie et pour les mots plus longs que
+ * TM_LANE_MAX_INPUT, sous plusieurs limites.
+ */
+static int check_lanes_equivalence(void) {
+    // Traîne de 40 cases, au-delà du ruban de 32 cases d'une voie ; retour
+    // sur le mot jusqu'à un x ou jusqu'à la case 0, où la tête bute
+    char texts[2][2048];
+    trailer_text(texts[0], 40);
+    strcpy(texts[1], "S\nA\nR\n(S,0)->(S,0,D)\n(S,1)->(S,x,D)\n(S, )->(B, ,G)\n"
+                     "(B,0)->(B,1,G)\n(B,x)->(R,x,R)\n(B,1)->(A,1,R)\n");
+    const char *backends[] = {"portable", "avx2", "avx512"};
+    const tm_limits limits[] = {{0, 0}, {60, 0}, {0, 24}, {9, 5}};
+    static char storage[LANE_WORDS][TM_LANE_MAX_INPUT + 16];
+    const char *words[LANE_WORDS];
+    size_t lens[LANE_WORDS];
+    tm_result results[LANE_WORDS], expected;
+    tm_machine *m = NULL;
+    int status = ERROR;
+    // Mots de 0 à 20 symboles, un 1 de temps en temps, et quelques mots
+    // trop longs pour une voie
+    for (int i = 0; i < LANE_WORDS; i++) {
+        lens[i] = i % 16 == 5 ? TM_LANE_MAX_INPUT + 1 + (size_t) (i % 7) : (size_t) (i * 7 % 21);
+        for (size_t k = 0; k < lens[i]; k++) {
+            storage[i][k] = (i * 31 + (int) k) % 23 == 0 ? '1' : '0';
+        }
+        words[i] = storage[i];
+    }
+    for (int t = 0; t < 2; t++) {
+        CHECK((m = tm_machine_parse(texts[t], strlen(texts[t]))) != NULL);
+        for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+            if (HAS_ERROR(tm_lanes_set_backend(backends[b]))) {
+                CHECK(b > 0);
+                continue;
+            }
+            for (size_t k = 0; k < sizeof(limits) / sizeof(limits[0]); k++) {
+                tm_lane_stats stats = {0};
+                CHECK(HAS_NO_ERROR(tm_run_lanes(m, words, lens, LANE_WORDS, &limits[k],
+                                                results, &stats)));
+                CHECK(stats.scalar == LANE_WORDS / 16);
+                CHECK(t == 1 || k > 1 || stats.evicted > 0);
+                for (int i = 0; i < LANE_WORDS; i++) {
+                    tm_run(m, words[i], lens[i], &limits[k], &expected);
+                    CHECK(same_result(&results[i], &expected));
+                }
+            }
+        }
+        tm_machine_free(m);
+        m = NULL;
+    }
+    status = 0;
+
+    cleanup:
+    tm_lanes_set_backend(NULL);
+    tm_machine_free(m);
+    return status;
+}
+
+/* Mots du test de partage : tous les mots binaires d'au plus 8 symboles,
+ * deux fois */
+#define SHARED_MAX_LEN 8
+#define SHARED_WORDS (2 * ((1 << (SHARED_MAX_LEN + 1)) - 1))
+
+/**
+ * tm_run_shared() rend les résultats de tm_run() mot par mot, pour des
+ * mots en désordre et en double qui partagent leurs préfixes, avec des
+ * clichés repris, des arrêts réutilisés avant la fin du mot
+ * (c.reach < w->len) et sous des limites de pas et de ruban.
+ */
+static int check_shared_prefix(void) {
+    // Arrêt sur le premier 1 ; arrêt sur le premier 11 ; parcours de tout
+    // le mot puis retour au premier symbole, marqué
+    char texts[3][2048];
+    trailer_text(texts[0], 6);
+    strcpy(texts[1], "S\nA\nR\n(S,0)->(S,0,D)\n(S,1)->(O,1,D)\n(S, )->(A, ,R)\n"
+                     "(O,0)->(S,0,D)\n(O,1)->(R,1,R)\n(O, )->(A, ,R)\n");
+    strcpy(texts[2], "S\nA\nR\n(S,0)->(P,#,D)\n(S,1)->(P,$,D)\n(S, )->(A, ,R)\n"
+                     "(P,0)->(P,0,D)\n(P,1)->(P,1,D)\n(P, )->(B, ,G)\n"
+                     "(B,0)->(B,0,G)\n(B,1)->(B,1,G)\n(B,#)->(A,#,R)\n(B,$)->(R,$,R)\n");
+    const tm_limits limits[] = {{0, 0}, {1, 0}, {5, 0}, {0, 4}, {12, 6}};
+    static char storage[SHARED_WORDS][SHARED_MAX_LEN];
+    static const char *words[SHARED_WORDS];
+    static size_t lens[SHARED_WORDS];
+    static tm_result results[SHARED_WORDS];
+    tm_result expected;
+    tm_machine *m = NULL;
+    int status = ERROR;
+    // Les mots longs d'abord, pour que le tri ait du travail
+    size_t n = 0;
+    for (int copy = 0; copy < 2; copy++) {
+        for (int len = SHARED_MAX_LEN; len >= 0; len--) {
+            for (unsigned i = 0; i < 1u << len; i++) {
+                binary_word(storage[n], (size_t) len, i);
+                words[n] = storage[n];
+                lens[n++] = (size_t) len;
+            }
+        }
+    }
+    for (int t = 0; t < 3; t++) {
+        tm_share_stats stats = {0};
+        CHECK((m = tm_machine_parse(texts[t], strlen(texts[t]))) != NULL);
+        for (size_t k = 0; k < sizeof(limits) / sizeof(limits[0]); k++) {
+            CHECK(HAS_NO_ERROR(tm_run_shared(m, words, lens, n, k ? &limits[k] : NULL,
+                                             results, &stats)));
+            for (size_t i = 0; i < n; i++) {
+                tm_run(m, words[i], lens[i], k ? &limits[k] : NULL, &expected);
+                CHECK(same_result(&results[i], &expected));
+            }
+        }
+        // La 3e machine lit tout le mot : elle n'est réutilisée qu'après
+        // une limite de pas
+        CHECK(stats.resumed > 0 && stats.reused > 0);
+        tm_machine_free(m);
+        m = NULL;
+    }
+    status = 0;
+
+    cleanup:
+    tm_machine_free(m);
+    return status;
+}
+
+/**
+ * tm_rle_run() rend les résultats et le ruban de run_loop(), sur un ruban
+ * infini à droite comme bi-infini, pour des machines qui traversent des
+ * plages d'un seul coup, sous toutes les limites de pas et de ruban
+ * proches de leur seuil : la traversée s'arrête là où run_loop()
+ * s'arrêterait.
+ */
+static int check_rle_equivalence(void) {
+    // Traîne finie ; allers-retours sans fin entre un # en case 0 et une
+    // traîne de x qui s'allonge à chaque passage ; même chose vers la
+    // gauche, qui bute sur la case 0 du ruban infini à droite sans
+    // l'agrandir ; parcours sans fin du blanc, à droite ou à gauche après
+    // un 1, que seules les limites bornent
+    char texts[4][2048];
+    trailer_text(texts[0], 5);
+    strcpy(texts[1], "S\nA\nR\n(S,0)->(P,#,D)\n(S,1)->(P,#,D)\n(S, )->(P,#,D)\n"
+                     "(P,0)->(P,0,D)\n(P,1)->(P,1,D)\n(P,x)->(P,x,D)\n(P, )->(Q,x,G)\n"
+                     "(Q,0)->(Q,0,G)\n(Q,1)->(Q,1,G)\n(Q,x)->(Q,x,G)\n(Q,#)->(P,#,D)\n");
+    strcpy(texts[2], "S\nA\nR\n(S,0)->(S,0,G)\n(S,1)->(S,1,G)\n(S,x)->(S,x,G)\n(S, )->(T,x,D)\n"
+                     "(T,0)->(T,0,D)\n(T,1)->(T,1,D)\n(T,x)->(T,x,D)\n(T, )->(S,x,G)\n");
+    strcpy(texts[3], "S\nA\nR\n(S,0)->(S,0,D)\n(S,1)->(L,1,G)\n(S, )->(S, ,D)\n"
+                     "(L,0)->(L,0,G)\n(L,1)->(L,1,G)\n(L, )->(L, ,G)\n");
+    tm_machine *m = NULL;
+    tm_rle_tape *t = NULL;
+    tm_config c = {0};
+    char word[8], rle_cells[64];
+    uint64_t swept = 0;
+    int status = ERROR;
+    for (int k = 0; k < 4; k++) {
+        CHECK((m = tm_machine_parse(texts[k], strlen(texts[k]))) != NULL);
+        for (int mode = 0; mode < 2; mode++) {
+            m->tape_mode = mode ? TM_TAPE_TWO_WAY : TM_TAPE_RIGHT;
+            for (size_t len = 0; len <= 6; len++) {
+                for (unsigned i = 0; i < 1u << len; i++) {
+                    binary_word(word, len, i);
+                    for (uint64_t steps = 0; steps <= 40; steps++) {
+                        for (size_t cells = 0; cells <= len + 6; cells++) {
+                            tm_limits limits = {steps, cells};
+                            tm_result fast, slow;
+                            tm_rle_stats st;
+                            if (k > 0 && !steps && (!cells || (k >= 2 && !mode))) {
+                                continue;
+                            }
+                            CHECK((t = tm_rle_create(m, word, len)) != NULL);
+                            CHECK(HAS_NO_ERROR(tm_config_init(&c, m, word, len)));
+                            int verdict = tm_rle_run(m, t, &limits, &fast);
+                            CHECK(tm_config_run(m, &c, &limits, SIZE_MAX) == verdict);
+                            tm_config_result(&c, verdict, &slow);
+                            CHECK(same_result(&fast, &slow));
+                            size_t span = c.reach - c.low + 1;
+                            CHECK(span <= sizeof(rle_cells));
+                            tm_rle_read(t, (int64_t) c.low - (int64_t) c.origin, span, rle_cells);
+                            CHECK(memcmp(rle_cells, c.tape + c.low, span) == 0);
+                            tm_rle_get_stats(t, &st);
+                            swept += st.swept_steps;
+                            tm_config_release(&c);
+                            tm_rle_free(t);
+                            t = NULL;
+                        }
+                    }
+                }
+            }
+        }
+        tm_machine_free(m);
+        m = NULL;
+    }
+    CHECK(swept > 0);
+    status = 0;
+
+    cleanup:
+    tm_config_release(&c);
+    tm_rle_free(t);
+    tm_machine_free(m);
+    return status;
+}
+
+/**
+ * tm_lazy_run() rend les résultats de tm_run() sur la machine compilée au
+ * complet, sans index, en écrivant l'index .idx puis en le relisant. Comme
+ * au chargement complet, la première de deux transitions pour un même
+ * couple (état, symbole) l'emporte.
+ */
+static int check_lazy_equivalence(void) {
+    // Parité des 1, dont deux transitions répétées plus bas avec une autre
+    // issue : avec la dernière, 11 serait rejeté au 2e pas et 1 accepté
+    const char *text = "S\nA\nR\n(S,1)->(O,1,D)\n(S,0)->(S,0,D)\n(O,0)->(O,0,D)\n"
+                       "(O,1)->(S,1,D)\n(S, )->(B, ,G)\n(O, )->(R, ,R)\n(S,1)->(R,1,R)\n"
+                       "(B,0)->(A,0,R)\n(B,1)->(A,1,R)\n(B, )->(A, ,R)\n(O, )->(A, ,R)\n";
+    const int flags[] = {0, TM_LAZY_INDEX_FILE, TM_LAZY_INDEX_FILE};
+    const tm_limits limits[] = {{0, 0}, {3, 0}, {0, 4}};
+    char path[32], idx_path[40] = "", word[8];
+    tm_machine *m = tm_machine_parse(text, strlen(text));
+    tm_lazy_machine *lm = NULL;
+    tm_lazy_stats st;
+    tm_result result, expected;
+    int status = ERROR;
+    if (!m || HAS_ERROR(write_machine(text, path))) {
+        tm_machine_free(m);
+        return ERROR;
+    }
+    snprintf(idx_path, sizeof(idx_path), "%s.idx", path);
+    CHECK(tm_run(m, "11", 2, NULL, &expected) == TM_ACCEPT);
+    CHECK(tm_run(m, "1", 1, NULL, &expected) == TM_REJECT);
+    for (int f = 0; f < 3; f++) {
+        CHECK((lm = tm_lazy_open(path, flags[f])) != NULL);
+        tm_lazy_get_stats(lm, &st);
+        CHECK(st.index_reused == (f == 2));
+        CHECK(tm_lazy_run(lm, "11", 2, NULL, &result) == TM_ACCEPT);
+        CHECK(tm_lazy_run(lm, "1", 1, NULL, &result) == TM_REJECT);
+        for (size_t len = 0; len <= 7; len++) {
+            for (unsigned i = 0; i < 1u << len; i++) {
+                binary_word(word, len, i);
+                for (size_t k = 0; k < sizeof(limits) / sizeof(limits[0]); k++) {
+                    const tm_limits *l = k ? &limits[k] : NULL;
+                    CHECK(tm_lazy_run(lm, word, len, l, &result) == tm_run(m, word, len, l, &expected));
+                    CHECK(same_result(&result, &expected));
+                }
+            }
+        }
+        tm_lazy_free(lm);
+        lm = NULL;
+    }
+    status = 0;
+
+    cleanup:
+    tm_lazy_free(lm);
+    tm_machine_free(m);
+    unlink(path);
+    unlink(idx_path);
+    return status;
+}
+
+/**
+ * Compare la position courante de r à une exécution neuve de m arrêtée
+ * au même pas : état, tête, cases atteintes et ruban, mot compris.
+ * @return 1 si elles sont égales, sinon 0
+ */
+static int replay_matches(const tm_replay *r, const tm_machine *m, const char *input,
+                          size_t len, size_t max_tape) {
+    tm_replay_position pos;
+    tm_config c;
+    char cells[2][128];
+    tm_replay_where(r, &pos);
+    if (HAS_ERROR(tm_config_init(&c, m, input, len))) {
+        return 0;
+    }
+    tm_limits limits = {pos.step, max_tape};
+    if (pos.step > 0) {
+        tm_config_run(m, &c, &limits, SIZE_MAX);
+    }
+    int64_t origin = (int64_t) c.origin;
+    int64_t last = (int64_t) c.reach - origin;
+    if ((int64_t) len - 1 > last) {
+        last = (int64_t) len - 1;
+    }
+    size_t span = (size_t) (last - ((int64_t) c.low - origin) + 1);
+    int same = c.steps == pos.step && c.state == pos.state && (int64_t) c.head - origin == pos.head
+               && (int64_t) c.low - origin == pos.low && (int64_t) c.reach - origin == pos.reach
+               && span <= sizeof(cells[0]);
+    if (same) {
+        memcpy(cells[0], c.tape + c.low, span);
+        tm_replay_read(r, pos.low, span, cells[1]);
+        same = memcmp(cells[0], cells[1], span) == 0;
+    }
+    tm_config_release(&c);
+    return same;
+}
+
+/**
+ * Après tm_replay_seek(r, k), dans n'importe quel ordre, et après chaque
+ * tm_replay_back() ou tm_replay_forward(), l'enregistrement est dans la
+ * configuration d'une exécution neuve arrêtée au pas k. Une exécution
+ * arrêtée par la limite de ruban sur un multiple de l'intervalle n'a pas
+ * de cliché à son dernier pas : seek y va depuis le précédent.
+ */
+static int check_replay_seek(void) {
+    // Écriture vers la droite jusqu'à la limite ; allers-retours entre un
+    // # en case 0 et une traîne de x, sur un ruban bi-infini
+    const char *texts[] = {
+            "S\nA\nR\n(S,0)->(S,1,D)\n(S,1)->(S,0,D)\n(S, )->(S,x,D)\n",
+            "S\nA\nR\n(S,0)->(P,#,D)\n(S,1)->(P,#,D)\n(S, )->(P,#,D)\n"
+            "(P,0)->(P,0,D)\n(P,1)->(P,1,D)\n(P,x)->(P,x,D)\n(P, )->(Q,x,G)\n"
+            "(Q,0)->(Q,0,G)\n(Q,1)->(Q,1,G)\n(Q,x)->(Q,x,G)\n(Q,#)->(P,#,D)\n",
+    };
+    const char *input = "0110";
+    const uint64_t intervals[] = {1, 3, 4, 0};
+    tm_machine *m = NULL;
+    tm_replay *r = NULL;
+    int status = ERROR;
+    for (int t = 0; t < 2; t++) {
+        CHECK((m = tm_machine_parse(texts[t], strlen(texts[t]))) != NULL);
+        for (int mode = 0; mode < 2; mode++) {
+            m->tape_mode = mode ? TM_TAPE_TWO_WAY : TM_TAPE_RIGHT;
+            for (size_t i = 0; i < sizeof(intervals) / sizeof(intervals[0]); i++) {
+                // 8 cases : le premier s'arrête au pas 8 sur la limite
+                tm_limits limits = {t ? 60 : 0, 8};
+                CHECK((r = tm_replay_record(m, input, 4, &limits, intervals[i])) != NULL);
+                uint64_t n = tm_replay_steps(r);
+                CHECK(t == 1 || (tm_replay_verdict(r) == TM_TAPE_LIMIT && n == 8));
+                CHECK(replay_matches(r, m, input, 4, 8));
+                CHECK(tm_replay_forward(r) == ERROR);
+                CHECK(tm_replay_seek(r, n + 1) == ERROR);
+                // En avant, en arrière, puis en sautant d'un bout à l'autre
+                for (uint64_t k = 0; k <= n; k++) {
+                    CHECK(tm_replay_seek(r, k) == 0 && replay_matches(r, m, input, 4, 8));
+                }
+                for (uint64_t k = n + 1; k-- > 0;) {
+                    CHECK(tm_replay_seek(r, k) == 0 && replay_matches(r, m, input, 4, 8));
+                }
+                for (uint64_t k = 0; k <= n; k++) {
+                    uint64_t to = k % 2 ? n - k / 2 : k / 2;
+                    CHECK(tm_replay_seek(r, to) == 0 && replay_matches(r, m, input, 4, 8));
+                }
+                CHECK(tm_replay_seek(r, 0) == 0 && tm_replay_back(r) == ERROR);
+                while (tm_replay_forward(r) == 0) {
+                    CHECK(replay_matches(r, m, input, 4, 8));
+                }
+                while (tm_replay_back(r) == 0) {
+                    CHECK(replay_matches(r, m, input, 4, 8));
+                }
+                tm_replay_free(r);
+                r = NULL;
+            }
+        }
+        tm_machine_free(m);
+        m = NULL;
+    }
+    status = 0;
+
+    cleanup:
+    tm_replay_free(r);
+    tm_machine_free(m);
+    return status;
+}
+
+static const check_case check_cases[] = {
+        {"keep_tape_full", check_keep_tape_full},
+        {"relayout_memo", check_relayout_memo},
+        {"frontier_switch", check_frontier_switch},
+        {"lazy_unknown_symbol", check_lazy_unknown_symbol},
+        {"cache_step_limit", check_cache_step_limit},
+        {"two_way_tape_limit", check_two_way_tape_limit},
+        {"reload_same_address", check_reload_same_address},
+        {"pipeline_stages", check_pipeline_stages},
+        {"pipeline_shared_symbols", check_pipeline_shared_symbols},
+        {"dfa_limits", check_dfa_limits},
+        {"lanes_equivalence", check_lanes_equivalence},
+        {"shared_prefix", check_shared_prefix},
+        {"rle_equivalence", check_rle_equivalence},
+        {"lazy_equivalence", check_lazy_equivalence},
+        {"replay_seek", check_replay_seek},
+};
+
+#define NCHECKS (sizeof(check_cases) / sizeof(check_cases[0]))
+
+int main(int argc, char *argv[]) {
+    int failed = 0, found = 0;
+    for (size_t i = 0; i < NCHECKS; i++) {
+        if (argc > 1 && strcmp(argv[1], check_cases[i].name) != 0) {
+            continue;
+        }
+        found = 1;
+        int status = check_cases[i].run();
+        printf("%s\t%s\n", check_cases[i].name, HAS_ERROR(status) ? "FAIL" : "ok");
+        failed += HAS_ERROR(status);
+    }
+    if (!found) {
+        fprintf(stderr, "tm_check: test inconnu : %s\n", argv[1]);
+        return 1;
+    }
+    return failed;
+}
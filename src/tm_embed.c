@@ -0,0 +1,100 @@
+//
+// tm_embed : compile une description de machine en en-tête C.
+//
+// Usage : tm_embed machine_file identifiant en-tête
+//
+// Écrit dans en-tête un tm_static_machine constant nommé
+// tm_embedded_<identifiant> (noms d'états internés, table de transitions
+// dense, table de symboles et empreinte), que tm_machine_from_static()
+// expose sans analyse ni allocation. Appelé à la construction par la
+// fonction CMake tm_embed().
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+
+#define ENTRIES_PER_LINE 4
+#define SYMBOLS_PER_LINE 16
+
+/**
+ * Écrit une chaîne C ; tout ce qui n'est pas alphanumérique est échappé
+ * en octal.
+ */
+static void write_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char) *s;
+        if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            fputc(c, out);
+        } else {
+            fprintf(out, "\\%03o", c);
+        }
+    }
+    fputc('"', out);
+}
+
+static int write_header(FILE *out, const tm_machine *m, const char *file, const char *id) {
+    const char *base = strrchr(file, '/');
+    fprintf(out, "// Généré par tm_embed à partir de %s ; ne pas modifier.\n", base ? base + 1 : file);
+    fprintf(out, "#ifndef TM_EMBEDDED_%s_H\n#define TM_EMBEDDED_%s_H\n\n", id, id);
+    fprintf(out, "#include \"machine.h\"\n\n");
+
+    fprintf(out, "static const char *const tm_embedded_%s_names[] = {\n", id);
+    for (int s = 0; s < m->nstates; s++) {
+        fprintf(out, "        ");
+        write_string(out, m->names[s]);
+        fprintf(out, ",\n");
+    }
+    fprintf(out, "};\n\n");
+
+    size_t n = (size_t) m->nstates * m->nsyms;
+    fprintf(out, "static const tm_entry tm_embedded_%s_table[] = {", id);
+    for (size_t i = 0; i < n; i++) {
+        const tm_entry *e = &m->table[i];
+        fprintf(out, "%s{%d, (char) %d, %d},", i % ENTRIES_PER_LINE ? " " : "\n        ",
+                (int) e->next, (unsigned char) e->write, e->movement);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const tm_static_machine tm_embedded_%s = {\n", id);
+    fprintf(out, "        tm_embedded_%s_names, %d, %d, %d, %d,\n        {",
+            id, m->nstates, m->start, m->accept, m->reject);
+    for (int b = 0; b < 256; b++) {
+        fprintf(out, "%s%d%s", b && b % SYMBOLS_PER_LINE == 0 ? "\n         " : "", m->sym[b],
+                b < 255 ? (b % SYMBOLS_PER_LINE == SYMBOLS_PER_LINE - 1 ? "," : ", ") : "");
+    }
+    fprintf(out, "},\n        %d, tm_embedded_%s_table, 0x%016llxull, %d\n};\n\n",
+            m->nsyms, id, (unsigned long long) m->hash, m->tape_mode);
+    fprintf(out, "#endif //TM_EMBEDDED_%s_H\n", id);
+    return ferror(out) ? ERROR : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s machine_file identifier header\n", argv[0]);
+        return 2;
+    }
+    tm_machine *m = tm_machine_load(argv[1]);
+    if (!m) {
+        fprintf(stderr, "tm_embed: cannot load machine %s\n", argv[1]);
+        return 1;
+    }
+    FILE *out = fopen(argv[3], "w");
+    if (!out) {
+        perror(argv[3]);
+        tm_machine_free(m);
+        return 1;
+    }
+    int err = write_header(out, m, argv[1], argv[2]);
+    if (fclose(out) != 0) {
+        err = ERROR;
+    }
+    tm_machine_free(m);
+    if (HAS_ERROR(err)) {
+        fprintf(stderr, "tm_embed: cannot write %s\n", argv[3]);
+        remove(argv[3]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,413 @@
+//
+// tm_gen : génère des machines synthétiques et des corpus de mots.
+//
+// Usage : tm_gen [-t famille] [-s graine] [-q états] [-a alphabet] [-d densité]
+//                [-n non_déterminisme] [-l pas_attendus] [-L longueur_mot]
+//                [-c nombre_mots] [-w fichier_mots] [-o fichier_machine]
+//
+// La machine est écrite dans le format que lit parse_line() : en-tête
+// « S », « A », « R » puis une transition « (état,lu)->(état,écrit,M) » par
+// ligne, avec des noms d'état d'au plus 5 caractères (S, puis q1, q2, ...).
+// L'alphabet est formé des a premiers caractères de 0-9a-z ; '#' sert de
+// marqueur aux familles qui en ont besoin.
+//
+// Familles (-t) :
+//   random  : chaque couple (état, symbole) a une transition avec la
+//             probabilité -d ; une fraction -n des couples en reçoit une
+//             seconde, contradictoire (la première l'emporte au chargement).
+//   walk    : marche aléatoire déterministe et complète, la tête va à gauche
+//             ou à droite à chaque pas.
+//   zigzag  : (q-1)/2 allers-retours sur le mot, chacun réécrivant ses
+//             symboles ; ~ q * n pas pour un mot de longueur n.
+//   counter : décompte jusqu'à zéro d'un nombre en base a écrit après '#'
+//             (chiffre de poids faible d'abord) ; -q ne s'applique pas.
+//
+// -l fixe la longueur d'exécution visée : pour random et walk, elle donne
+// la part des transitions qui mènent à A ou R (voir gen_random) ; pour
+// zigzag et counter, elle donne la taille des mots du corpus. -L est la
+// longueur des mots de random et walk.
+//
+// Pour random et walk, -l n'est qu'une cible : une marche peut boucler
+// sans jamais atteindre une transition d'arrêt, et au-delà du nombre de
+// couples (états x symboles) -l ne change plus la machine. Avec -w, tm_gen
+// exécute donc chaque mot du corpus, au plus 4 * l pas, et indique sur
+// stderr les longueurs obtenues.
+//
+// Le générateur est un splitmix64 : une même graine donne les mêmes
+// fichiers sur toutes les plateformes, pour comparer des versions entre
+// elles.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "machine.h"
+
+/* Pas au-delà desquels la mesure du corpus compte un mot comme sans arrêt,
+ * en multiples de -l */
+#define MEASURE_FACTOR 4
+
+#define MAX_STATES 10000
+#define SYMBOLS "0123456789abcdefghijklmnopqrstuvwxyz"
+#define MAX_ALPHABET 36
+#define MARKER '#'
+
+typedef struct {
+    const char *family;
+    uint64_t seed;
+    int states;
+    int alphabet;
+    double density;
+    double nondeterminism;
+    double run_length;
+    size_t word_length;
+    size_t words;
+} gen_options;
+
+static uint64_t rng_state;
+
+static uint64_t next_random(void) {
+    uint64_t z = (rng_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static double random_unit(void) {
+    return (double) (next_random() >> 11) / (double) (1ull << 53);
+}
+
+static int random_below(int n) {
+    return (int) (next_random() % (uint64_t) n);
+}
+
+/**
+ * Nom de l'état i : S pour l'état initial, q<i> pour les autres.
+ */
+static const char *state_name(int i, char *buf) {
+    if (i == 0) {
+        return "S";
+    }
+    snprintf(buf, 6, "q%d", i);
+    return buf;
+}
+
+static void emit(FILE *out, const char *from, char read, const char *to, char write, char move) {
+    fprintf(out, "(%s,%c)->(%s,%c,%c)\n", from, read, to, write, move);
+}
+
+/**
+ * Symbole d'indice i de l'alphabet étendu du blanc (indice a).
+ */
+static char symbol(const gen_options *o, int i) {
+    return i == o->alphabet ? ' ' : SYMBOLS[i];
+}
+
+static void random_transition(FILE *out, const gen_options *o, int from, char read,
+                              int halt, int walk) {
+    char a[6], b[6];
+    const char *to;
+    if (halt) {
+        to = random_below(2) ? "A" : "R";
+    } else {
+        to = state_name(random_below(o->states), b);
+    }
+    char write = symbol(o, random_below(o->alphabet + 1));
+    char move;
+    if (walk) {
+        move = random_below(2) ? 'D' : 'G';
+    } else {
+        int r = random_below(10);
+        move = r < 5 ? 'D' : r < 9 ? 'G' : 'R';
+    }
+    emit(out, state_name(from, a), read, to, write, move);
+}
+
+/**
+ * Machines random et walk. Les couples présents sont tirés d'abord, puis
+ * environ (couples / l) d'entre eux, au moins un, mènent à A ou R : une
+ * marche qui visite les couples uniformément s'arrête après ~l pas, sans
+ * dépasser le nombre de couples.
+ * @return 0 ou ERROR si la mémoire manque
+ */
+static int gen_random(FILE *out, const gen_options *o, int walk) {
+    double density = walk ? 1.0 : o->density;
+    double nondet = walk ? 0.0 : o->nondeterminism;
+    size_t max_pairs = (size_t) o->states * (size_t) (o->alphabet + 1);
+    unsigned char *present = malloc(max_pairs);
+    unsigned char *halting = calloc(max_pairs, 1);
+    if (!present || !halting) {
+        free(present);
+        free(halting);
+        return ERROR;
+    }
+    size_t pairs = 0;
+    for (size_t p = 0; p < max_pairs; p++) {
+        present[p] = random_unit() < density;
+        pairs += present[p];
+    }
+    size_t halts = (size_t) ((double) pairs / o->run_length + 0.5);
+    if (halts == 0 && pairs > 0) {
+        halts = 1;
+    }
+    for (size_t h = 0; h < halts;) {
+        size_t p = (size_t) (next_random() % max_pairs);
+        if (present[p] && !halting[p]) {
+            halting[p] = 1;
+            h++;
+        }
+    }
+    for (size_t p = 0; p < max_pairs; p++) {
+        if (!present[p]) {
+            continue;
+        }
+        int s = (int) (p / (size_t) (o->alphabet + 1));
+        char read = symbol(o, (int) (p % (size_t) (o->alphabet + 1)));
+        random_transition(out, o, s, read, halting[p], walk);
+        if (random_unit() < nondet) {
+            random_transition(out, o, s, read, 0, walk);
+        }
+    }
+    free(present);
+    free(halting);
+    return 0;
+}
+
+static int zigzag_stages(const gen_options *o) {
+    int stages = (o->states - 1) / 2;
+    return stages < 1 ? 1 : stages;
+}
+
+static void gen_zigzag(FILE *out, const gen_options *o) {
+    int stages = zigzag_stages(o);
+    char right[6], left[6], next[6];
+    for (int x = 0; x < o->alphabet; x++) {
+        emit(out, "S", SYMBOLS[x], "q1", MARKER, 'D');
+    }
+    emit(out, "S", ' ', "A", ' ', 'R');
+    for (int k = 0; k < stages; k++) {
+        snprintf(right, sizeof(right), "q%d", 2 * k + 1);
+        snprintf(left, sizeof(left), "q%d", 2 * k + 2);
+        if (k + 1 < stages) {
+            snprintf(next, sizeof(next), "q%d", 2 * k + 3);
+        } else {
+            strcpy(next, "A");
+        }
+        for (int x = 0; x < o->alphabet; x++) {
+            emit(out, right, SYMBOLS[x], right, SYMBOLS[(x + k + 1) % o->alphabet], 'D');
+            emit(out, left, SYMBOLS[x], left, SYMBOLS[x], 'G');
+        }
+        emit(out, right, ' ', left, ' ', 'G');
+        emit(out, left, MARKER, next, MARKER, 'D');
+    }
+}
+
+static void gen_counter(FILE *out, const gen_options *o) {
+    char top = SYMBOLS[o->alphabet - 1];
+    emit(out, "S", MARKER, "q1", MARKER, 'D');
+    emit(out, "q1", '0', "q1", top, 'D');
+    for (int d = 1; d < o->alphabet; d++) {
+        emit(out, "q1", SYMBOLS[d], "q2", SYMBOLS[d - 1], 'G');
+        emit(out, "q2", SYMBOLS[d], "q2", SYMBOLS[d], 'G');
+    }
+    emit(out, "q2", '0', "q2", '0', 'G');
+    emit(out, "q2", MARKER, "q1", MARKER, 'D');
+    emit(out, "q1", ' ', "A", ' ', 'R');
+}
+
+/**
+ * Écrit un mot du corpus dont l'exécution dure environ -l pas.
+ */
+static void gen_word(FILE *out, const gen_options *o) {
+    if (!strcmp(o->family, "zigzag")) {
+        double n = o->run_length / (2.0 * zigzag_stages(o));
+        size_t len = n < 1 ? 1 : (size_t) n;
+        for (size_t i = 0; i < len; i++) {
+            fputc(SYMBOLS[random_below(o->alphabet)], out);
+        }
+    } else if (!strcmp(o->family, "counter")) {
+        // Un décrément parcourt en moyenne 1/(a-1) chiffres nuls, aller et retour
+        double per_decrement = 2.0 * o->alphabet / (o->alphabet - 1) + 1;
+        uint64_t target = (uint64_t) (o->run_length / per_decrement);
+        uint64_t value = target / 2 + (target ? next_random() % (target + 1) : 0);
+        fputc(MARKER, out);
+        do {
+            fputc(SYMBOLS[value % (uint64_t) o->alphabet], out);
+            value /= (uint64_t) o->alphabet;
+        } while (value > 0);
+    } else {
+        for (size_t i = 0; i < o->word_length; i++) {
+            fputc(SYMBOLS[random_below(o->alphabet)], out);
+        }
+    }
+    fputc('\n', out);
+}
+
+/**
+ * Écrit len octets de data dans le fichier path, ou sur stdout si path est
+ * NULL.
+ * @return 0 ou ERROR
+ */
+static int write_output(const char *path, const char *data, size_t len) {
+    FILE *fp = path ? fopen(path, "w") : stdout;
+    if (!fp) {
+        return ERROR;
+    }
+    size_t written = fwrite(data, 1, len, fp);
+    if ((fp != stdout ? fclose(fp) : fflush(fp)) != 0 || written != len) {
+        return ERROR;
+    }
+    return 0;
+}
+
+static int compare_steps(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Exécute chaque mot du corpus words (un par ligne) sur la machine text et
+ * écrit sur stderr le nombre de pas obtenu : minimum, médiane et maximum
+ * des mots qui s'arrêtent, et nombre de mots qui dépassent la limite.
+ * @return 0 ou ERROR si la machine ne se charge pas ou si la mémoire manque
+ */
+static int measure(const gen_options *o, const char *text, size_t text_len,
+                   const char *words, size_t words_len) {
+    tm_machine *m = tm_machine_parse(text, text_len);
+    uint64_t *steps = malloc(sizeof(uint64_t) * (o->words ? o->words : 1));
+    tm_limits limits = {(uint64_t) (MEASURE_FACTOR * o->run_length), 0};
+    size_t stopped = 0, unstopped = 0;
+    int status = ERROR;
+    if (!m || !steps) {
+        goto measure_end;
+    }
+    for (const char *w = words; w < words + words_len;) {
+        const char *eol = memchr(w, '\n', (size_t) (words + words_len - w));
+        size_t len = (size_t) ((eol ? eol : words + words_len) - w);
+        tm_result r;
+        int verdict = tm_run(m, w, len, &limits, &r);
+        if (verdict == TM_STEP_LIMIT) {
+            unstopped++;
+        } else if (verdict == TM_NO_MEMORY) {
+            goto measure_end;
+        } else {
+            steps[stopped++] = r.steps;
+        }
+        w += len + 1;
+    }
+    if (stopped) {
+        qsort(steps, stopped, sizeof(uint64_t), compare_steps);
+        fprintf(stderr, "tm_gen: %zu mots arrêtés, pas : min %llu, médiane %llu, max %llu\n",
+                stopped, (unsigned long long) steps[0],
+                (unsigned long long) steps[stopped / 2],
+                (unsigned long long) steps[stopped - 1]);
+    }
+    fprintf(stderr, "tm_gen: %zu mots sans arrêt en %llu pas (-l %g)\n", unstopped,
+            (unsigned long long) limits.max_steps, o->run_length);
+    status = 0;
+
+    measure_end:
+    free(steps);
+    tm_machine_free(m);
+    return status;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-t random|walk|zigzag|counter] [-s seed] [-q states] [-a alphabet]\n"
+                    "          [-d density] [-n nondeterminism] [-l run_length] [-L word_length]\n"
+                    "          [-c words] [-w words_file] [-o machine_file]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    gen_options o = {"random", 1, 16, 2, 1.0, 0.0, 1000, 16, 1000};
+    const char *machine_file = NULL;
+    const char *words_file = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:s:q:a:d:n:l:L:c:w:o:")) != -1) {
+        if (opt == 't') {
+            o.family = optarg;
+        } else if (opt == 's') {
+            o.seed = strtoull(optarg, NULL, 10);
+        } else if (opt == 'q') {
+            o.states = atoi(optarg);
+        } else if (opt == 'a') {
+            o.alphabet = atoi(optarg);
+        } else if (opt == 'd') {
+            o.density = atof(optarg);
+        } else if (opt == 'n') {
+            o.nondeterminism = atof(optarg);
+        } else if (opt == 'l') {
+            o.run_length = atof(optarg);
+        } else if (opt == 'L') {
+            o.word_length = (size_t) strtoull(optarg, NULL, 10);
+        } else if (opt == 'c') {
+            o.words = (size_t) strtoull(optarg, NULL, 10);
+        } else if (opt == 'w') {
+            words_file = optarg;
+        } else if (opt == 'o') {
+            machine_file = optarg;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    int family_ok = !strcmp(o.family, "random") || !strcmp(o.family, "walk")
+                    || !strcmp(o.family, "zigzag") || !strcmp(o.family, "counter");
+    if (!family_ok || o.states < 1 || o.states > MAX_STATES || o.alphabet < 1
+        || o.alphabet > MAX_ALPHABET || o.density <= 0 || o.density > 1
+        || o.nondeterminism < 0 || o.nondeterminism > 1 || o.run_length < 1
+        || (!strcmp(o.family, "counter") && o.alphabet < 2)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Machine et corpus sont d'abord écrits en mémoire, pour la mesure
+    char *text = NULL, *words = NULL;
+    size_t text_len = 0, words_len = 0;
+    FILE *out = open_memstream(&text, &text_len);
+    if (!out) {
+        perror("tm_gen");
+        return 1;
+    }
+    rng_state = o.seed;
+    fprintf(out, "S\nA\nR\n");
+    int status = 0;
+    if (!strcmp(o.family, "random") || !strcmp(o.family, "walk")) {
+        status = gen_random(out, &o, !strcmp(o.family, "walk"));
+    } else if (!strcmp(o.family, "zigzag")) {
+        gen_zigzag(out, &o);
+    } else {
+        gen_counter(out, &o);
+    }
+    if (fclose(out) != 0 || HAS_ERROR(status)
+        || HAS_ERROR(write_output(machine_file, text, text_len))) {
+        goto main_error;
+    }
+
+    if (words_file) {
+        FILE *corpus = open_memstream(&words, &words_len);
+        if (!corpus) {
+            goto main_error;
+        }
+        // Le corpus a son propre flot : il ne change pas si la machine change
+        rng_state = o.seed ^ 0x5851f42d4c957f2dull;
+        for (size_t i = 0; i < o.words; i++) {
+            gen_word(corpus, &o);
+        }
+        if (fclose(corpus) != 0 || HAS_ERROR(write_output(words_file, words, words_len))
+            || HAS_ERROR(measure(&o, text, text_len, words, words_len))) {
+            goto main_error;
+        }
+    }
+    free(text);
+    free(words);
+    return 0;
+
+    main_error:
+    perror("tm_gen");
+    free(text);
+    free(words);
+    return 1;
+}
@@ -0,0 +1,354 @@
+//
+// tm_perfgate : garde-fou contre les régressions de performance.
+//
+// Usage : tm_perfgate [-d dossier_machines] [-b fichier_référence] [-r répétitions]
+//                     [-t tolérance_%] [-u]
+//
+// Exécute une liste fixe de scénarios (machine, mot) et de chargements de
+// machines, et compare leur débit à un fichier de référence versionné
+// (perf_baseline.tsv à côté des sources). Pour que les chiffres restent
+// comparables d'une machine à l'autre, chaque mesure est rapportée à une
+// boucle d'étalonnage : un scénario vaut « pas par étalonnage » (pas/s
+// multiplié par la durée de la boucle), un chargement vaut « chargements par
+// étalonnage ». Chaque valeur est la meilleure de -r répétitions.
+//
+// Une valeur plus basse que la référence de plus de -t % (25 par défaut)
+// est une régression : tm_perfgate l'indique et sort avec le code 1. -u
+// réécrit le fichier de référence avec les mesures courantes ; c'est la
+// commande à lancer, puis à versionner, quand un changement de performance
+// est voulu. Les cibles CMake perfgate et perfgate_update font l'un et
+// l'autre.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "machine.h"
+#include "multitape.h"
+
+#ifndef TM_SOURCE_DIR
+#define TM_SOURCE_DIR "."
+#endif
+
+#define MAX_PATH_LEN 4096
+#define MAX_NAME_LEN 128
+#define CALIBRATION_ITERS (1u << 22)
+#define CALIBRATION_TABLE 4096
+
+/**
+ * Un scénario : iters exécutions de file sur length fois le symbole fill.
+ */
+typedef struct {
+    const char *name;
+    const char *file;
+    int ntapes;
+    char fill;
+    size_t length;
+    int iters;
+} run_case;
+
+static const run_case run_cases[] = {
+        {"run/power_len/4096", "power_len.txt", 1, '1', 4096, 40},
+        {"run/power_len_2tapes/65536", "power_len_2tapes.txt", 2, '1', 65536, 4},
+        {"run/youre_gonna_go_far_kid/blank", "youre_gonna_go_far_kid", 1, ' ', 1, 2000},
+        {"run/has_five_ones/1M", "has_five_ones", 1, '0', 1u << 20, 4},
+};
+
+typedef struct {
+    const char *name;
+    const char *file;
+    int iters;
+} load_case;
+
+static const load_case load_cases[] = {
+        {"load/power_len.txt", "power_len.txt", 5000},
+        {"load/youre_gonna_go_far_kid", "youre_gonna_go_far_kid", 20},
+};
+
+#define NRUNS (sizeof(run_cases) / sizeof(run_cases[0]))
+#define NLOADS (sizeof(load_cases) / sizeof(load_cases[0]))
+
+typedef struct {
+    char name[MAX_NAME_LEN];
+    double value;
+} measure;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * Boucle d'étalonnage : des lectures dépendantes dans une petite table,
+ * comme la boucle d'exécution.
+ * @return la meilleure durée en ns
+ */
+static uint64_t calibrate(int reps) {
+    static uint32_t table[CALIBRATION_TABLE];
+    uint32_t seed = 12345;
+    for (int i = 0; i < CALIBRATION_TABLE; i++) {
+        seed = seed * 1103515245u + 12345u;
+        table[i] = seed >> 8;
+    }
+    uint64_t best = UINT64_MAX;
+    volatile uint32_t sink = 0;
+    for (int r = 0; r < reps; r++) {
+        uint64_t start = now_ns();
+        uint32_t x = 0;
+        for (uint32_t i = 0; i < CALIBRATION_ITERS; i++) {
+            x = table[(x + i) & (CALIBRATION_TABLE - 1)] ^ (x >> 3);
+        }
+        uint64_t elapsed = now_ns() - start;
+        sink += x;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+/**
+ * @return les pas par étalonnage du scénario, ou une valeur négative si la
+ * machine ne se charge pas
+ */
+static double measure_run(const char *dir, const run_case *rc, int reps, uint64_t cal_ns) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", dir, rc->file);
+    tm_machine *single = NULL;
+    tm_mt_machine *multi = NULL;
+    if (rc->ntapes == 1) {
+        single = tm_machine_load(path);
+    } else {
+        multi = tm_mt_machine_load(path);
+    }
+    char *input = malloc(rc->length);
+    if ((!single && !multi) || !input) {
+        fprintf(stderr, "tm_perfgate: cannot load %s\n", path);
+        tm_machine_free(single);
+        tm_mt_machine_free(multi);
+        free(input);
+        return -1;
+    }
+    memset(input, rc->fill, rc->length);
+    uint64_t best = UINT64_MAX;
+    uint64_t steps = 0;
+    for (int r = 0; r < reps; r++) {
+        uint64_t start = now_ns();
+        steps = 0;
+        for (int i = 0; i < rc->iters; i++) {
+            tm_result result;
+            if (single) {
+                tm_run(single, input, rc->length, NULL, &result);
+            } else {
+                tm_mt_run(multi, input, rc->length, NULL, &result);
+            }
+            steps += result.steps;
+        }
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    tm_machine_free(single);
+    tm_mt_machine_free(multi);
+    free(input);
+    return best ? (double) steps * cal_ns / best : 0.0;
+}
+
+/**
+ * Mesure tm_machine_parse() sur le texte de la machine, lu une fois : les
+ * lectures de fichier varient trop d'une exécution à l'autre pour servir
+ * de référence.
+ * @return les chargements par étalonnage, ou une valeur négative si la
+ * machine ne se charge pas
+ */
+static double measure_load(const char *dir, const load_case *lc, int reps, uint64_t cal_ns) {
+    char path[MAX_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/%s", dir, lc->file);
+    double value = -1;
+    char *text = NULL;
+    FILE *fp = fopen(path, "rb");
+    if (!fp || fseek(fp, 0, SEEK_END) != 0) {
+        goto load_error;
+    }
+    long size = ftell(fp);
+    if (size < 0 || fseek(fp, 0, SEEK_SET) != 0 || !(text = malloc((size_t) size + 1))
+        || fread(text, 1, (size_t) size, fp) != (size_t) size) {
+        goto load_error;
+    }
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < reps; r++) {
+        uint64_t start = now_ns();
+        for (int i = 0; i < lc->iters; i++) {
+            tm_machine *m = tm_machine_parse(text, (size_t) size);
+            if (!m) {
+                goto load_error;
+            }
+            tm_machine_free(m);
+        }
+        uint64_t elapsed = now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    value = best ? (double) lc->iters * cal_ns / best : 0.0;
+
+    load_error:
+    if (value < 0) {
+        fprintf(stderr, "tm_perfgate: cannot load %s\n", path);
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    free(text);
+    return value;
+}
+
+/**
+ * Mesure un cas, rapporté à un étalonnage refait juste avant : la vitesse
+ * de la machine hôte peut changer au cours d'une exécution de tm_perfgate.
+ * Les chargements passent en premier, sur un tas encore neuf.
+ * @param i indice dans load_cases puis run_cases
+ */
+static double measure_case(const char *dir, size_t i, int reps) {
+    uint64_t cal_ns = calibrate(reps);
+    return i < NLOADS ? measure_load(dir, &load_cases[i], reps, cal_ns)
+                      : measure_run(dir, &run_cases[i - NLOADS], reps, cal_ns);
+}
+
+static const char *case_name(size_t i) {
+    return i < NLOADS ? load_cases[i].name : run_cases[i - NLOADS].name;
+}
+
+/**
+ * Lit le fichier de référence : une ligne « scénario<TAB>valeur » par
+ * mesure, les lignes qui commencent par '#' étant ignorées.
+ * @return le nombre de mesures lues, ou ERROR si le fichier est illisible
+ */
+static int read_baseline(const char *path, measure *out, int max) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        return ERROR;
+    }
+    char line[2 * MAX_NAME_LEN];
+    int n = 0;
+    while (n < max && fgets(line, sizeof(line), fp)) {
+        if (line[0] == '#') {
+            continue;
+        }
+        if (sscanf(line, "%127[^\t]\t%lf", out[n].name, &out[n].value) == 2) {
+            n++;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+static int write_baseline(const char *path, const measure *ms, int n, uint64_t cal_ns) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return ERROR;
+    }
+    fprintf(fp, "# Référence de tm_perfgate (tm_perfgate -u) : scénario<TAB>valeur par étalonnage\n");
+    fprintf(fp, "# étalonnage mesuré à la mise à jour : %llu ns\n", (unsigned long long) cal_ns);
+    for (int i = 0; i < n; i++) {
+        fprintf(fp, "%s\t%.4g\n", ms[i].name, ms[i].value);
+    }
+    return fclose(fp) == 0 ? 0 : ERROR;
+}
+
+int main(int argc, char *argv[]) {
+    const char *dir = TM_SOURCE_DIR;
+    char default_baseline[MAX_PATH_LEN];
+    snprintf(default_baseline, sizeof(default_baseline), "%s/perf_baseline.tsv", TM_SOURCE_DIR);
+    const char *baseline_path = default_baseline;
+    int reps = 7;
+    double tolerance = 25.0;
+    int update = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "d:b:r:t:u")) != -1) {
+        if (opt == 'd') {
+            dir = optarg;
+        } else if (opt == 'b') {
+            baseline_path = optarg;
+        } else if (opt == 'r') {
+            reps = atoi(optarg);
+        } else if (opt == 't') {
+            tolerance = atof(optarg);
+        } else if (opt == 'u') {
+            update = 1;
+        } else {
+            fprintf(stderr, "usage: %s [-d machine_dir] [-b baseline] [-r repetitions] [-t tolerance_percent] [-u]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (reps < 1) {
+        reps = 1;
+    }
+
+    measure current[NLOADS + NRUNS];
+    int n = 0;
+    uint64_t cal_ns = calibrate(reps);
+    printf("# calibration: %llu ns\n", (unsigned long long) cal_ns);
+    for (size_t i = 0; i < NLOADS + NRUNS; i++) {
+        double value = measure_case(dir, i, reps);
+        if (value < 0) {
+            return 1;
+        }
+        snprintf(current[n].name, MAX_NAME_LEN, "%s", case_name(i));
+        current[n++].value = value;
+    }
+
+    if (update) {
+        if (HAS_ERROR(write_baseline(baseline_path, current, n, cal_ns))) {
+            return 1;
+        }
+        printf("# baseline written to %s\n", baseline_path);
+        return 0;
+    }
+
+    measure baseline[MAX_NAME_LEN];
+    int nbase = read_baseline(baseline_path, baseline, MAX_NAME_LEN);
+    if (HAS_ERROR(nbase)) {
+        fprintf(stderr, "tm_perfgate: cannot read baseline %s (create it with -u)\n", baseline_path);
+        return 1;
+    }
+    int regressions = 0;
+    printf("scenario\tbaseline\tcurrent\tchange_pct\tstatus\n");
+    for (int i = 0; i < n; i++) {
+        const measure *base = NULL;
+        for (int b = 0; b < nbase; b++) {
+            if (!strcmp(baseline[b].name, current[i].name)) {
+                base = &baseline[b];
+            }
+        }
+        if (!base) {
+            printf("%s\t-\t%.4g\t-\tnew\n", current[i].name, current[i].value);
+            continue;
+        }
+        double change = base->value > 0 ? 100.0 * (current[i].value - base->value) / base->value : 0.0;
+        if (change < -tolerance) {
+            // Une mesure isolée peut tomber sur une machine occupée : on la
+            // refait une fois avant de conclure
+            double again = measure_case(dir, (size_t) i, reps);
+            if (again > current[i].value) {
+                current[i].value = again;
+                change = 100.0 * (again - base->value) / base->value;
+            }
+        }
+        int regressed = change < -tolerance;
+        regressions += regressed;
+        printf("%s\t%.4g\t%.4g\t%+.1f\t%s\n", current[i].name, base->value, current[i].value, change,
+               regressed ? "REGRESSION" : "ok");
+    }
+    if (regressions) {
+        printf("# %d regression(s) beyond %.0f%%\n", regressions, tolerance);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+//
+// tm_replay : enregistre une exécution puis s'y déplace pas à pas.
+//
+// Usage : tm_replay [-i intervalle] [-m max_pas] [-T max_ruban] [-w largeur] [-2]
+//                   machine_file mot
+//
+// Exécute la machine sur le mot en gardant un cliché tous les intervalle
+// pas (voir replay.h), affiche le verdict et la mémoire de l'enregistrement,
+// puis lit des commandes sur stdin, une par ligne :
+//   <n>  aller au pas n
+//   b    reculer d'un pas
+//   f    avancer d'un pas
+// Après chaque commande, la configuration courante est écrite sous la forme
+// « pas<TAB>état<TAB>tête<TAB>ruban », le ruban étant les largeur cases
+// autour de la tête, celle-ci entre crochets.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "machine.h"
+#include "replay.h"
+
+#define MAX_COMMAND_LEN 64
+#define MAX_WIDTH 1024
+
+static void print_position(const tm_machine *m, const tm_replay *r, int width) {
+    tm_replay_position pos;
+    tm_replay_where(r, &pos);
+    char window[MAX_WIDTH];
+    int64_t from = pos.head - width / 2;
+    if (!m->tape_mode && from < 0) {
+        from = 0;
+    }
+    tm_replay_read(r, from, (size_t) width, window);
+    printf("%llu\t%s\t%lld\t", (unsigned long long) pos.step, m->names[pos.state], (long long) pos.head);
+    for (int i = 0; i < width; i++) {
+        printf(from + i == pos.head ? "[%c]" : "%c", window[i]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+    tm_limits limits = {0};
+    uint64_t interval = 0;
+    int width = 40;
+    int two_way = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:m:T:w:2")) != -1) {
+        if (opt == 'i') {
+            interval = strtoull(optarg, NULL, 10);
+        } else if (opt == 'm') {
+            limits.max_steps = strtoull(optarg, NULL, 10);
+        } else if (opt == 'T') {
+            limits.max_tape = (size_t) strtoull(optarg, NULL, 10);
+        } else if (opt == 'w' && atoi(optarg) > 0 && atoi(optarg) <= MAX_WIDTH) {
+            width = atoi(optarg);
+        } else if (opt == '2') {
+            two_way = 1;
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind != argc - 2) {
+        fprintf(stderr, "usage: %s [-i interval] [-m max_steps] [-T max_tape] [-w width] [-2] "
+                        "machine_file input\n", argv[0]);
+        return 2;
+    }
+
+    tm_machine *m = tm_machine_load(argv[optind]);
+    if (!m) {
+        fprintf(stderr, "tm_replay: cannot load machine %s\n", argv[optind]);
+        return 1;
+    }
+    if (two_way) {
+        m->tape_mode = TM_TAPE_TWO_WAY;
+    }
+    const char *input = argv[optind + 1];
+    tm_replay *r = tm_replay_record(m, input, strlen(input), &limits, interval);
+    if (!r) {
+        fprintf(stderr, "tm_replay: out of memory while recording\n");
+        tm_machine_free(m);
+        return 1;
+    }
+    tm_replay_stats stats;
+    tm_replay_get_stats(r, &stats);
+    printf("# %s after %llu steps; %zu snapshots, log %zu bytes, snapshots %zu bytes, %.1f bytes/step\n",
+           tm_verdict_name(tm_replay_verdict(r)), (unsigned long long) stats.steps, stats.snapshots,
+           stats.log_bytes, stats.snapshot_bytes, stats.bytes_per_step);
+    print_position(m, r, width);
+
+    int status = 0;
+    char line[MAX_COMMAND_LEN];
+    while (fgets(line, sizeof(line), stdin)) {
+        int err;
+        if (line[0] == 'b') {
+            err = tm_replay_back(r);
+        } else if (line[0] == 'f') {
+            err = tm_replay_forward(r);
+        } else if (line[0] >= '0' && line[0] <= '9') {
+            err = tm_replay_seek(r, strtoull(line, NULL, 10));
+        } else {
+            continue;
+        }
+        if (err == TM_NO_MEMORY) {
+            fprintf(stderr, "tm_replay: out of memory\n");
+            status = 1;
+            break;
+        }
+        if (HAS_ERROR(err)) {
+            fprintf(stderr, "tm_replay: no such step\n");
+        }
+        print_position(m, r, width);
+    }
+    tm_replay_free(r);
+    tm_machine_free(m);
+    return status;
+}
@@ -0,0 +1,582 @@
+//
+// tmd : serveur qui exécute des machines de Turing pour des clients locaux.
+//
+// Usage : tmd [-s socket] [-w workers] [-C capacité] [-P fichier_cache]
+//            [-M machines]
+//
+// Le serveur écoute sur un socket Unix (protocole dans tmd_proto.h), garde
+// en cache les machines compilées et exécute les requêtes sur un bassin de
+// workers. Un fil lecteur par connexion permet d'enchaîner les requêtes
+// (pipelining) sans attendre les réponses. Les résultats sont mémorisés
+// dans un tm_cache (voir cache.h) sauf si la requête porte TMD_FLAG_NO_CACHE ;
+// -C 0 désactive le cache.
+//
+// Le cache des machines garde au plus -M machines (les moins récemment
+// demandées en sortent) ; une machine demandée par chemin est rechargée si
+// la taille ou la date de modification du fichier ont changé, et reçoit un
+// nouvel identifiant : l'ancien n'est plus reconnu. Les requêtes en vol sont
+// bornées par connexion et en tout ; au-delà, le lecteur de la connexion
+// attend avant de lire la requête suivante.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "cache.h"
+#include "machine.h"
+#include "tmd_proto.h"
+
+#define CACHE_BUCKETS 256
+#define DEFAULT_MACHINES 256
+
+/* Requêtes lues mais sans réponse, par connexion et en tout */
+#define MAX_CONNECTION_JOBS 64
+#define MAX_QUEUED_JOBS 1024
+
+/**
+ * Machine en cache. refs compte les workers qui l'utilisent, plus un tant
+ * qu'elle est dans le cache ; elle est libérée quand il tombe à 0.
+ */
+typedef struct cache_entry {
+    char *path;
+    uint64_t id;
+    tm_machine *machine;
+    off_t size;
+    struct timespec mtime;
+    int refs;
+    struct cache_entry *next_by_path;
+    struct cache_entry *next_by_id;
+    struct cache_entry *lru_prev;
+    struct cache_entry *lru_next;
+} cache_entry;
+
+/**
+ * Cache des machines compilées, indexé par chemin et par identifiant.
+ * lru va de la plus récemment demandée à la moins récemment demandée.
+ */
+static struct {
+    pthread_mutex_t lock;
+    cache_entry *by_path[CACHE_BUCKETS];
+    cache_entry *by_id[CACHE_BUCKETS];
+    cache_entry *lru_head;
+    cache_entry *lru_tail;
+    size_t count;
+    size_t capacity;
+    uint64_t next_id;
+} cache = {PTHREAD_MUTEX_INITIALIZER, {0}, {0}, NULL, NULL, 0, DEFAULT_MACHINES, 1};
+
+/**
+ * Connexion d'un client. refs compte le lecteur et les requêtes en vol,
+ * jobs ces dernières seulement.
+ */
+typedef struct {
+    int fd;
+    int refs;
+    int jobs;
+    pthread_mutex_t lock;
+    pthread_cond_t job_done;
+    pthread_mutex_t write_lock;
+} connection;
+
+typedef struct job {
+    connection *conn;
+    tmd_request req;
+    char *path;
+    char *input;
+    uint64_t enqueued_ns;
+    struct job *next;
+} job;
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t room;
+    job *head;
+    job *tail;
+    size_t count;
+} queue = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, NULL, NULL, 0};
+
+static const char *socket_path = TMD_DEFAULT_SOCKET;
+static tm_cache *results;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000u + (uint64_t) ts.tv_nsec;
+}
+
+static uint32_t hash_path(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char) *s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void entry_free(cache_entry *e) {
+    tm_machine_free(e->machine);
+    free(e->path);
+    free(e);
+}
+
+static int same_file(const cache_entry *e, const struct stat *st) {
+    return e->size == st->st_size && e->mtime.tv_sec == st->st_mtim.tv_sec
+           && e->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+/**
+ * Place e en tête de la liste lru (verrou du cache tenu).
+ */
+static void lru_push(cache_entry *e) {
+    e->lru_prev = NULL;
+    e->lru_next = cache.lru_head;
+    if (cache.lru_head) {
+        cache.lru_head->lru_prev = e;
+    } else {
+        cache.lru_tail = e;
+    }
+    cache.lru_head = e;
+}
+
+static void lru_unlink(cache_entry *e) {
+    if (e->lru_prev) {
+        e->lru_prev->lru_next = e->lru_next;
+    } else {
+        cache.lru_head = e->lru_next;
+    }
+    if (e->lru_next) {
+        e->lru_next->lru_prev = e->lru_prev;
+    } else {
+        cache.lru_tail = e->lru_prev;
+    }
+}
+
+/**
+ * Prend une référence sur e, la machine qu'un worker va utiliser (verrou
+ * du cache tenu).
+ */
+static cache_entry *cache_use(cache_entry *e) {
+    e->refs++;
+    lru_unlink(e);
+    lru_push(e);
+    return e;
+}
+
+/**
+ * Retire e du cache (verrou du cache tenu). Les workers qui l'utilisent
+ * encore la gardent jusqu'à cache_release().
+ * @return vrai si plus personne ne l'utilise : l'appelant la libère, hors
+ * du verrou
+ */
+static int cache_remove(cache_entry *e) {
+    cache_entry **p = &cache.by_path[hash_path(e->path) % CACHE_BUCKETS];
+    while (*p != e) {
+        p = &(*p)->next_by_path;
+    }
+    *p = e->next_by_path;
+    p = &cache.by_id[e->id % CACHE_BUCKETS];
+    while (*p != e) {
+        p = &(*p)->next_by_id;
+    }
+    *p = e->next_by_id;
+    lru_unlink(e);
+    cache.count--;
+    return --e->refs == 0;
+}
+
+/**
+ * Rend la référence prise par cache_get().
+ */
+static void cache_release(cache_entry *e) {
+    pthread_mutex_lock(&cache.lock);
+    int refs = --e->refs;
+    pthread_mutex_unlock(&cache.lock);
+    if (refs == 0) {
+        entry_free(e);
+    }
+}
+
+/**
+ * Trouve la machine demandée, en la compilant au besoin, et prend une
+ * référence dessus (à rendre par cache_release()). Une machine demandée
+ * par chemin est rechargée si son fichier a changé de taille ou de date.
+ * @param load_ns reçoit le temps de chargement (0 si elle était en cache)
+ * @return l'entrée du cache ou NULL si la machine est introuvable
+ */
+static cache_entry *cache_get(const job *j, uint64_t *load_ns) {
+    *load_ns = 0;
+    cache_entry *e;
+    if (j->req.kind == TMD_BY_ID) {
+        pthread_mutex_lock(&cache.lock);
+        e = cache.by_id[j->req.machine_id % CACHE_BUCKETS];
+        while (e && e->id != j->req.machine_id) {
+            e = e->next_by_id;
+        }
+        if (e) {
+            cache_use(e);
+        }
+        pthread_mutex_unlock(&cache.lock);
+        return e;
+    }
+    // Date prise avant le chargement : une modification pendant celui-ci
+    // fera recharger la machine à la requête suivante
+    struct stat st;
+    if (stat(j->path, &st) < 0) {
+        return NULL;
+    }
+    uint32_t b = hash_path(j->path) % CACHE_BUCKETS;
+    pthread_mutex_lock(&cache.lock);
+    for (e = cache.by_path[b]; e; e = e->next_by_path) {
+        if (!strcmp(e->path, j->path)) {
+            break;
+        }
+    }
+    if (e && same_file(e, &st)) {
+        cache_use(e);
+        pthread_mutex_unlock(&cache.lock);
+        return e;
+    }
+    pthread_mutex_unlock(&cache.lock);
+
+    // Compilation hors du verrou ; si un autre worker a gagné la course,
+    // on garde sa version.
+    uint64_t start = now_ns();
+    tm_machine *m = tm_machine_load(j->path);
+    *load_ns = now_ns() - start;
+    if (!m) {
+        return NULL;
+    }
+    cache_entry *fresh = calloc(1, sizeof(cache_entry));
+    char *path = strdup(j->path);
+    if (!fresh || !path) {
+        free(fresh);
+        free(path);
+        tm_machine_free(m);
+        return NULL;
+    }
+    fresh->path = path;
+    fresh->machine = m;
+    fresh->size = st.st_size;
+    fresh->mtime = st.st_mtim;
+
+    // Les entrées retirées que plus personne n'utilise, chaînées par
+    // next_by_path, sont libérées après le verrou
+    cache_entry *dead = NULL;
+    pthread_mutex_lock(&cache.lock);
+    for (e = cache.by_path[b]; e; e = e->next_by_path) {
+        if (!strcmp(e->path, j->path)) {
+            break;
+        }
+    }
+    if (e && same_file(e, &st)) {
+        cache_use(e);
+    } else {
+        if (e && cache_remove(e)) {
+            e->next_by_path = dead;
+            dead = e;
+        }
+        fresh->id = cache.next_id++;
+        fresh->refs = 1;
+        fresh->next_by_path = cache.by_path[b];
+        cache.by_path[b] = fresh;
+        fresh->next_by_id = cache.by_id[fresh->id % CACHE_BUCKETS];
+        cache.by_id[fresh->id % CACHE_BUCKETS] = fresh;
+        lru_push(fresh);
+        cache.count++;
+        while (cache.count > cache.capacity) {
+            cache_entry *old = cache.lru_tail;
+            if (cache_remove(old)) {
+                old->next_by_path = dead;
+                dead = old;
+            }
+        }
+        e = cache_use(fresh);
+        fresh = NULL;
+    }
+    pthread_mutex_unlock(&cache.lock);
+    if (fresh) {
+        entry_free(fresh);
+    }
+    while (dead) {
+        cache_entry *next = dead->next_by_path;
+        entry_free(dead);
+        dead = next;
+    }
+    return e;
+}
+
+static int read_full(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n == 0 || (n < 0 && errno != EINTR)) {
+            return ERROR;
+        }
+        if (n > 0) {
+            p += n;
+            len -= (size_t) n;
+        }
+    }
+    return 0;
+}
+
+static int write_full(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0 && errno != EINTR) {
+            return ERROR;
+        }
+        if (n > 0) {
+            p += n;
+            len -= (size_t) n;
+        }
+    }
+    return 0;
+}
+
+static void connection_release(connection *c) {
+    pthread_mutex_lock(&c->lock);
+    int refs = --c->refs;
+    pthread_mutex_unlock(&c->lock);
+    if (refs == 0) {
+        close(c->fd);
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->job_done);
+        pthread_mutex_destroy(&c->write_lock);
+        free(c);
+    }
+}
+
+/**
+ * Ajoute j à la file des workers, en attendant qu'elle ait de la place.
+ */
+static void enqueue(job *j) {
+    j->next = NULL;
+    pthread_mutex_lock(&queue.lock);
+    while (queue.count >= MAX_QUEUED_JOBS) {
+        pthread_cond_wait(&queue.room, &queue.lock);
+    }
+    queue.count++;
+    if (queue.tail) {
+        queue.tail->next = j;
+    } else {
+        queue.head = j;
+    }
+    queue.tail = j;
+    pthread_cond_signal(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+static job *dequeue(void) {
+    pthread_mutex_lock(&queue.lock);
+    while (!queue.head) {
+        pthread_cond_wait(&queue.ready, &queue.lock);
+    }
+    job *j = queue.head;
+    queue.head = j->next;
+    if (!queue.head) {
+        queue.tail = NULL;
+    }
+    queue.count--;
+    pthread_cond_signal(&queue.room);
+    pthread_mutex_unlock(&queue.lock);
+    return j;
+}
+
+static void *worker_main(void *arg) {
+    (void) arg;
+    for (;;) {
+        job *j = dequeue();
+        tmd_response resp = {0};
+        resp.magic = TMD_MAGIC;
+        resp.req_id = j->req.req_id;
+        resp.queue_ns = now_ns() - j->enqueued_ns;
+
+        cache_entry *e = cache_get(j, &resp.load_ns);
+        if (!e) {
+            resp.verdict = TM_LOAD_ERROR;
+        } else {
+            tm_limits limits = {j->req.max_steps, (size_t) j->req.max_tape};
+            tm_result result;
+            uint64_t start = now_ns();
+            int flags = (j->req.flags & TMD_FLAG_NO_CACHE) ? TM_CACHE_BYPASS : 0;
+            resp.verdict = tm_cache_run(results, e->machine, j->input, j->req.input_len,
+                                        &limits, &result, flags);
+            resp.run_ns = now_ns() - start;
+            resp.steps = result.steps;
+            resp.machine_id = e->id;
+            cache_release(e);
+        }
+
+        pthread_mutex_lock(&j->conn->write_lock);
+        write_full(j->conn->fd, &resp, sizeof(resp));
+        pthread_mutex_unlock(&j->conn->write_lock);
+
+        pthread_mutex_lock(&j->conn->lock);
+        j->conn->jobs--;
+        pthread_cond_signal(&j->conn->job_done);
+        pthread_mutex_unlock(&j->conn->lock);
+        connection_release(j->conn);
+        free(j->path);
+        free(j->input);
+        free(j);
+    }
+    return NULL;
+}
+
+/**
+ * Lit les requêtes d'une connexion et les place dans la file des workers.
+ * Avec MAX_CONNECTION_JOBS requêtes sans réponse, la lecture attend : le
+ * client est freiné par le socket plutôt que la file de grandir.
+ */
+static void *reader_main(void *arg) {
+    connection *c = arg;
+    for (;;) {
+        pthread_mutex_lock(&c->lock);
+        while (c->jobs >= MAX_CONNECTION_JOBS) {
+            pthread_cond_wait(&c->job_done, &c->lock);
+        }
+        pthread_mutex_unlock(&c->lock);
+        job *j = calloc(1, sizeof(job));
+        if (!j) {
+            break;
+        }
+        if (HAS_ERROR(read_full(c->fd, &j->req, sizeof(tmd_request)))
+            || j->req.magic != TMD_MAGIC
+            || j->req.machine_len > TMD_MAX_PATH
+            || j->req.input_len > TMD_MAX_INPUT) {
+            free(j);
+            break;
+        }
+        j->path = malloc(j->req.machine_len + 1);
+        j->input = malloc(j->req.input_len + 1);
+        if (!j->path || !j->input
+            || HAS_ERROR(read_full(c->fd, j->path, j->req.machine_len))
+            || HAS_ERROR(read_full(c->fd, j->input, j->req.input_len))) {
+            free(j->path);
+            free(j->input);
+            free(j);
+            break;
+        }
+        j->path[j->req.machine_len] = '\0';
+        j->input[j->req.input_len] = '\0';
+        j->conn = c;
+        j->enqueued_ns = now_ns();
+
+        pthread_mutex_lock(&c->lock);
+        c->refs++;
+        c->jobs++;
+        pthread_mutex_unlock(&c->lock);
+        enqueue(j);
+    }
+    // Les réponses en attente gardent leur propre référence
+    shutdown(c->fd, SHUT_RD);
+    connection_release(c);
+    return NULL;
+}
+
+static void on_signal(int sig) {
+    (void) sig;
+    unlink(socket_path);
+    _exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    int workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    size_t cache_capacity = 1u << 20;
+    const char *cache_file = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:w:C:P:M:")) != -1) {
+        if (opt == 's') {
+            socket_path = optarg;
+        } else if (opt == 'w') {
+            workers = atoi(optarg);
+        } else if (opt == 'C') {
+            cache_capacity = (size_t) strtoull(optarg, NULL, 10);
+        } else if (opt == 'P') {
+            cache_file = optarg;
+        } else if (opt == 'M' && atoi(optarg) > 0) {
+            cache.capacity = (size_t) atoi(optarg);
+        } else {
+            fprintf(stderr, "usage: %s [-s socket] [-w workers] [-C cache_capacity] [-P cache_file] "
+                            "[-M machines]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (workers < 1) {
+        workers = 1;
+    }
+    if (cache_capacity > 0 && !(results = tm_cache_create(cache_capacity, cache_file, 4 * cache_capacity))) {
+        fprintf(stderr, "tmd: cannot create result cache\n");
+        return 1;
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "tmd: socket path too long\n");
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socket_path);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0
+        || listen(listen_fd, 64) < 0) {
+        perror("tmd");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    for (int i = 0; i < workers; i++) {
+        pthread_t t;
+        if (pthread_create(&t, NULL, worker_main, NULL) != 0) {
+            perror("tmd");
+            return 1;
+        }
+        pthread_detach(t);
+    }
+    fprintf(stderr, "tmd: listening on %s with %d workers\n", socket_path, workers);
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("tmd");
+            break;
+        }
+        connection *c = calloc(1, sizeof(connection));
+        if (!c) {
+            close(fd);
+            continue;
+        }
+        c->fd = fd;
+        c->refs = 1;
+        pthread_mutex_init(&c->lock, NULL);
+        pthread_cond_init(&c->job_done, NULL);
+        pthread_mutex_init(&c->write_lock, NULL);
+        pthread_t t;
+        if (pthread_create(&t, NULL, reader_main, c) != 0) {
+            connection_release(c);
+            continue;
+        }
+        pthread_detach(t);
+    }
+    unlink(socket_path);
+    return 1;
+}
@@ -0,0 +1,201 @@
+//
+// tmd_load : générateur de charge pour tmd.
+//
+// Usage : tmd_load [-s socket] [-c connexions] [-d profondeur] [-n requêtes]
+//                  machine_file input
+//
+// Chaque connexion garde jusqu'à « profondeur » requêtes en vol sur le même
+// socket. La première requête désigne la machine par son chemin, les
+// suivantes par l'identifiant que le serveur a renvoyé. Si le serveur ne
+// connaît plus cet identifiant (machine sortie de son cache ou rechargée),
+// la requête est renvoyée par chemin et le nouvel identifiant retenu.
+//
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "machine.h"
+#include "tmd_proto.h"
+
+typedef struct {
+    const char *machine_file;
+    const char *input;
+    long requests;
+    int depth;
+    long done;
+    long mismatches;
+    int first_verdict;
+    uint64_t run_ns;
+    uint64_t queue_ns;
+    int failed;
+} client;
+
+static const char *socket_path = TMD_DEFAULT_SOCKET;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+static int io_full(int fd, void *buf, size_t len, int writing) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = writing ? write(fd, p, len) : read(fd, p, len);
+        if (n == 0 || (n < 0 && errno != EINTR)) {
+            return ERROR;
+        }
+        if (n > 0) {
+            p += n;
+            len -= (size_t) n;
+        }
+    }
+    return 0;
+}
+
+static int send_request(int fd, client *cl, uint32_t req_id, uint64_t machine_id) {
+    tmd_request req = {0};
+    req.magic = TMD_MAGIC;
+    req.req_id = req_id;
+    req.kind = machine_id ? TMD_BY_ID : TMD_BY_PATH;
+    req.machine_id = machine_id;
+    req.machine_len = machine_id ? 0 : (uint32_t) strlen(cl->machine_file);
+    req.input_len = (uint32_t) strlen(cl->input);
+    if (HAS_ERROR(io_full(fd, &req, sizeof(req), 1))
+        || HAS_ERROR(io_full(fd, (void *) cl->machine_file, req.machine_len, 1))
+        || HAS_ERROR(io_full(fd, (void *) cl->input, req.input_len, 1))) {
+        return ERROR;
+    }
+    return 0;
+}
+
+static void *client_main(void *arg) {
+    client *cl = arg;
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        cl->failed = 1;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    // La première réponse donne l'identifiant de la machine
+    tmd_response resp;
+    if (HAS_ERROR(send_request(fd, cl, 0, 0)) || HAS_ERROR(io_full(fd, &resp, sizeof(resp), 0))) {
+        cl->failed = 1;
+        close(fd);
+        return NULL;
+    }
+    cl->first_verdict = resp.verdict;
+    cl->done = 1;
+    uint64_t machine_id = resp.machine_id;
+
+    long sent = 1;
+    while (cl->done < cl->requests) {
+        while (sent < cl->requests && sent - cl->done < cl->depth) {
+            if (HAS_ERROR(send_request(fd, cl, (uint32_t) sent, machine_id))) {
+                cl->failed = 1;
+                close(fd);
+                return NULL;
+            }
+            sent++;
+        }
+        if (HAS_ERROR(io_full(fd, &resp, sizeof(resp), 0))) {
+            cl->failed = 1;
+            break;
+        }
+        if (resp.verdict == TM_LOAD_ERROR && !resp.machine_id && cl->first_verdict != TM_LOAD_ERROR) {
+            machine_id = 0;
+            if (HAS_ERROR(send_request(fd, cl, resp.req_id, 0))) {
+                cl->failed = 1;
+                break;
+            }
+            continue;
+        }
+        if (!machine_id) {
+            machine_id = resp.machine_id;
+        }
+        if (resp.verdict != cl->first_verdict) {
+            cl->mismatches++;
+        }
+        cl->run_ns += resp.run_ns;
+        cl->queue_ns += resp.queue_ns;
+        cl->done++;
+    }
+    close(fd);
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    int connections = 4, depth = 16;
+    long requests = 100000;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:c:d:n:")) != -1) {
+        if (opt == 's') {
+            socket_path = optarg;
+        } else if (opt == 'c') {
+            connections = atoi(optarg);
+        } else if (opt == 'd') {
+            depth = atoi(optarg);
+        } else if (opt == 'n') {
+            requests = atol(optarg);
+        } else {
+            optind = argc + 1;
+            break;
+        }
+    }
+    if (optind + 2 != argc || connections < 1 || depth < 1 || requests < connections) {
+        fprintf(stderr, "usage: %s [-s socket] [-c connections] [-d depth] [-n requests] "
+                        "machine_file input\n", argv[0]);
+        return 2;
+    }
+
+    client *clients = calloc((size_t) connections, sizeof(client));
+    pthread_t *threads = malloc(sizeof(pthread_t) * connections);
+    if (!clients || !threads) {
+        return 1;
+    }
+    double start = now_s();
+    for (int i = 0; i < connections; i++) {
+        clients[i].machine_file = argv[optind];
+        clients[i].input = argv[optind + 1];
+        clients[i].depth = depth;
+        clients[i].requests = requests / connections + (i < requests % connections);
+        pthread_create(&threads[i], NULL, client_main, &clients[i]);
+    }
+    long done = 0, mismatches = 0;
+    uint64_t run_ns = 0, queue_ns = 0;
+    int failed = 0;
+    for (int i = 0; i < connections; i++) {
+        pthread_join(threads[i], NULL);
+        done += clients[i].done;
+        mismatches += clients[i].mismatches;
+        run_ns += clients[i].run_ns;
+        queue_ns += clients[i].queue_ns;
+        failed |= clients[i].failed;
+    }
+    double elapsed = now_s() - start;
+
+    printf("requests\t%ld\n", done);
+    printf("verdict\t%s\n", tm_verdict_name(clients[0].first_verdict));
+    printf("mismatches\t%ld\n", mismatches);
+    printf("elapsed_s\t%.3f\n", elapsed);
+    printf("requests_per_s\t%.0f\n", done / elapsed);
+    if (done > connections) {
+        printf("mean_run_us\t%.2f\n", run_ns / 1e3 / (double) (done - connections));
+        printf("mean_queue_us\t%.2f\n", queue_ns / 1e3 / (double) (done - connections));
+    }
+    free(clients);
+    free(threads);
+    return failed || mismatches ? 1 : 0;
+}
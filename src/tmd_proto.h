@@ -0,0 +1,62 @@
+//
+// Protocole binaire de tmd (serveur d'exécution sur socket Unix).
+//
+// Chaque requête est un en-tête tmd_request suivi de machine_len octets
+// (chemin du fichier si kind == TMD_BY_PATH, rien si kind == TMD_BY_ID) puis
+// de input_len octets de mot d'entrée. Chaque réponse est un tmd_response
+// de taille fixe. Les entiers sont dans l'ordre d'octets de l'hôte : le
+// socket est local.
+//
+// Plusieurs requêtes peuvent être envoyées sans attendre les réponses ;
+// celles-ci reviennent dans l'ordre de complétion et sont associées aux
+// requêtes par req_id.
+//
+// L'identifiant d'une machine (tmd_response.machine_id) vaut tant qu'elle
+// reste dans le cache du serveur et que son fichier ne change pas ; une
+// requête par un identifiant oublié reçoit TM_LOAD_ERROR et machine_id 0,
+// et doit être renvoyée par chemin.
+//
+#ifndef TP0_TMD_PROTO_H
+#define TP0_TMD_PROTO_H
+
+#include <stdint.h>
+
+#define TMD_MAGIC 0x31444d54u /* "TMD1" */
+#define TMD_DEFAULT_SOCKET "/tmp/tmd.sock"
+
+#define TMD_BY_PATH 0
+#define TMD_BY_ID 1
+
+/* Bits de tmd_request.flags */
+#define TMD_FLAG_NO_CACHE 1
+
+#define TMD_MAX_PATH 4096
+#define TMD_MAX_INPUT (64u * 1024 * 1024)
+
+typedef struct {
+    uint32_t magic;
+    uint32_t req_id;
+    uint8_t kind;
+    uint8_t flags;
+    uint16_t reserved;
+    uint32_t machine_len;
+    uint64_t machine_id;
+    uint32_t input_len;
+    uint32_t reserved2;
+    uint64_t max_steps;
+    uint64_t max_tape;
+} tmd_request;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t req_id;
+    int32_t verdict;
+    uint32_t reserved;
+    uint64_t machine_id;
+    uint64_t steps;
+    uint64_t queue_ns;
+    uint64_t load_ns;
+    uint64_t run_ns;
+} tmd_response;
+
+#endif //TP0_TMD_PROTO_H